@@ -0,0 +1,129 @@
+#include "InterpreterBench.h"
+
+#include <stdio.h>
+#include <chrono>
+#include <string>
+
+#include "Lexer.h"
+#include "Parser.h"
+#include "Declaration.h"
+#include "Interpreter.h"
+
+namespace
+{
+    struct InterpCase
+    {
+        const char* name;
+        const char* source;
+        const char* function;   // Called with a single int argument
+        int64_t     argument;   // At a scale of 1
+        bool        grows_exponentially;    // The argument goes up by one per doubling of scale instead
+    };
+
+    // There are no loops, so repetition is recursion. Anything recursing
+    // once per step has to stay below the interpreter's depth limit, the
+    // others split their range in halves. Comparisons bind tighter than
+    // arithmetic in this grammar, hence the parentheses.
+    const InterpCase CASES[] = {
+        { "fibonacci",
+          "fibonacci(n: int) -> int { if n < 2 { return n; } return fibonacci(n - 1) + fibonacci(n - 2); }",
+          "fibonacci", 27, true },
+        { "locals",
+          "mix(a: int, b: int) -> int {\n"
+          "    t : int = a * 31 + b;\n"
+          "    u : int = t / 7;\n"
+          "    if (t - u * 7) > 3 { t = t + u; } else { t = t - u; }\n"
+          "    return t;\n"
+          "}\n"
+          "range(lo: int, hi: int) -> int {\n"
+          "    if (hi - lo) < 2 { return mix(lo, hi); }\n"
+          "    mid : int = (lo + hi) / 2;\n"
+          "    return range(lo, mid) + range(mid, hi);\n"
+          "}\n"
+          "sum(n: int) -> int { return range(0, n); }",
+          "sum", 200000, false },
+        { "floats",
+          "f(x: float) -> float { return x * x / (1.0 + x); }\n"
+          "area(lo: float, hi: float, steps: int) -> float {\n"
+          "    if steps < 2 { return (f(lo) + f(hi)) * (hi - lo) / 2.0; }\n"
+          "    half : int = steps / 2;\n"
+          "    mid : float = lo + (hi - lo) * half / steps;\n"
+          "    return area(lo, mid, half) + area(mid, hi, steps - half);\n"
+          "}\n"
+          "integrate(n: int) -> int { return area(0.0, 100.0, n); }",
+          "integrate", 200000, false },
+    };
+
+    bool parse(const std::string& source, LexerState& lexer, ast::ParseResult& program)
+    {
+        lexer.input_string = source;
+        lexer.input_len    = source.size();
+        if(lexer.tokenize_string() != LEX_SUCCESS)
+            return false;
+
+        ParserState parser;
+        parser.status       = PARSE_SUCCESS;
+        parser.lexer        = &lexer;
+        parser.token_stream = lexer.tokens.data();
+        parser.curr_token   = 0;
+        program = ast::parse_program(&parser);
+        return parser.errors.empty() && parser.status == PARSE_SUCCESS;
+    }
+}
+
+std::vector<InterpResult> run_interpreter_benchmarks(int scale, int iterations)
+{
+    std::vector<InterpResult> results;
+    for(const InterpCase& bench : CASES)
+    {
+        int64_t argument = bench.argument;
+        for(int s = scale; s > 1; s /= 2)
+            argument = bench.grows_exponentially ? argument + 1 : argument * 2;
+
+        double tree_seconds = 0.0;
+        for(ast::Engine engine : { ast::Engine::TREE, ast::Engine::BYTECODE })
+        {
+            InterpResult result;
+            result.name   = bench.name;
+            result.engine = engine;
+            result.call   = std::string(bench.function) + "(" + std::to_string(argument) + ")";
+
+            std::string source = bench.source;
+            LexerState lexer;
+            ast::ParseResult program;
+            if(!parse(source, lexer, program))
+            {
+                result.ok = false;
+                results.push_back(result);
+                continue;
+            }
+            ast::Interpreter interpreter(std::move(program), engine);
+            interpreter.set_output(nullptr);
+
+            Symbol function = Interner::global().intern(bench.function);
+            for(int i = 0; i < iterations && result.ok; i++)
+            {
+                ast::Value arg = ast::Value::of_int(argument), value;
+                uint64_t calls_before = interpreter.num_calls();
+
+                auto start = std::chrono::steady_clock::now();
+                result.ok = interpreter.call(function, &arg, 1, value);
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                if(result.seconds == 0.0 || seconds < result.seconds)
+                    result.seconds = seconds;
+                result.calls  = interpreter.num_calls() - calls_before;
+                result.result = value.kind == ast::Value::INT ? value.int_value : 0;
+            }
+            if(!result.ok)
+                std::fprintf(stderr, "[Error] %s: %s\n", bench.name, interpreter.error().c_str());
+
+            if(engine == ast::Engine::TREE)
+                tree_seconds = result.seconds;
+            else if(result.seconds > 0.0)
+                result.speedup = tree_seconds / result.seconds;
+            results.push_back(result);
+        }
+    }
+    return results;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#ifndef LANG_BENCH_INTERPRETER_BENCH_H
+#define LANG_BENCH_INTERPRETER_BENCH_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Interpreter.h"
+
+// Small programs run by each of the interpreter's engines, timed from the
+// call into them to their result. Parsing and compiling them isn't part of
+// the time.
+struct InterpResult
+{
+    const char* name;
+    ast::Engine engine;
+    std::string call;           // What's being run, e.g. fibonacci(27)
+    uint64_t    calls   = 0;    // Function calls made per run, builtins aside
+    int64_t     result  = 0;
+    double      seconds = 0.0;  // Best of all runs
+    double      speedup = 1.0;  // Over the tree walker running the same program
+    bool        ok      = true; // Parsed and ran without errors
+};
+
+// `scale` multiplies the work done by each program, 1 takes a few hundred
+// milliseconds per run on a tree walker
+std::vector<InterpResult> run_interpreter_benchmarks(int scale, int iterations);
+
+#endif
@@ -0,0 +1,104 @@
+#include "ParserMicrobench.h"
+
+#include <chrono>
+#include <string>
+
+#include "Lexer.h"
+#include "Parser.h"
+#include "Expression.h"
+#include "Statement.h"
+#include "Declaration.h"
+
+namespace
+{
+    // Parses one copy of a snippet, false if it didn't parse
+    using ParseOne = bool (*)(ParserState*);
+
+    struct MicroCase
+    {
+        const char* name;
+        const char* snippet;
+        ParseOne    parse;
+    };
+
+    // Expression snippets end in ';' to keep consecutive copies apart
+    bool expression(ParserState* parser)
+    {
+        if(!ast::parse_expression(parser) || !parser->match_token(TOKEN_SEMICOLON))
+            return false;
+        parser->get_next_token();
+        return true;
+    }
+    bool statement(ParserState* parser)   { return ast::parse_statement(parser) != nullptr; }
+    bool block(ParserState* parser)       { return ast::parse_block(parser, true) != nullptr; }
+    bool declaration(ParserState* parser) { return ast::parse_declaration(parser) != nullptr; }
+
+    const MicroCase CASES[] = {
+        { "atom/identifier",   "x;",                                          expression  },
+        { "atom/literal",      "42; 3.5; \"text\";",                          expression  },
+        { "func_call",         "f(a, 1, g(b));",                              expression  },
+        { "expression/binary", "a + b * c - d / e < f;",                      expression  },
+        { "expression/nested", "((a + (b - (c * (d)))));",                    expression  },
+        { "expression/negate", "-a * -(b + 1);",                              expression  },
+        { "var_decl",          "x : int = a + 1;",                            statement   },
+        { "return_statement",  "return a * 2;",                               statement   },
+        { "if_statement",      "if a < b { x = 1; } else { x = 2; }",         statement   },
+        { "block",             "{ x = 1; y = x + 2; print(y); }",             block       },
+        { "function_decl",     "f(a: int, b: int) -> int { return a + b; }",  declaration },
+    };
+}
+
+std::vector<MicroResult> run_parser_microbenchmarks(size_t target_bytes, int iterations)
+{
+    std::vector<MicroResult> results;
+    for(const MicroCase& micro : CASES)
+    {
+        MicroResult result;
+        result.name    = micro.name;
+        result.snippet = micro.snippet;
+
+        std::string source;
+        while(source.size() < target_bytes)
+        {
+            source += micro.snippet;
+            source += '\n';
+            result.instances++;
+        }
+        result.bytes = source.size();
+
+        LexerState lexer;
+        lexer.input_string = source;
+        lexer.input_len    = source.size();
+        lexer.tokenize_string();
+        result.tokens = lexer.tokens.size();
+
+        for(int i = 0; i < iterations; i++)
+        {
+            Arena arena;
+            ParserState parser;
+            parser.status       = PARSE_SUCCESS;
+            parser.lexer        = &lexer;
+            parser.token_stream = lexer.tokens.data();
+            parser.curr_token   = 0;
+            parser.arena        = &arena;
+
+            auto start = std::chrono::steady_clock::now();
+            while(parser.current().type != TOKEN_EOF)
+            {
+                if(!micro.parse(&parser))
+                {
+                    result.ok = false;
+                    break;
+                }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if(result.seconds == 0.0 || seconds < result.seconds)
+                result.seconds = seconds;
+            result.nodes = parser.num_nodes;
+            result.ok    = result.ok && parser.errors.empty();
+        }
+        results.push_back(result);
+    }
+    return results;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#ifndef LANG_BENCH_PARSER_MICROBENCH_H
+#define LANG_BENCH_PARSER_MICROBENCH_H
+
+#include <cstddef>
+#include <vector>
+
+// Each grammar rule timed on its own, over a source made of nothing but
+// copies of one snippet of it, parsed by calling that rule directly. Whole
+// programs mix every rule together; these show what each one costs.
+struct MicroResult
+{
+    const char* name;           // Rule and what the snippet stresses
+    const char* snippet;
+    size_t      instances = 0;  // Copies of the snippet parsed per run
+    size_t      bytes     = 0;
+    size_t      tokens    = 0;
+    size_t      nodes     = 0;
+    double      seconds   = 0.0;    // Best of all runs
+    bool        ok        = true;   // Every copy parsed without errors
+};
+
+// Sources are built up to about target_bytes each
+std::vector<MicroResult> run_parser_microbenchmarks(size_t target_bytes, int iterations);
+
+#endif
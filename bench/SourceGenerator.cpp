@@ -0,0 +1,248 @@
+#include "SourceGenerator.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include <vector>
+
+namespace
+{
+    const char* WORDS[] = {
+        "lexer", "parser", "token", "symbol", "scope", "value", "result", "count",
+        "index", "buffer", "stream", "branch", "return", "string", "number", "total",
+    };
+    const int NUM_WORDS = sizeof(WORDS) / sizeof(WORDS[0]);
+
+    struct Generator
+    {
+        GeneratorOptions options;
+        std::mt19937     rng;
+        std::string      out;
+        int              num_functions = 0;
+        std::vector<int> leaves;    // Functions without calls, the only ones others may call
+
+        explicit Generator(const GeneratorOptions& opts):
+            options(opts), rng(opts.seed) { }
+
+        int  random(int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); }
+        bool chance(int percent)    { return random(1, 100) <= percent; }
+
+        void indent(int depth) { out.append(4 * depth, ' '); }
+        void line(int depth, const std::string& text)
+        {
+            indent(depth);
+            out += text;
+            out += '\n';
+        }
+
+        void comment(int depth)
+        {
+            indent(depth);
+            out += "//";
+            for(int i = random(3, 10); i > 0; i--)
+            {
+                out += ' ';
+                out += WORDS[random(0, NUM_WORDS - 1)];
+            }
+            out += '\n';
+        }
+
+        std::string operand(bool allow_call)
+        {
+            int pick = random(0, 9);
+            if(allow_call && !leaves.empty() && pick == 0)
+            {
+                int callee = leaves[random(0, (int) leaves.size() - 1)];
+                return "fn_" + std::to_string(callee) + "(b, " + std::to_string(random(1, 9)) + ")";
+            }
+            if(pick < 3) return "a";
+            if(pick < 5) return "b";
+            if(pick < 7) return "x";
+            return std::to_string(random(1, 99));
+        }
+
+        // Comparisons bind tighter than arithmetic in this grammar, so they are
+        // kept out of the chains and only used as whole if conditions
+        std::string expression(int num_operands, bool allow_call)
+        {
+            static const char* OPS[] = { " + ", " - ", " * " };
+            std::string expr = operand(allow_call);
+            for(int i = 1; i < num_operands; i++)
+            {
+                if(chance(10))
+                {
+                    expr += " / " + std::to_string(random(1, 9));    // Never divide by zero
+                    continue;
+                }
+                expr += OPS[random(0, 2)];
+                if(chance(15) && i + 2 <= num_operands)
+                {
+                    expr += "(" + operand(allow_call) + OPS[random(0, 2)] + operand(allow_call) + ")";
+                    i++;
+                }
+                else
+                    expr += operand(allow_call);
+            }
+            return expr;
+        }
+
+        std::string condition()
+        {
+            static const char* CMPS[] = { " < ", " > ", " <= ", " >= ", " == ", " != " };
+            const char* var = chance(50) ? "x" : (chance(50) ? "a" : "b");
+            return std::string(var) + CMPS[random(0, 5)] + std::to_string(random(0, 50));
+        }
+
+        std::string string_literal()
+        {
+            std::string text = "\"";
+            for(int i = random(6, 20); i > 0; i--)
+            {
+                text += WORDS[random(0, NUM_WORDS - 1)];
+                if(chance(5))
+                    text += chance(50) ? "\\n" : "\\t";
+                else if(chance(3))
+                    text += "\\\"";
+                text += ' ';
+            }
+            text += "\"";
+            return text;
+        }
+
+        void small_function_body(bool allow_call)
+        {
+            line(1, "x : int = " + expression(random(2, 4), allow_call) + ";");
+            if(chance(60))
+            {
+                line(1, "if " + condition() + " {");
+                line(2, "x = " + expression(random(2, 3), allow_call) + ";");
+                if(chance(50))
+                {
+                    line(1, "} else {");
+                    line(2, "x = " + expression(random(2, 3), allow_call) + ";");
+                }
+                line(1, "}");
+            }
+        }
+
+        void nested_if(int depth, int remaining, bool allow_call)
+        {
+            line(depth, "if " + condition() + " {");
+            line(depth + 1, "x = " + expression(2, allow_call) + ";");
+            if(remaining > 1)
+                nested_if(depth + 1, remaining - 1, allow_call);
+            line(depth, "} else {");
+            line(depth + 1, "x = " + expression(2, allow_call) + ";");
+            line(depth, "}");
+        }
+
+        void long_expression_body(bool allow_call)
+        {
+            line(1, "x : int = " + expression(options.chain_length, allow_call) + ";");
+            line(1, "x = " + expression(options.chain_length, allow_call) + ";");
+        }
+
+        void string_heavy_body(bool allow_call)
+        {
+            line(1, "x : int = " + expression(2, allow_call) + ";");
+            for(int i = random(2, 5); i > 0; i--)
+                line(1, "print(" + string_literal() + ", x);");
+        }
+
+        void comment_heavy_body(bool allow_call)
+        {
+            for(int i = random(2, 4); i > 0; i--) comment(1);
+            line(1, "x : int = " + expression(random(2, 3), allow_call) + ";   // " + WORDS[random(0, NUM_WORDS - 1)]);
+            for(int i = random(2, 4); i > 0; i--) comment(1);
+            line(1, "x = " + expression(2, allow_call) + ";");
+        }
+
+        void function()
+        {
+            // Every eighth function is a leaf so call chains stay one deep
+            int  id        = num_functions++;
+            bool is_leaf   = (id % 8 == 0);
+
+            if(options.shape == SourceShape::COMMENT_HEAVY)
+                for(int i = random(1, 3); i > 0; i--) comment(0);
+
+            line(0, "fn_" + std::to_string(id) + "(a: int, b: int) -> int {");
+            switch(options.shape)
+            {
+                case SourceShape::SMALL_FUNCTIONS  : small_function_body(!is_leaf);               break;
+                case SourceShape::DEEP_NESTING     :
+                    line(1, "x : int = a;");
+                    nested_if(1, options.nesting_depth, !is_leaf);
+                break;
+                case SourceShape::LONG_EXPRESSIONS : long_expression_body(!is_leaf);              break;
+                case SourceShape::STRING_HEAVY     : string_heavy_body(!is_leaf);                 break;
+                case SourceShape::COMMENT_HEAVY    : comment_heavy_body(!is_leaf);                break;
+                default: break;
+            }
+            line(1, "return x;");
+            line(0, "}");
+            out += '\n';
+
+            if(is_leaf)
+                leaves.push_back(id);
+        }
+
+        void main_function()
+        {
+            line(0, "main() {");
+            std::string sum = "fn_0(1, 2)";
+            for(int i = 1; i < 8 && i < num_functions; i++)
+            {
+                int callee = random(0, num_functions - 1);
+                sum += " + fn_" + std::to_string(callee) + "(" + std::to_string(i) + ", 2)";
+            }
+            line(1, "print(\"checksum: \", " + sum + ");");
+            line(0, "}");
+        }
+
+        std::string run()
+        {
+            char header[128];
+            std::snprintf(header, sizeof(header), "// Generated: shape=%s seed=%u\n\n",
+                          shape_name(options.shape), options.seed);
+            out.reserve(options.target_bytes + 4096);
+            out += header;
+
+            do
+                function();
+            while(out.size() < options.target_bytes);
+
+            main_function();
+            return std::move(out);
+        }
+    };
+
+    const char* SHAPE_NAMES[] = {
+        "small_functions", "deep_nesting", "long_expressions", "string_heavy", "comment_heavy",
+    };
+    static_assert(sizeof(SHAPE_NAMES) / sizeof(SHAPE_NAMES[0]) == (size_t) SourceShape::SHAPE_COUNT,
+                  "Every shape needs a name");
+}
+
+std::string generate_source(const GeneratorOptions& options)
+{
+    return Generator(options).run();
+}
+
+const char* shape_name(SourceShape shape)
+{
+    return SHAPE_NAMES[(int) shape];
+}
+
+bool shape_from_name(const char* name, SourceShape& shape)
+{
+    for(int i = 0; i < (int) SourceShape::SHAPE_COUNT; i++)
+    {
+        if(strcmp(name, SHAPE_NAMES[i]) == 0)
+        {
+            shape = (SourceShape) i;
+            return true;
+        }
+    }
+    return false;
+}
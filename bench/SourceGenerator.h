@@ -0,0 +1,37 @@
+#pragma once
+#ifndef LANG_BENCH_SOURCE_GENERATOR_H
+#define LANG_BENCH_SOURCE_GENERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Shapes of synthetic programs, each stressing a different part of the front end
+enum class SourceShape
+{
+    SMALL_FUNCTIONS,    // Many short functions, a mix of everything
+    DEEP_NESTING,       // if/else chains nested nesting_depth levels deep
+    LONG_EXPRESSIONS,   // Binary operator chains of chain_length operands
+    STRING_HEAVY,       // print() calls with long string literals, some escaped
+    COMMENT_HEAVY,      // More comment than code
+    SHAPE_COUNT,
+};
+
+struct GeneratorOptions
+{
+    SourceShape shape        = SourceShape::SMALL_FUNCTIONS;
+    size_t      target_bytes = 1 << 20;    // Generation stops at the first function past this
+    uint32_t    seed         = 1;
+    int         nesting_depth = 32;
+    int         chain_length  = 64;
+};
+
+// Emits a program in the grammar accepted by ast::parse_declaration. Every
+// variable is declared before use and functions only ever call ones defined
+// before them, so the output is also a valid program to run, ending in main().
+std::string generate_source(const GeneratorOptions& options);
+
+const char* shape_name(SourceShape shape);
+bool        shape_from_name(const char* name, SourceShape& shape);
+
+#endif
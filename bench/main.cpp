@@ -0,0 +1,630 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "SourceGenerator.h"
+#include "ParserMicrobench.h"
+#include "InterpreterBench.h"
+#include "SourceFile.h"
+#include "CharScan.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "ParseProfile.h"
+#include "Declaration.h"
+#include "FlatAst.h"
+#include "AstCache.h"
+#include "ParallelLexer.h"
+#include "ParallelParser.h"
+#include "IncrementalLexer.h"
+#include "IncrementalParser.h"
+#include "PipelinedLexer.h"
+#include "ThreadPool.h"
+
+// Every allocation in the process goes through these so each phase can
+// report how many it made. Relaxed is enough, they're only read in between
+// phases once any worker threads are done.
+namespace
+{
+    std::atomic<uint64_t> num_allocations { 0 };
+    std::atomic<uint64_t> num_alloc_bytes { 0 };
+}
+
+void* operator new(size_t size)
+{
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    num_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    if(void* ptr = malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept         { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+
+struct PhaseResult
+{
+    const char* name;
+    double   seconds     = 0.0;     // Best of all iterations
+    uint64_t allocations = 0;       // From the last iteration, when the interner is warm
+    uint64_t alloc_bytes = 0;
+    bool     has_nodes   = false;   // Whether nodes/s means anything for this phase
+};
+
+struct ShapeResult
+{
+    std::string name;
+    size_t bytes  = 0;
+    size_t lines  = 0;
+    size_t tokens = 0;
+    size_t nodes  = 0;
+    size_t errors = 0;
+    size_t rewinds = 0;     // Times the parser went back over tokens
+    size_t tree_bytes = 0;  // Arena reserved for the node tree
+    size_t flat_bytes = 0;  // The same tree flattened
+    std::vector<PhaseResult> phases;
+    bool         profiled = false;
+    ParseProfile profile;   // Of one more parse, outside the timed ones
+};
+
+// Times one run of a phase and folds it into `result`
+struct PhaseTimer
+{
+    using Clock = std::chrono::steady_clock;
+
+    PhaseTimer(PhaseResult& result):
+        result(result), allocs_before(num_allocations.load()), bytes_before(num_alloc_bytes.load()),
+        start(Clock::now()) { }
+
+    ~PhaseTimer()
+    {
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if(result.seconds == 0.0 || seconds < result.seconds)
+            result.seconds = seconds;
+        result.allocations = num_allocations.load() - allocs_before;
+        result.alloc_bytes = num_alloc_bytes.load() - bytes_before;
+    }
+
+    PhaseResult& result;
+    uint64_t allocs_before;
+    uint64_t bytes_before;
+    Clock::time_point start;
+};
+
+struct Options
+{
+    int         shape        = -1;      // -1 runs every shape
+    const char* input_path   = nullptr;
+    const char* emit_path    = nullptr;
+    bool        json         = false;
+    bool        profile      = false;   // Also break each parse down by grammar rule
+    bool        micro        = false;   // Time each grammar rule on its own instead
+    bool        interp       = false;   // Or time the interpreter running small programs
+    int         scale        = 1;       // Of the interpreter's workloads
+    int         iterations   = 5;
+    unsigned    num_threads  = 0;
+    GeneratorOptions generator;
+};
+
+static void usage(const char* program)
+{
+    std::fprintf(stderr,
+        "usage: %s [--shape NAME | all] [--size BYTES] [--seed N] [--depth N] [--chain N]\n"
+        "          [--iterations N] [--threads N] [--scan scalar|sse2|avx2] [--json]\n"
+        "          [--emit FILE] [--input FILE] [--profile] [--micro] [--interp [--scale N]]\n"
+        "shapes:", program);
+    for(int i = 0; i < (int) SourceShape::SHAPE_COUNT; i++)
+        std::fprintf(stderr, " %s", shape_name((SourceShape) i));
+    std::fprintf(stderr, "\n");
+}
+
+static bool parse_options(int argc, char** argv, Options& options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        const char* arg   = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        bool takes_value  = true;
+
+        bool* flag = strcmp(arg, "--json")    == 0 ? &options.json    :
+                     strcmp(arg, "--profile") == 0 ? &options.profile :
+                     strcmp(arg, "--micro")   == 0 ? &options.micro   :
+                     strcmp(arg, "--interp")  == 0 ? &options.interp  : nullptr;
+        if(flag)
+        {
+            *flag       = true;
+            takes_value = false;
+        }
+        else if(!value)
+        {
+            std::fprintf(stderr, "[Error] %s expects a value\n", arg);
+            return false;
+        }
+        else if(strcmp(arg, "--shape") == 0)
+        {
+            SourceShape shape;
+            if(strcmp(value, "all") == 0)
+                options.shape = -1;
+            else if(shape_from_name(value, shape))
+                options.shape = (int) shape;
+            else
+            {
+                std::fprintf(stderr, "[Error] unknown shape: %s\n", value);
+                return false;
+            }
+        }
+        else if(strcmp(arg, "--scan") == 0)
+        {
+            scan::Impl impl;
+            if     (strcmp(value, "scalar") == 0) impl = scan::Impl::SCALAR;
+            else if(strcmp(value, "sse2")   == 0) impl = scan::Impl::SSE2;
+            else if(strcmp(value, "avx2")   == 0) impl = scan::Impl::AVX2;
+            else
+            {
+                std::fprintf(stderr, "[Error] unknown scanner: %s\n", value);
+                return false;
+            }
+            if(!scan::select_impl(impl))
+            {
+                std::fprintf(stderr, "[Error] %s isn't supported on this CPU\n", value);
+                return false;
+            }
+        }
+        else if(strcmp(arg, "--size")       == 0) options.generator.target_bytes  = std::strtoull(value, nullptr, 10);
+        else if(strcmp(arg, "--seed")       == 0) options.generator.seed          = (uint32_t) std::strtoul(value, nullptr, 10);
+        else if(strcmp(arg, "--depth")      == 0) options.generator.nesting_depth = std::atoi(value);
+        else if(strcmp(arg, "--chain")      == 0) options.generator.chain_length  = std::atoi(value);
+        else if(strcmp(arg, "--iterations") == 0) options.iterations              = std::atoi(value);
+        else if(strcmp(arg, "--scale")      == 0) options.scale                   = std::atoi(value);
+        else if(strcmp(arg, "--threads")    == 0) options.num_threads             = (unsigned) std::strtoul(value, nullptr, 10);
+        else if(strcmp(arg, "--emit")       == 0) options.emit_path               = value;
+        else if(strcmp(arg, "--input")      == 0) options.input_path              = value;
+        else
+        {
+            std::fprintf(stderr, "[Error] unknown option: %s\n", arg);
+            return false;
+        }
+        if(takes_value)
+            i++;
+    }
+    if(options.iterations < 1)
+        options.iterations = 1;
+    if(options.scale < 1)
+        options.scale = 1;
+    return true;
+}
+
+static void setup_lexer(LexerState& lexer, std::string_view source)
+{
+    lexer.input_string = source;
+    lexer.input_len    = source.size();
+}
+
+static void setup_parser(ParserState& parser, const LexerState& lexer)
+{
+    parser.status = PARSE_SUCCESS;
+    parser.lexer  = &lexer;
+}
+
+static ShapeResult run_benchmark(const std::string& name, std::string_view source,
+                                 const Options& options, ThreadPool& pool)
+{
+    ShapeResult result;
+    result.name  = name;
+    result.bytes = source.size();
+    result.lines = std::count(source.begin(), source.end(), '\n') + 1;
+
+    PhaseResult lex      { "lex" };
+    PhaseResult parse    { "parse" };
+    PhaseResult teardown { "teardown" };
+    PhaseResult flatten  { "flatten" };
+    PhaseResult parallel { "lex_parallel" };
+    PhaseResult par_parse{ "parse_parallel" };
+    PhaseResult pipeline { "pipeline" };
+    PhaseResult relex    { "relex_edit" };
+    PhaseResult reparse  { "reparse_edit" };
+    PhaseResult store    { "cache_store" };
+    PhaseResult load     { "cache_load" };
+    parse.has_nodes = teardown.has_nodes = flatten.has_nodes = par_parse.has_nodes = pipeline.has_nodes = true;
+    store.has_nodes = load.has_nodes = true;
+
+    for(int i = 0; i < options.iterations; i++)
+    {
+        LexerState lexer;
+        setup_lexer(lexer, source);
+        {
+            PhaseTimer timer(lex);
+            lexer.tokenize_string();
+        }
+        result.tokens = lexer.tokens.size();
+
+        ParserState parser;
+        setup_parser(parser, lexer);
+        parser.token_stream = lexer.tokens.data();
+        parser.curr_token   = 0;
+
+        ast::ParseResult program;
+        {
+            PhaseTimer timer(parse);
+            program = ast::parse_program(&parser);
+        }
+        result.nodes      = parser.num_nodes;
+        result.errors     = parser.errors.size();
+        result.rewinds    = parser.num_rewinds;
+        result.tree_bytes = program.arena->bytes_reserved();
+        {
+            PhaseTimer timer(flatten);
+            result.flat_bytes = ast::flatten(program.root, parser.num_nodes).memory_bytes();
+        }
+        {
+            PhaseTimer timer(teardown);
+            program = {};
+        }
+    }
+
+    if(options.profile)
+    {
+        LexerState lexer;
+        setup_lexer(lexer, source);
+        lexer.tokenize_string();
+
+        ParserState parser;
+        setup_parser(parser, lexer);
+        parser.token_stream = lexer.tokens.data();
+        parser.curr_token   = 0;
+        parser.profile      = &result.profile;
+        ast::parse_program(&parser);
+        result.profiled = true;
+    }
+
+    for(int i = 0; i < options.iterations; i++)
+    {
+        LexerState lexer;
+        setup_lexer(lexer, source);
+        PhaseTimer timer(parallel);
+        tokenize_parallel(lexer, pool);
+    }
+
+    for(int i = 0; i < options.iterations; i++)
+    {
+        LexerState lexer;
+        setup_lexer(lexer, source);
+        lexer.tokenize_string();
+
+        ParserState parser;
+        setup_parser(parser, lexer);
+        parser.token_stream = lexer.tokens.data();
+        parser.curr_token   = 0;
+
+        ast::ParseResult program;
+        {
+            PhaseTimer timer(par_parse);
+            program = ast::parse_program_parallel(&parser, pool);
+        }
+        if(parser.num_nodes != result.nodes || parser.errors.size() != result.errors)
+            std::fprintf(stderr, "[Error] %s: the parallel parse doesn't match the sequential one\n", name.c_str());
+    }
+
+    for(int i = 0; i < options.iterations; i++)
+    {
+        LexerState lexer;
+        setup_lexer(lexer, source);
+        ParserState parser;
+        setup_parser(parser, lexer);
+
+        ast::ParseResult program;
+        {
+            PhaseTimer timer(pipeline);
+            PipelinedLexer pipelined(lexer);
+            pipelined.start();
+            parser.attach_source(&pipelined);
+            program = ast::parse_program(&parser);
+            pipelined.finish();
+        }
+    }
+
+    // A single line inserted halfway through, right where the line before
+    // it was inserted, so the gap is already there as it is while typing.
+    // The throughput columns are relative to the whole source so they show
+    // the saving over lexing it all.
+    const char* middle    = (const char*) memchr(source.data() + source.size() / 2, '\n', source.size() - source.size() / 2);
+    size_t      edit_at   = middle ? middle - source.data() + 1 : source.size();
+    TextEdit    edit      = { edit_at, 0, "// edited\n" };
+    std::string edited(source);
+    apply_edit(edited, edit);
+    std::string edited_twice(edited);
+    apply_edit(edited_twice, edit);
+
+    for(int i = 0; i < options.iterations; i++)
+    {
+        IncrementalLexer lexer;
+        lexer.tokenize(source);
+        lexer.retokenize_edit(edited, edit);
+
+        PhaseTimer timer(relex);
+        lexer.retokenize_edit(edited_twice, edit);
+    }
+
+    // One statement changed in the middle of the source, the rest of the
+    // declarations should come straight from the cache
+    const char* mid_return = strstr(source.data() + source.size() / 2, "return x;");
+    TextEdit    body_edit  = mid_return ? TextEdit { (size_t) (mid_return - source.data()) + 8, 0, " + 1" } : edit;
+    std::string edited_body(source);
+    apply_edit(edited_body, body_edit);
+
+    for(int i = 0; i < options.iterations; i++)
+    {
+        IncrementalLexer lexer;
+        lexer.tokenize(source);
+
+        ParserState parser;
+        setup_parser(parser, lexer.state());
+        ast::IncrementalParser incremental;
+        incremental.parse(&parser, lexer);
+
+        TokenSplice splice;
+        lexer.retokenize_edit(edited_body, body_edit, &splice);
+        ParserState reparser;
+        setup_parser(reparser, lexer.state());
+
+        PhaseTimer timer(reparse);
+        incremental.parse(&reparser, lexer, &splice);
+    }
+
+    // What a second run over an unchanged source does instead of lexing and
+    // parsing it, hashing the source included
+    std::error_code error;
+    std::string     cache_dir = (std::filesystem::temp_directory_path(error) / "lang_bench_ast_cache").string();
+    ast::AstCache   cache(cache_dir);
+    {
+        LexerState lexer;
+        setup_lexer(lexer, source);
+        lexer.tokenize_string();
+
+        ParserState parser;
+        setup_parser(parser, lexer);
+        parser.token_stream = lexer.tokens.data();
+        parser.curr_token   = 0;
+
+        ast::ParseResult program = ast::parse_program(&parser);
+        ast::FlatAst     flat    = ast::flatten(program.root, parser.num_nodes);
+        for(int i = 0; i < options.iterations; i++)
+        {
+            PhaseTimer timer(store);
+            cache.store(ast::source_key(source), flat, { lexer.tokens.size(), parser.num_nodes });
+        }
+    }
+    for(int i = 0; i < options.iterations; i++)
+    {
+        ast::FlatAst flat;
+        bool loaded;
+        {
+            PhaseTimer timer(load);
+            loaded = cache.load(ast::source_key(source), flat);
+        }
+        if(!loaded)
+            std::fprintf(stderr, "[Error] %s: could not load the tree back from %s\n", name.c_str(), cache_dir.c_str());
+    }
+    std::filesystem::remove_all(cache_dir, error);
+
+    result.phases = { lex, parse, flatten, teardown, parallel, par_parse, pipeline, relex, reparse, store, load };
+    return result;
+}
+
+static double per_second(double amount, double seconds)
+{
+    return seconds > 0.0 ? amount / seconds : 0.0;
+}
+
+static void print_table(const std::vector<ShapeResult>& results)
+{
+    for(const ShapeResult& shape : results)
+    {
+        std::printf("%s: %.2f MB, %zu lines, %zu tokens, %zu AST nodes, %zu errors, %zu parser rewinds\n",
+                    shape.name.c_str(), shape.bytes / 1e6, shape.lines, shape.tokens, shape.nodes, shape.errors,
+                    shape.rewinds);
+        std::printf("    AST: %.2f MB as a tree, %.2f MB flattened\n", shape.tree_bytes / 1e6, shape.flat_bytes / 1e6);
+        std::printf("    %-14s %10s %10s %10s %10s %12s %12s\n",
+                    "phase", "ms", "MB/s", "Mtok/s", "Mnode/s", "allocs", "alloc KB");
+        for(const PhaseResult& phase : shape.phases)
+        {
+            char nodes_per_s[32] = "-";
+            if(phase.has_nodes)
+                std::snprintf(nodes_per_s, sizeof(nodes_per_s), "%.2f", per_second(shape.nodes, phase.seconds) / 1e6);
+
+            std::printf("    %-14s %10.3f %10.1f %10.2f %10s %12llu %12.1f\n",
+                        phase.name, phase.seconds * 1e3,
+                        per_second(shape.bytes, phase.seconds) / 1e6,
+                        per_second(shape.tokens, phase.seconds) / 1e6,
+                        nodes_per_s, (unsigned long long) phase.allocations, phase.alloc_bytes / 1024.0);
+        }
+        if(shape.profiled)
+        {
+            std::printf("    parse by grammar rule, times include nested rules:\n");
+            shape.profile.print_table(stdout);
+        }
+        std::printf("\n");
+    }
+}
+
+static void print_json(const std::vector<ShapeResult>& results, const Options& options, unsigned num_threads)
+{
+    std::printf("{\n  \"scan_impl\": \"%s\",\n  \"threads\": %u,\n  \"iterations\": %d,\n  \"seed\": %u,\n  \"results\": [\n",
+                scan::impl_name(scan::active_impl()), num_threads, options.iterations, options.generator.seed);
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        const ShapeResult& shape = results[i];
+        std::printf("    {\n      \"shape\": \"%s\", \"bytes\": %zu, \"lines\": %zu, \"tokens\": %zu, \"nodes\": %zu, \"errors\": %zu,\n"
+                    "      \"rewinds\": %zu, \"tree_bytes\": %zu, \"flat_bytes\": %zu,\n"
+                    "      \"phases\": {\n",
+                    shape.name.c_str(), shape.bytes, shape.lines, shape.tokens, shape.nodes, shape.errors,
+                    shape.rewinds, shape.tree_bytes, shape.flat_bytes);
+        for(size_t p = 0; p < shape.phases.size(); p++)
+        {
+            const PhaseResult& phase = shape.phases[p];
+            std::printf("        \"%s\": { \"seconds\": %.9f, \"mb_per_s\": %.3f, \"tokens_per_s\": %.0f, "
+                        "\"nodes_per_s\": %.0f, \"allocations\": %llu, \"alloc_bytes\": %llu }%s\n",
+                        phase.name, phase.seconds,
+                        per_second(shape.bytes, phase.seconds) / 1e6,
+                        per_second(shape.tokens, phase.seconds),
+                        phase.has_nodes ? per_second(shape.nodes, phase.seconds) : 0.0,
+                        (unsigned long long) phase.allocations, (unsigned long long) phase.alloc_bytes,
+                        p + 1 < shape.phases.size() ? "," : "");
+        }
+        std::printf("      }");
+        if(shape.profiled)
+            std::printf(",\n      \"profile\": %s", shape.profile.to_json().c_str());
+        std::printf("\n    }%s\n", i + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ]\n}\n");
+}
+
+static void print_micro_table(const std::vector<MicroResult>& results)
+{
+    std::printf("%-18s %10s %10s %10s %10s %10s  %s\n", "rule", "copies", "ms", "ns/copy", "MB/s", "Mtok/s", "snippet");
+    for(const MicroResult& micro : results)
+    {
+        std::printf("%-18s %10zu %10.3f %10.1f %10.1f %10.2f  %s%s\n",
+                    micro.name, micro.instances, micro.seconds * 1e3,
+                    micro.instances ? micro.seconds * 1e9 / micro.instances : 0.0,
+                    per_second(micro.bytes, micro.seconds) / 1e6, per_second(micro.tokens, micro.seconds) / 1e6,
+                    micro.snippet, micro.ok ? "" : "  [did not parse]");
+    }
+}
+
+static void print_micro_json(const std::vector<MicroResult>& results, const Options& options)
+{
+    std::printf("{\n  \"iterations\": %d,\n  \"micro\": [\n", options.iterations);
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        const MicroResult& micro = results[i];
+        std::printf("    { \"rule\": \"%s\", \"ok\": %s, \"instances\": %zu, \"bytes\": %zu, \"tokens\": %zu, \"nodes\": %zu, "
+                    "\"seconds\": %.9f, \"ns_per_instance\": %.1f, \"mb_per_s\": %.3f, \"tokens_per_s\": %.0f }%s\n",
+                    micro.name, micro.ok ? "true" : "false", micro.instances, micro.bytes, micro.tokens, micro.nodes,
+                    micro.seconds, micro.instances ? micro.seconds * 1e9 / micro.instances : 0.0,
+                    per_second(micro.bytes, micro.seconds) / 1e6, per_second(micro.tokens, micro.seconds),
+                    i + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ]\n}\n");
+}
+
+static void print_interp_table(const std::vector<InterpResult>& results)
+{
+    std::printf("%-12s %-10s %-20s %12s %10s %10s %10s %8s %20s\n",
+                "program", "engine", "call", "calls", "ms", "ns/call", "Mcalls/s", "speedup", "result");
+    for(const InterpResult& interp : results)
+    {
+        std::printf("%-12s %-10s %-20s %12" PRIu64 " %10.3f %10.1f %10.2f %7.2fx %20" PRId64 "%s\n",
+                    interp.name, ast::engine_name(interp.engine), interp.call.c_str(), interp.calls, interp.seconds * 1e3,
+                    interp.calls ? interp.seconds * 1e9 / interp.calls : 0.0, per_second(interp.calls, interp.seconds) / 1e6,
+                    interp.speedup, interp.result, interp.ok ? "" : "  [failed]");
+    }
+}
+
+static void print_interp_json(const std::vector<InterpResult>& results, const Options& options)
+{
+    std::printf("{\n  \"iterations\": %d,\n  \"scale\": %d,\n  \"interpreter\": [\n", options.iterations, options.scale);
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        const InterpResult& interp = results[i];
+        std::printf("    { \"program\": \"%s\", \"engine\": \"%s\", \"call\": \"%s\", \"ok\": %s, \"calls\": %" PRIu64 ", "
+                    "\"result\": %" PRId64 ", \"seconds\": %.9f, \"ns_per_call\": %.1f, \"calls_per_s\": %.0f, \"speedup\": %.3f }%s\n",
+                    interp.name, ast::engine_name(interp.engine), interp.call.c_str(), interp.ok ? "true" : "false",
+                    interp.calls, interp.result, interp.seconds, interp.calls ? interp.seconds * 1e9 / interp.calls : 0.0,
+                    per_second(interp.calls, interp.seconds), interp.speedup, i + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ]\n}\n");
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if(!parse_options(argc, argv, options))
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    if(options.micro)
+    {
+        std::vector<MicroResult> micro = run_parser_microbenchmarks(options.generator.target_bytes, options.iterations);
+        if(options.json)
+            print_micro_json(micro, options);
+        else
+            print_micro_table(micro);
+
+        for(const MicroResult& result : micro)
+            if(!result.ok)
+                return 1;
+        return 0;
+    }
+
+    if(options.interp)
+    {
+        std::vector<InterpResult> interp = run_interpreter_benchmarks(options.scale, options.iterations);
+        if(options.json)
+            print_interp_json(interp, options);
+        else
+            print_interp_table(interp);
+
+        for(const InterpResult& result : interp)
+            if(!result.ok)
+                return 1;
+        return 0;
+    }
+
+    ThreadPool pool(options.num_threads);
+    std::vector<ShapeResult> results;
+
+    if(options.input_path)
+    {
+        SourceFile source;
+        if(!source.load(options.input_path))
+        {
+            std::fprintf(stderr, "[Error] could not load file: %s\n", options.input_path);
+            return -1;
+        }
+        results.push_back(run_benchmark(options.input_path, source.view(), options, pool));
+    }
+    else
+    {
+        int first = options.shape < 0 ? 0 : options.shape;
+        int last  = options.shape < 0 ? (int) SourceShape::SHAPE_COUNT - 1 : options.shape;
+        for(int shape = first; shape <= last; shape++)
+        {
+            GeneratorOptions generator = options.generator;
+            generator.shape = (SourceShape) shape;
+            std::string source = generate_source(generator);
+
+            if(options.emit_path)
+            {
+                // Several shapes go to separate files, suffixed with the shape name
+                std::string path = options.emit_path;
+                if(first != last)
+                    path += std::string(".") + shape_name(generator.shape);
+                std::ofstream(path, std::ios::binary) << source;
+            }
+            results.push_back(run_benchmark(shape_name(generator.shape), source, options, pool));
+        }
+    }
+
+    if(options.json)
+        print_json(results, options, pool.size());
+    else
+        print_table(results);
+
+    // Generated sources are expected to parse cleanly, treat anything else as a regression
+    for(const ShapeResult& shape : results)
+        if(shape.errors != 0)
+            return 1;
+    return 0;
+}
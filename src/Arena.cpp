@@ -0,0 +1,41 @@
+#include "Arena.h"
+
+#include <string.h>
+#include <algorithm>
+
+// Blocks double in size up to this, so large parses take a handful of
+// blocks without small ones reserving much
+static const size_t MAX_BLOCK_SIZE = 4 * 1024 * 1024;
+
+void* Arena::allocate_slow(size_t size, size_t align)
+{
+    size_t block_size = std::max(next_block_size, size + align);
+    next_block_size   = std::min(next_block_size * 2, MAX_BLOCK_SIZE);
+
+    blocks.emplace_back(new char[block_size]);
+    reserved += block_size;
+    curr = blocks.back().get();
+    end  = curr + block_size;
+    return allocate(size, align);
+}
+
+void Arena::adopt(Arena& other)
+{
+    for(auto& block : other.blocks)
+        blocks.push_back(std::move(block));
+    reserved += other.reserved;
+
+    other.blocks.clear();
+    other.curr     = other.end = nullptr;
+    other.reserved = 0;
+}
+
+std::string_view Arena::copy(std::string_view text)
+{
+    if(text.empty())
+        return std::string_view();
+
+    char* chars = static_cast<char*>(allocate(text.size(), 1));
+    memcpy(chars, text.data(), text.size());
+    return std::string_view(chars, text.size());
+}
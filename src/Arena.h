@@ -0,0 +1,58 @@
+#pragma once
+#ifndef LANG_ARENA_H
+#define LANG_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Bump allocator handing out memory from a few large blocks that are all
+// released together when the arena goes away. Destructors are never run, so
+// anything allocated here must not own memory of its own.
+class Arena
+{
+    public:
+        explicit Arena(size_t first_block_size = 64 * 1024):
+            next_block_size(first_block_size) { }
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        void* allocate(size_t size, size_t align)
+        {
+            uintptr_t aligned = (reinterpret_cast<uintptr_t>(curr) + align - 1) & ~(uintptr_t) (align - 1);
+            if(aligned + size > reinterpret_cast<uintptr_t>(end))
+                return allocate_slow(size, align);
+
+            curr = reinterpret_cast<char*>(aligned + size);
+            return reinterpret_cast<void*>(aligned);
+        }
+
+        template<typename T, typename... Args>
+        T* make(Args&&... args)
+        {
+            return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        // Copies `text` into the arena so it lives as long as the arena does
+        std::string_view copy(std::string_view text);
+
+        // Takes over every block of `other`, leaving it empty. What was
+        // allocated from it now lives as long as this arena does.
+        void adopt(Arena& other);
+
+        size_t bytes_reserved() const { return reserved; }
+    private:
+        void* allocate_slow(size_t size, size_t align);
+
+        char*  curr = nullptr;
+        char*  end  = nullptr;
+        size_t next_block_size;
+        size_t reserved = 0;
+        std::vector<std::unique_ptr<char[]>> blocks;
+};
+
+#endif
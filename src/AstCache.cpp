@@ -0,0 +1,410 @@
+#include "AstCache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "Hash.h"
+#include "Interner.h"
+#include "SourceFile.h"
+
+namespace fs = std::filesystem;
+
+namespace ast
+{
+    namespace
+    {
+        const char     MAGIC[8]        = { 'L', 'A', 'N', 'G', 'A', 'S', 'T', '\0' };
+        const uint32_t FORMAT_VERSION  = 2;
+        const uint32_t BYTE_ORDER_MARK = 0x01020304;
+        const size_t   ALIGNMENT       = 8;
+
+        enum Section
+        {
+            FUNCTIONS, PARAMS, BLOCKS, STMTS, EXPRS, STMT_LISTS, EXPR_LISTS,
+            INTS, FLOATS, STRINGS, CHARS,
+            NAMES, NAME_CHARS,      // The symbols used, in file order
+            NUM_SECTIONS
+        };
+
+        const size_t ELEMENT_SIZE[NUM_SECTIONS] = {
+            sizeof(FlatFunction), sizeof(FlatParam), sizeof(FlatBlock), sizeof(FlatStmt), sizeof(FlatExpr),
+            sizeof(NodeIndex), sizeof(NodeIndex), sizeof(int64_t), sizeof(double), sizeof(FlatString), 1,
+            sizeof(FlatString), 1,
+        };
+
+        struct SectionEntry
+        {
+            uint64_t offset;
+            uint64_t count;
+        };
+
+        struct FileHeader
+        {
+            char     magic[8];
+            uint32_t format_version;
+            uint32_t byte_order;
+            uint64_t build_hash;        // See build_hash()
+            uint64_t source_hash;
+            uint64_t source_size;
+            uint64_t file_size;
+            uint64_t file_hash;         // See file_hash()
+            uint64_t num_tokens;
+            uint64_t num_nodes;
+            SectionEntry sections[NUM_SECTIONS];
+        };
+
+        // Changes whenever a file written by another build might not mean
+        // the same thing to this one
+        uint64_t build_hash()
+        {
+            uint64_t h = hash::string(LANG_VERSION);
+            h = hash::combine(h, FORMAT_VERSION);
+            for(size_t size : ELEMENT_SIZE)
+                h = hash::combine(h, size);
+            return h;
+        }
+
+        // Of the whole file, taking its header's file_hash as zero, so the
+        // section table is covered as well as the sections
+        uint64_t file_hash(std::string_view data)
+        {
+            FileHeader header;
+            memcpy(&header, data.data(), sizeof(FileHeader));
+            header.file_hash = 0;
+            return hash::bytes(data.data() + sizeof(FileHeader), data.size() - sizeof(FileHeader),
+                               hash::bytes(&header, sizeof(FileHeader)));
+        }
+
+        // Every index in `ast` is in range and points at a node of the kind
+        // it should, and no node is used twice, operands coming before the
+        // expressions using them. Walking the tree from its functions then
+        // stays in bounds and comes to an end. The file hash makes a bad file
+        // that gets this far unlikely, not impossible.
+        bool well_formed(const FlatAst& ast)
+        {
+            auto is_type = [](Type_t::Value type) { return (uint32_t) type <= Type_t::POINTER; };
+            auto in_list = [](uint32_t first, uint32_t count, size_t size) { return first <= size && count <= size - first; };
+
+            std::vector<uint8_t> expr_used(ast.exprs.size()), stmt_used(ast.stmts.size()), block_used(ast.blocks.size());
+            auto use = [](std::vector<uint8_t>& used, uint32_t idx)
+            {
+                if(idx == NO_NODE)
+                    return true;
+                if(idx >= used.size() || used[idx])
+                    return false;
+                used[idx] = 1;
+                return true;
+            };
+            auto operand = [&](uint32_t idx, size_t user) { return idx == NO_NODE || (idx < user && use(expr_used, idx)); };
+
+            for(const FlatString& str : ast.strings)
+                if(!in_list(str.offset, str.length, ast.chars.size()))
+                    return false;
+
+            for(size_t i = 0; i < ast.exprs.size(); i++)
+            {
+                const FlatExpr& expr = ast.exprs[i];
+                bool ok = true;
+                switch(expr.type)
+                {
+                    case Expr_t::IDENTIFIER    : ok = expr.a != NO_SYMBOL;           break;
+                    case Expr_t::INT_LITERAL   : ok = expr.a < ast.ints.size();      break;
+                    case Expr_t::FLOAT_LITERAL : ok = expr.a < ast.floats.size();    break;
+                    case Expr_t::STRING_LITERAL: ok = expr.a < ast.strings.size();   break;
+                    case Expr_t::CALL:
+                        ok = expr.a != NO_SYMBOL && in_list(expr.b, expr.c, ast.expr_lists.size());
+                        for(uint32_t arg = 0; ok && arg < expr.c; arg++)
+                            ok = operand(ast.expr_lists[expr.b + arg], i);
+                    break;
+                    default:
+                        ok = expr.type < Expr_t::CALL && operand(expr.a, i) && operand(expr.b, i);
+                    break;
+                }
+                if(!ok)
+                    return false;
+            }
+
+            for(const FlatStmt& stmt : ast.stmts)
+            {
+                bool ok = use(expr_used, stmt.a);
+                switch(stmt.type)
+                {
+                    case Stmt_t::IF:
+                        ok = ok && use(block_used, stmt.b) && use(block_used, stmt.c);
+                    break;
+                    case Stmt_t::DECL:
+                        ok = ok && stmt.b != NO_SYMBOL && is_type((Type_t::Value) stmt.c);
+                    break;
+                    case Stmt_t::EXPR:
+                    case Stmt_t::RETURN:
+                    break;
+                    default:
+                        ok = false;
+                    break;
+                }
+                if(!ok)
+                    return false;
+            }
+
+            for(const FlatBlock& block : ast.blocks)
+            {
+                if(block.count == 0 || !in_list(block.first, block.count, ast.stmt_lists.size()))
+                    return false;
+                for(uint32_t i = 0; i < block.count; i++)
+                    if(ast.stmt_lists[block.first + i] == NO_NODE || !use(stmt_used, ast.stmt_lists[block.first + i]))
+                        return false;
+            }
+
+            for(const FlatParam& param : ast.params)
+                if(param.name == NO_SYMBOL || !is_type(param.type))
+                    return false;
+            for(const FlatFunction& func : ast.functions)
+                if(func.name == NO_SYMBOL || !is_type(func.return_type) ||
+                   !in_list(func.first_param, func.num_params, ast.params.size()) || !use(block_used, func.body))
+                    return false;
+            return true;
+        }
+
+        // Symbols in the arrays are replaced by indices into NAMES on the
+        // way out and by this process' symbols on the way in
+        class SymbolWriter
+        {
+            public:
+                uint32_t operator()(Symbol sym)
+                {
+                    if(sym == NO_SYMBOL)
+                        return NO_SYMBOL;
+                    auto [it, inserted] = local.emplace(sym, (uint32_t) names.size());
+                    if(inserted)
+                    {
+                        std::string_view name = Interner::global().name(sym);
+                        names.push_back({ (uint32_t) chars.size(), (uint32_t) name.size() });
+                        chars.append(name);
+                    }
+                    return it->second;
+                }
+
+                std::vector<FlatString> names;
+                std::string             chars;
+            private:
+                std::unordered_map<Symbol, uint32_t> local;
+        };
+
+        void append_section(std::string& out, FileHeader& header, Section section, const void* data, size_t count)
+        {
+            out.resize((out.size() + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT, '\0');
+            header.sections[section] = { out.size(), count };
+            out.append(static_cast<const char*>(data), count * ELEMENT_SIZE[section]);
+        }
+
+        template<typename T>
+        void append_section(std::string& out, FileHeader& header, Section section, const std::vector<T>& items)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "sections are written as raw bytes");
+            append_section(out, header, section, items.data(), items.size());
+        }
+
+        template<typename T>
+        void read_section(std::string_view data, const FileHeader& header, Section section, std::vector<T>& items)
+        {
+            const SectionEntry& entry = header.sections[section];
+            items.resize(entry.count);
+            if(entry.count > 0)
+                memcpy(items.data(), data.data() + entry.offset, entry.count * sizeof(T));
+        }
+    }
+
+    SourceKey source_key(std::string_view source)
+    {
+        return { hash::string(source), source.size() };
+    }
+
+    std::string write_flat_ast(const FlatAst& ast, const SourceKey& key, const CachedStats& stats)
+    {
+        SymbolWriter symbols;
+
+        std::vector<FlatFunction> functions = ast.functions;
+        for(FlatFunction& func : functions)
+            func.name = symbols(func.name);
+
+        std::vector<FlatParam> params = ast.params;
+        for(FlatParam& param : params)
+            param.name = symbols(param.name);
+
+        std::vector<FlatStmt> stmts = ast.stmts;
+        for(FlatStmt& stmt : stmts)
+            if(stmt.type == Stmt_t::DECL)
+                stmt.b = symbols(stmt.b);
+
+        std::vector<FlatExpr> exprs = ast.exprs;
+        for(FlatExpr& expr : exprs)
+            if(expr.type == Expr_t::IDENTIFIER || expr.type == Expr_t::CALL)
+                expr.a = symbols(expr.a);
+
+        FileHeader header = {};
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.format_version = FORMAT_VERSION;
+        header.byte_order     = BYTE_ORDER_MARK;
+        header.build_hash     = build_hash();
+        header.source_hash    = key.hash;
+        header.source_size    = key.size;
+        header.num_tokens     = stats.num_tokens;
+        header.num_nodes      = stats.num_nodes;
+
+        std::string out(sizeof(FileHeader), '\0');
+        append_section(out, header, FUNCTIONS,  functions);
+        append_section(out, header, PARAMS,     params);
+        append_section(out, header, BLOCKS,     ast.blocks);
+        append_section(out, header, STMTS,      stmts);
+        append_section(out, header, EXPRS,      exprs);
+        append_section(out, header, STMT_LISTS, ast.stmt_lists);
+        append_section(out, header, EXPR_LISTS, ast.expr_lists);
+        append_section(out, header, INTS,       ast.ints);
+        append_section(out, header, FLOATS,     ast.floats);
+        append_section(out, header, STRINGS,    ast.strings);
+        append_section(out, header, CHARS,      ast.chars.data(), ast.chars.size());
+        append_section(out, header, NAMES,      symbols.names);
+        append_section(out, header, NAME_CHARS, symbols.chars.data(), symbols.chars.size());
+
+        header.file_size    = out.size();
+        memcpy(&out[0], &header, sizeof(FileHeader));
+        header.file_hash = file_hash(out);
+        memcpy(&out[0], &header, sizeof(FileHeader));
+        return out;
+    }
+
+    bool read_flat_ast(std::string_view data, const SourceKey& key, FlatAst& ast, CachedStats* stats)
+    {
+        FileHeader header;
+        if(data.size() < sizeof(FileHeader))
+            return false;
+        memcpy(&header, data.data(), sizeof(FileHeader));
+
+        if(memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.format_version != FORMAT_VERSION ||
+           header.byte_order != BYTE_ORDER_MARK || header.build_hash != build_hash() ||
+           header.source_hash != key.hash || header.source_size != key.size || header.file_size != data.size())
+            return false;
+
+        for(int section = 0; section < NUM_SECTIONS; section++)
+        {
+            const SectionEntry& entry = header.sections[section];
+            if(entry.offset < sizeof(FileHeader) || entry.offset > data.size() || entry.offset % ALIGNMENT != 0 ||
+               entry.count > (data.size() - entry.offset) / ELEMENT_SIZE[section])
+                return false;
+        }
+        if(file_hash(data) != header.file_hash)
+            return false;
+
+        read_section(data, header, FUNCTIONS,  ast.functions);
+        read_section(data, header, PARAMS,     ast.params);
+        read_section(data, header, BLOCKS,     ast.blocks);
+        read_section(data, header, STMTS,      ast.stmts);
+        read_section(data, header, EXPRS,      ast.exprs);
+        read_section(data, header, STMT_LISTS, ast.stmt_lists);
+        read_section(data, header, EXPR_LISTS, ast.expr_lists);
+        read_section(data, header, INTS,       ast.ints);
+        read_section(data, header, FLOATS,     ast.floats);
+        read_section(data, header, STRINGS,    ast.strings);
+        ast.chars.assign(data.data() + header.sections[CHARS].offset, header.sections[CHARS].count);
+
+        std::vector<FlatString> names;
+        read_section(data, header, NAMES, names);
+        std::string_view name_chars = data.substr(header.sections[NAME_CHARS].offset, header.sections[NAME_CHARS].count);
+
+        std::vector<Symbol> symbols;
+        symbols.reserve(names.size());
+        for(const FlatString& name : names)
+        {
+            if(name.offset > name_chars.size() || name.length > name_chars.size() - name.offset)
+                return false;
+            symbols.push_back(Interner::global().intern(name_chars.substr(name.offset, name.length)));
+        }
+
+        bool valid = true;
+        auto symbol = [&](uint32_t idx)
+        {
+            if(idx == NO_SYMBOL)
+                return NO_SYMBOL;
+            if(idx >= symbols.size())
+            {
+                valid = false;
+                return NO_SYMBOL;
+            }
+            return symbols[idx];
+        };
+        for(FlatFunction& func : ast.functions)
+            func.name = symbol(func.name);
+        for(FlatParam& param : ast.params)
+            param.name = symbol(param.name);
+        for(FlatStmt& stmt : ast.stmts)
+            if(stmt.type == Stmt_t::DECL)
+                stmt.b = symbol(stmt.b);
+        for(FlatExpr& expr : ast.exprs)
+            if(expr.type == Expr_t::IDENTIFIER || expr.type == Expr_t::CALL)
+                expr.a = symbol(expr.a);
+
+        valid = valid && well_formed(ast);
+        if(valid && stats)
+        {
+            stats->num_tokens = header.num_tokens;
+            stats->num_nodes  = header.num_nodes;
+        }
+        return valid;
+    }
+
+    std::string AstCache::path_for(const SourceKey& key) const
+    {
+        char name[40];
+        snprintf(name, sizeof(name), "%016llx.ast",
+                 (unsigned long long) hash::combine(key.hash, hash::string(LANG_VERSION)));
+        return (fs::path(directory) / name).string();
+    }
+
+    bool AstCache::load(const SourceKey& key, FlatAst& ast, CachedStats* stats) const
+    {
+        SourceFile file;
+        if(!file.load(path_for(key).c_str()))
+            return false;
+        return read_flat_ast(file.view(), key, ast, stats);
+    }
+
+    bool AstCache::store(const SourceKey& key, const FlatAst& ast, const CachedStats& stats) const
+    {
+        std::error_code error;
+        fs::create_directories(directory, error);
+        if(error)
+            return false;
+
+        // Unique to this thread and moment, two writers of the same file
+        // each rename a whole one into place
+        std::string path = path_for(key);
+        std::string temp_path = path + ".tmp" +
+            std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()) ^
+                           (size_t) std::chrono::steady_clock::now().time_since_epoch().count());
+        {
+            std::string contents = write_flat_ast(ast, key, stats);
+            std::ofstream file(temp_path, std::ios::binary);
+            if(!file.write(contents.data(), contents.size()) || !file.flush())
+            {
+                file.close();
+                fs::remove(temp_path, error);
+                return false;
+            }
+        }
+        fs::rename(temp_path, path, error);
+        if(error)
+        {
+            fs::remove(temp_path, error);
+            return false;
+        }
+        return true;
+    }
+}
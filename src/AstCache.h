@@ -0,0 +1,74 @@
+#pragma once
+#ifndef LANG_AST_CACHE_H
+#define LANG_AST_CACHE_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "FlatAst.h"
+
+#ifndef LANG_VERSION
+    #define LANG_VERSION "dev"
+#endif
+
+// Flattened trees kept on disk so a source that hasn't changed since it was
+// last compiled needn't be lexed or parsed again, not even by a new process.
+//
+// A cache file is the FlatAst's arrays written out as they are in memory,
+// each 8-byte aligned, behind a fixed-size header giving where each one
+// starts. Loading maps the file, checks the header and copies the arrays
+// straight out. Symbols only mean something within one process, so the file
+// carries the names it uses and those are interned again on load.
+//
+// Files are named after a hash of the source bytes and of LANG_VERSION. The
+// header repeats both, with the source size and a hash of the whole file, so
+// a file is never used for another source, by another build, or after being
+// cut short or damaged. Every index in the arrays is checked as well before
+// the tree is handed out. It's native-endian, only meant to be read back on
+// the machine that wrote it.
+namespace ast
+{
+    // What a cache file is looked up by
+    struct SourceKey
+    {
+        uint64_t hash;
+        uint64_t size;
+    };
+    SourceKey source_key(std::string_view source);
+
+    // Kept next to the tree for callers that report them
+    struct CachedStats
+    {
+        uint64_t num_tokens = 0;
+        uint64_t num_nodes  = 0;
+    };
+
+    std::string write_flat_ast(const FlatAst& ast, const SourceKey& key, const CachedStats& stats);
+
+    // False, leaving `ast` in an unspecified state, unless `data` is a whole
+    // file written by this build for a source with `key`
+    bool read_flat_ast(std::string_view data, const SourceKey& key, FlatAst& ast, CachedStats* stats = nullptr);
+
+    // A directory of cache files, one per source
+    class AstCache
+    {
+        public:
+            explicit AstCache(std::string directory):
+                directory(std::move(directory)) { }
+
+            std::string path_for(const SourceKey& key) const;
+
+            bool load(const SourceKey& key, FlatAst& ast, CachedStats* stats = nullptr) const;
+
+            // Creates the directory if needed. The file is written under a
+            // temporary name and renamed into place, so another process
+            // loading it at the same time never sees half of it.
+            bool store(const SourceKey& key, const FlatAst& ast, const CachedStats& stats) const;
+        private:
+            std::string directory;
+    };
+}
+
+#endif
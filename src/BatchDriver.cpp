@@ -0,0 +1,165 @@
+#include "BatchDriver.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <system_error>
+
+#include "SourceFile.h"
+#include "AstCache.h"
+#include "Declaration.h"
+#include "FlatAst.h"
+#include "GraphvizOutput.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // What each thread keeps from one file to the next
+    struct Worker
+    {
+        SourceFile source;
+        LexerState lexer;
+    };
+
+    // a/b/c.lang -> a_b_c.lang.gv, so sources from different directories
+    // can't overwrite each other's output
+    std::string output_path(const char* output_dir, const std::string& source_path)
+    {
+        std::string name = source_path;
+        std::replace(name.begin(), name.end(), '/', '_');
+        std::replace(name.begin(), name.end(), '\\', '_');
+        return (fs::path(output_dir) / (name + ".gv")).string();
+    }
+
+    void process_file(const std::string& path, const BatchOptions& options, FileResult& result)
+    {
+        thread_local Worker worker;
+        auto start = std::chrono::steady_clock::now();
+
+        result.path   = path;
+        result.loaded = worker.source.load(path.c_str()) && worker.source.view().size() <= UINT32_MAX;
+        if(!result.loaded)
+            return;
+
+        std::string_view text = worker.source.view();
+        result.bytes = text.size();
+
+        ast::FlatAst     flat;
+        ast::SourceKey   key = {};
+        ast::CachedStats stats;
+        if(options.cache_dir)
+        {
+            key           = ast::source_key(text);
+            result.cached = ast::AstCache(options.cache_dir).load(key, flat, &stats);
+            result.tokens = stats.num_tokens;
+            result.nodes  = stats.num_nodes;
+        }
+
+        if(!result.cached)
+        {
+            LexerState& lexer  = worker.lexer;
+            lexer.input_string = text;
+            lexer.input_len    = text.size();
+            lexer.print_errors = false;
+            result.lex_status  = lexer.tokenize_string();
+            result.tokens      = lexer.tokens.size();
+            if(result.lex_status != LEX_SUCCESS)
+                result.lex_error_line = lexer.curr_line_number;
+
+            ParserState parser;
+            parser.status       = PARSE_SUCCESS;
+            parser.lexer        = &lexer;
+            parser.token_stream = lexer.tokens.data();
+            parser.curr_token   = 0;
+
+            ast::ParseResult program = ast::parse_program(&parser);
+            result.nodes  = parser.num_nodes;
+            result.errors = std::move(parser.errors);
+            flat = ast::flatten(program.root, parser.num_nodes);
+
+            if(options.cache_dir && result.ok() && parser.status == PARSE_SUCCESS)
+                ast::AstCache(options.cache_dir).store(key, flat, { result.tokens, result.nodes });
+        }
+
+        GraphvizDocument doc;
+        doc.curr_node_id = 0;
+        doc.oss << "digraph G {\n    node[shape=record fontname=Arial];\n";
+        output_graphviz(flat, doc);
+        doc.oss << "}\n";
+
+        if(options.output_dir)
+        {
+            std::ofstream output_file(output_path(options.output_dir, path), std::ios::binary);
+            output_file << doc.oss.str() << '\n';
+        }
+
+        // The tokens and the mapping are reused or dropped with the next file
+        worker.source.release();
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+bool collect_sources(const char* path, std::vector<std::string>& paths)
+{
+    std::error_code error;
+    if(!fs::is_directory(path, error))
+    {
+        paths.push_back(path);
+        return true;
+    }
+
+    std::vector<std::string> found;
+    for(fs::recursive_directory_iterator it(path, error), end; !error && it != end; it.increment(error))
+        if(it->is_regular_file(error) && it->path().extension() == ".lang")
+            found.push_back(it->path().string());
+    if(error)
+        return false;
+
+    std::sort(found.begin(), found.end());
+    paths.insert(paths.end(), found.begin(), found.end());
+    return true;
+}
+
+bool read_source_list(const char* list_path, std::vector<std::string>& paths)
+{
+    std::ifstream list(list_path);
+    if(!list)
+        return false;
+
+    std::string line;
+    while(std::getline(list, line))
+    {
+        if(!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if(!line.empty() && !collect_sources(line.c_str(), paths))
+            return false;
+    }
+    return true;
+}
+
+std::vector<FileResult> run_batch(const std::vector<std::string>& paths, ThreadPool& pool, const BatchOptions& options)
+{
+    // Largest files first, so one big file picked up last can't leave the
+    // other threads idle at the end
+    std::vector<size_t> sizes(paths.size(), 0);
+    std::vector<size_t> order(paths.size());
+    std::iota(order.begin(), order.end(), 0);
+    for(size_t i = 0; i < paths.size(); i++)
+    {
+        std::error_code error;
+        auto size = fs::file_size(paths[i], error);
+        sizes[i]  = error ? 0 : (size_t) size;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+    std::vector<FileResult> results(paths.size());
+    pool.parallel_for(order.size(), [&](size_t i)
+    {
+        process_file(paths[order[i]], options, results[order[i]]);
+    });
+    return results;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#ifndef LANG_BATCH_DRIVER_H
+#define LANG_BATCH_DRIVER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Parser.h"
+#include "ThreadPool.h"
+
+// Runs the whole front end, lex -> parse -> Graphviz, over many sources at
+// once. Every file is an independent task on the pool, and each thread
+// keeps its lexer around between files so the token buffer and the block
+// of decoded strings are allocated once rather than for every file.
+struct BatchOptions
+{
+    const char* output_dir = nullptr;   // Graphviz of each file is written here when set
+    const char* cache_dir  = nullptr;   // AstCache directory, files found in it aren't lexed or parsed
+};
+
+struct FileResult
+{
+    std::string path;
+    bool        loaded         = false;
+    bool        cached         = false; // Tree came from the AST cache
+    size_t      lex_status     = LEX_SUCCESS;
+    size_t      lex_error_line = 0;
+    size_t      bytes          = 0;
+    size_t      tokens         = 0;
+    size_t      nodes          = 0;
+    double      seconds        = 0.0;
+    std::vector<ErrorMessage> errors;   // From the parser
+
+    bool ok() const { return loaded && lex_status == LEX_SUCCESS && errors.empty(); }
+};
+
+// Appends `path` if it's a file, or every .lang file below it, in name
+// order, if it's a directory
+bool collect_sources(const char* path, std::vector<std::string>& paths);
+
+// Appends the paths listed in `list_path`, one per line, expanding
+// directories as collect_sources() does. Blank lines are skipped.
+bool read_source_list(const char* list_path, std::vector<std::string>& paths);
+
+// One result per path, in the same order
+std::vector<FileResult> run_batch(const std::vector<std::string>& paths, ThreadPool& pool, const BatchOptions& options);
+
+#endif
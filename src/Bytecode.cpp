@@ -0,0 +1,688 @@
+#include "Bytecode.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+
+#include "Statement.h"
+
+const char* opcode_name(Opcode op)
+{
+    static const char* const names[] = {
+#define LANG_OPCODE_NAME(name) #name,
+        LANG_OPCODES(LANG_OPCODE_NAME)
+#undef LANG_OPCODE_NAME
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == (size_t) Opcode::COUNT, "an opcode is missing its name");
+    return op < Opcode::COUNT ? names[(size_t) op] : "?";
+}
+
+namespace ast {
+    namespace
+    {
+        // Expressions nested deeper than the tree walker would evaluate them
+        // compile to a failure instead, which also bounds the recursion here
+        const size_t   MAX_NESTING   = 10000;
+        const uint32_t MAX_REGISTERS = UINT16_MAX;
+
+        // What the compiler can tell about a value without running anything
+        enum class Known : uint8_t { ANY, VOID, INT, FLOAT, STRING };
+
+        Known known_of_variable(Type_t::Value type)
+        {
+            return type == Type_t::INT ? Known::INT : type == Type_t::FLOAT ? Known::FLOAT : Known::ANY;
+        }
+
+        Known known_of_result(Type_t::Value type)
+        {
+            return type == Type_t::VOID ? Known::VOID : known_of_variable(type);
+        }
+
+        bool is_number(Known known) { return known == Known::INT || known == Known::FLOAT; }
+
+        // Binary operators and the opcodes for them, with a register or a
+        // small int on the right
+        struct BinaryOpcodes
+        {
+            Opcode reg;
+            Opcode imm;     // COUNT if there's none
+        };
+
+        BinaryOpcodes binary_opcodes(Expr_t op)
+        {
+            switch(op)
+            {
+                case Expr_t::ADD      : return { Opcode::ADD, Opcode::ADD_IMM };
+                case Expr_t::SUB      : return { Opcode::SUB, Opcode::SUB_IMM };
+                case Expr_t::MUL      : return { Opcode::MUL, Opcode::COUNT   };
+                case Expr_t::DIV      : return { Opcode::DIV, Opcode::COUNT   };
+                case Expr_t::COMP_LT  : return { Opcode::LT,  Opcode::LT_IMM  };
+                case Expr_t::COMP_GT  : return { Opcode::GT,  Opcode::GT_IMM  };
+                case Expr_t::COMP_LEQ : return { Opcode::LEQ, Opcode::LEQ_IMM };
+                case Expr_t::COMP_GEQ : return { Opcode::GEQ, Opcode::GEQ_IMM };
+                case Expr_t::COMP_EQU : return { Opcode::EQU, Opcode::EQU_IMM };
+                case Expr_t::COMP_NEQ : return { Opcode::NEQ, Opcode::NEQ_IMM };
+                default               : return { Opcode::COUNT, Opcode::COUNT };
+            }
+        }
+
+        // An assignment inside a larger expression can change a variable
+        // after it was read but before the read value is used, e.g. the x
+        // in `x + (x = 2)`. Functions with one can't use variables'
+        // registers as operands directly.
+        bool has_nested_assignment(const Expression* root)
+        {
+            std::vector<const Expression*> pending;
+            if(root)
+            {
+                pending.push_back(root->get_lhs());
+                pending.push_back(root->get_rhs());
+            }
+            while(!pending.empty())
+            {
+                const Expression* expr = pending.back();
+                pending.pop_back();
+                if(!expr)
+                    continue;
+                if(expr->get_type() == Expr_t::ASSIGN)
+                    return true;
+                pending.push_back(expr->get_lhs());
+                pending.push_back(expr->get_rhs());
+            }
+            return false;
+        }
+
+        bool has_nested_assignment(const Statement* stmts)
+        {
+            for(const Statement* stmt = stmts; stmt; stmt = stmt->next)
+            {
+                switch(stmt->get_type())
+                {
+                    case Stmt_t::EXPR:
+                    case Stmt_t::RETURN:
+                        if(has_nested_assignment(static_cast<const ExprStatement*>(stmt)->get_expr()))
+                            return true;
+                        break;
+                    case Stmt_t::DECL:
+                        if(has_nested_assignment(static_cast<const VarDeclStatement*>(stmt)->get_decl()->get_expr()))
+                            return true;
+                        break;
+                    case Stmt_t::IF:
+                    {
+                        auto if_stmt = static_cast<const IfStatement*>(stmt);
+                        if(has_nested_assignment(if_stmt->get_condition()) ||
+                           has_nested_assignment(if_stmt->get_body()) || has_nested_assignment(if_stmt->get_else()))
+                            return true;
+                    }
+                    break;
+                    default:
+                        break;
+                }
+            }
+            return false;
+        }
+
+        struct Local
+        {
+            uint16_t      reg;
+            Type_t::Value type;
+        };
+
+        class FunctionCompiler
+        {
+            public:
+                FunctionCompiler(const BytecodeProgram& program, BytecodeFunction& out):
+                    program(program), out(out) { }
+
+                void compile(const ResolvedFunction& func);
+            private:
+                void  compile_block(const Statement* stmts);
+                void  compile_statement(const Statement* stmt);
+                void  compile_discarded(const Expression* expr);
+                Known compile_expression(const Expression* expr, uint16_t dest);
+                Known compile_binary(const Expression* expr, uint16_t dest);
+                Known compile_assignment(const Expression* expr, uint16_t dest);
+                Known compile_call(const Expression* call, uint16_t dest, bool tail = false);
+                bool  is_tail_call(const Expression* expr) const;
+                Known compile_print(const Expression* args, uint16_t dest, bool wants_result = true);
+
+                // A register holding the value of `expr`, which is either a
+                // variable's own or a new temporary
+                uint16_t compile_operand(const Expression* expr, Known& known);
+                void     convert(uint16_t reg, Known known, Type_t::Value type);
+
+                uint16_t     alloc_register();
+                bool         is_temporary(uint16_t reg) const { return reg >= locals_top; }
+                const Local* lookup(const Expression* name) const;
+
+                void   emit(Opcode op, uint16_t a = 0, uint16_t b = 0, uint16_t c = 0);
+                void   emit_wide(Opcode op, uint16_t a, uint32_t bc);
+                size_t emit_jump(Opcode op, uint16_t a = 0);
+                void   patch_jump(size_t at);
+                void   emit_fail(const char* format, ...);
+
+                const BytecodeProgram& program;
+                BytecodeFunction&      out;
+
+                std::vector<Local> locals;              // By resolved slot, only those in scope are up to date
+                uint32_t           next_register = 0;   // Temporaries start here
+                uint32_t           locals_top    = 0;   // Registers below are variables'
+                size_t             depth         = 0;
+                bool               copy_operands = false;
+                bool               out_of_registers = false;
+        };
+
+        void FunctionCompiler::compile(const ResolvedFunction& resolved)
+        {
+            const FunctionDecl* func = resolved.decl;
+            out.name        = func->get_name();
+            out.return_type = func->get_return_type().get_value();
+            out.return_kind = kind_of_type(out.return_type);
+            locals.resize(resolved.num_slots);
+            for(const ParameterNode* param = func->get_params(); param; param = param->get_next_param())
+            {
+                locals[param->get_slot()] = { alloc_register(), param->get_type().get_value() };
+                out.param_kinds.push_back(kind_of_type(param->get_type().get_value()));
+            }
+            locals_top    = next_register;
+            if(resolved.too_deep)
+            {
+                emit_fail("ifs nested too deeply");
+                return;
+            }
+            copy_operands = has_nested_assignment(func->get_body());
+
+            compile_block(func->get_body());
+            if(out.return_type == Type_t::VOID)
+                emit(Opcode::RETURN_VOID);
+            else
+                emit_fail("reached the end without returning a value");
+
+            if(out_of_registers)
+            {
+                out.code.clear();
+                out.messages.clear();
+                emit_fail("%.*s() needs more than %u registers", (int) Interner::global().name(out.name).size(),
+                          Interner::global().name(out.name).data(), MAX_REGISTERS);
+                out.num_registers = (uint32_t) out.param_kinds.size();
+            }
+        }
+
+        void FunctionCompiler::compile_block(const Statement* stmts)
+        {
+            uint32_t saved_top = locals_top;
+            for(const Statement* stmt = stmts; stmt; stmt = stmt->next)
+                compile_statement(stmt);
+            locals_top    = saved_top;
+            next_register = saved_top;
+        }
+
+        void FunctionCompiler::compile_statement(const Statement* stmt)
+        {
+            switch(stmt->get_type())
+            {
+            case Stmt_t::EXPR:
+                compile_discarded(static_cast<const ExprStatement*>(stmt)->get_expr());
+            break;
+
+            case Stmt_t::RETURN:
+            {
+                const Expression* expr = static_cast<const ExprStatement*>(stmt)->get_expr();
+                if(is_tail_call(expr))
+                {
+                    uint16_t reg = alloc_register();
+                    compile_call(expr, reg, true);
+                    if(out.return_type == Type_t::VOID)
+                        emit(Opcode::RETURN_VOID);
+                    else
+                        emit(Opcode::RETURN, reg);
+                }
+                else if(out.return_type == Type_t::VOID)
+                {
+                    // Evaluated for its effects, void functions return nothing
+                    compile_expression(expr, alloc_register());
+                    emit(Opcode::RETURN_VOID);
+                }
+                else
+                {
+                    Known known;
+                    emit(Opcode::RETURN, compile_operand(expr, known));
+                }
+            }
+            break;
+
+            case Stmt_t::DECL:
+            {
+                // The initialiser is evaluated straight into the variable's
+                // register, its name isn't visible until after
+                const VariableDecl* decl = static_cast<const VarDeclStatement*>(stmt)->get_decl();
+                Type_t::Value       type = decl->get_type().get_value();
+                uint16_t            reg  = alloc_register();
+                if(decl->get_expr())
+                    convert(reg, compile_expression(decl->get_expr(), reg), type);
+                else if(type == Type_t::FLOAT)
+                {
+                    out.constants.push_back(Value::of_float(0.0));
+                    emit_wide(Opcode::LOAD_CONST, reg, (uint32_t) out.constants.size() - 1);
+                }
+                else
+                    emit_wide(Opcode::LOAD_INT, reg, 0);
+
+                locals[decl->get_slot()] = { reg, type };
+                locals_top = next_register;
+            }
+            break;
+
+            case Stmt_t::IF:
+            {
+                auto  if_stmt = static_cast<const IfStatement*>(stmt);
+                Known known;
+                size_t to_else = emit_jump(Opcode::JUMP_IF_FALSE, compile_operand(if_stmt->get_condition(), known));
+                next_register = locals_top;
+
+                compile_block(if_stmt->get_body());
+                if(if_stmt->get_else())
+                {
+                    size_t to_end = emit_jump(Opcode::JUMP);
+                    patch_jump(to_else);
+                    compile_block(if_stmt->get_else());
+                    patch_jump(to_end);
+                }
+                else
+                    patch_jump(to_else);
+            }
+            break;
+
+            default:
+                emit_fail("can't run this kind of statement");
+            break;
+            }
+            next_register = locals_top;
+        }
+
+        // An expression statement, nothing needs its value. Assignments go
+        // straight to the variable and print() doesn't produce a result.
+        void FunctionCompiler::compile_discarded(const Expression* expr)
+        {
+            if(expr && expr->get_type() == Expr_t::ASSIGN && expr->get_lhs()->get_type() == Expr_t::IDENTIFIER)
+            {
+                if(const Local* local = lookup(expr->get_lhs()))
+                {
+                    compile_expression(expr, local->reg);
+                    return;
+                }
+            }
+            if(expr && expr->get_type() == Expr_t::CALL && expr->get_slot() == PRINT_BUILTIN)
+            {
+                compile_print(expr->get_rhs(), 0, false);
+                return;
+            }
+            compile_expression(expr, alloc_register());
+        }
+
+        Known FunctionCompiler::compile_expression(const Expression* expr, uint16_t dest)
+        {
+            if(expr == nullptr)
+            {
+                emit_fail("an expression didn't parse");
+                return Known::ANY;
+            }
+            if(depth == MAX_NESTING)
+            {
+                emit_fail("%s", NESTED_TOO_DEEPLY);
+                return Known::ANY;
+            }
+
+            depth++;
+            uint32_t saved_next = next_register;
+            Known    known      = Known::ANY;
+            switch(expr->get_type())
+            {
+            case Expr_t::INT_LITERAL:
+                if(expr->get_int() >= INT32_MIN && expr->get_int() <= INT32_MAX)
+                    emit_wide(Opcode::LOAD_INT, dest, (uint32_t) (int32_t) expr->get_int());
+                else
+                {
+                    out.constants.push_back(Value::of_int(expr->get_int()));
+                    emit_wide(Opcode::LOAD_CONST, dest, (uint32_t) out.constants.size() - 1);
+                }
+                known = Known::INT;
+            break;
+
+            case Expr_t::FLOAT_LITERAL:
+            case Expr_t::STRING_LITERAL:
+                out.constants.push_back(expr->get_type() == Expr_t::FLOAT_LITERAL ? Value::of_float(expr->get_flt())
+                                                                                 : Value::of_string(expr->get_str()));
+                emit_wide(Opcode::LOAD_CONST, dest, (uint32_t) out.constants.size() - 1);
+                known = expr->get_type() == Expr_t::FLOAT_LITERAL ? Known::FLOAT : Known::STRING;
+            break;
+
+            case Expr_t::IDENTIFIER:
+            {
+                const Local* local = lookup(expr);
+                if(!local)
+                {
+                    std::string_view name = Interner::global().name(expr->get_symbol());
+                    emit_fail("%.*s isn't declared", (int) name.size(), name.data());
+                    break;
+                }
+                if(local->reg != dest)
+                    emit(Opcode::MOVE, dest, local->reg);
+                known = known_of_variable(local->type);
+            }
+            break;
+
+            case Expr_t::ASSIGN:
+                known = compile_assignment(expr, dest);
+            break;
+
+            case Expr_t::NEGATE:
+            {
+                Known operand;
+                emit(Opcode::NEGATE, dest, compile_operand(expr->get_lhs(), operand));
+                known = is_number(operand) ? operand : Known::ANY;
+            }
+            break;
+
+            case Expr_t::CALL:
+                known = compile_call(expr, dest);
+            break;
+
+            default:
+                known = compile_binary(expr, dest);
+            break;
+            }
+            next_register = saved_next;
+            depth--;
+            return known;
+        }
+
+        Known FunctionCompiler::compile_binary(const Expression* expr, uint16_t dest)
+        {
+            BinaryOpcodes opcodes = binary_opcodes(expr->get_type());
+            if(opcodes.reg == Opcode::COUNT)
+            {
+                emit_fail("unknown operator");
+                return Known::ANY;
+            }
+
+            Known    lhs;
+            uint16_t lhs_reg = compile_operand(expr->get_lhs(), lhs);
+
+            // Small int constants on the right are part of the instruction
+            const Expression* rhs_expr = expr->get_rhs();
+            Known rhs;
+            if(opcodes.imm != Opcode::COUNT && rhs_expr && rhs_expr->get_type() == Expr_t::INT_LITERAL &&
+               rhs_expr->get_int() >= INT16_MIN && rhs_expr->get_int() <= INT16_MAX)
+            {
+                emit(opcodes.imm, dest, lhs_reg, (uint16_t) (int16_t) rhs_expr->get_int());
+                rhs = Known::INT;
+            }
+            else
+                emit(opcodes.reg, dest, lhs_reg, compile_operand(rhs_expr, rhs));
+
+            if(!is_number(lhs) || !is_number(rhs))
+                return Known::ANY;
+            if(is_comparison(expr->get_type()))
+                return Known::INT;
+            return lhs == Known::INT && rhs == Known::INT ? Known::INT : Known::FLOAT;
+        }
+
+        Known FunctionCompiler::compile_assignment(const Expression* expr, uint16_t dest)
+        {
+            const Expression* target = expr->get_lhs();
+            if(target->get_type() != Expr_t::IDENTIFIER)
+            {
+                emit_fail("only variables can be assigned to");
+                return Known::ANY;
+            }
+
+            // The right-hand side is evaluated even when the name isn't
+            // declared, the failure comes after it
+            const Local* local = lookup(target);
+            if(!local)
+            {
+                compile_expression(expr->get_rhs(), alloc_register());
+                std::string_view name = Interner::global().name(target->get_symbol());
+                emit_fail("%.*s isn't declared", (int) name.size(), name.data());
+                return Known::ANY;
+            }
+
+            convert(local->reg, compile_expression(expr->get_rhs(), local->reg), local->type);
+            if(dest != local->reg)
+                emit(Opcode::MOVE, dest, local->reg);
+            return known_of_variable(local->type);
+        }
+
+        // A call returned as is can take over the caller's frame. Its
+        // result gets converted to the callee's return type, so that has to
+        // be the caller's too.
+        bool FunctionCompiler::is_tail_call(const Expression* expr) const
+        {
+            if(!expr || expr->get_type() != Expr_t::CALL || expr->get_slot() >= program.functions.size())
+                return false;
+            return program.functions[expr->get_slot()].return_type == out.return_type;
+        }
+
+        Known FunctionCompiler::compile_call(const Expression* call, uint16_t dest, bool tail)
+        {
+            Symbol   name  = call->get_lhs()->get_symbol();
+            uint32_t index = call->get_slot();
+            if(index == PRINT_BUILTIN)
+                return compile_print(call->get_rhs(), dest);
+            if(index == NO_SLOT)
+            {
+                std::string_view text = Interner::global().name(name);
+                emit_fail("there's no function %.*s()", (int) text.size(), text.data());
+                return Known::ANY;
+            }
+
+            // The arguments are evaluated into consecutive registers on top,
+            // the first of which gets the result. A temporary that is already
+            // on top can be that register.
+            uint16_t base = (is_temporary(dest) && dest + 1u == next_register) ? dest : alloc_register();
+            size_t num_args = 0;
+            for(const Expression* arg = call->get_rhs(); arg; arg = arg->get_rhs(), num_args++)
+                compile_expression(arg->get_lhs(), num_args == 0 ? base : alloc_register());
+
+            const BytecodeFunction& callee = program.functions[index];
+            if(num_args != callee.param_kinds.size())
+            {
+                std::string_view text = Interner::global().name(name);
+                emit_fail("%.*s() takes %zu arguments but was given %zu", (int) text.size(), text.data(),
+                          callee.param_kinds.size(), num_args);
+                return Known::ANY;
+            }
+            emit_wide(tail ? Opcode::TAIL_CALL : Opcode::CALL, base, index);
+            if(base != dest)
+                emit(Opcode::MOVE, dest, base);
+            return known_of_result(callee.return_type);
+        }
+
+        // Everything is evaluated before anything is written, but evaluation
+        // stops at the first argument that comes from a void function
+        Known FunctionCompiler::compile_print(const Expression* args, uint16_t dest, bool wants_result)
+        {
+            uint16_t base     = alloc_register();
+            size_t   num_args = 0;
+            for(const Expression* arg = args; arg; arg = arg->get_rhs(), num_args++)
+            {
+                uint16_t reg   = num_args == 0 ? base : alloc_register();
+                Known    known = compile_expression(arg->get_lhs(), reg);
+                if(known == Known::VOID)
+                {
+                    emit_fail("print() was given a function call that returns nothing");
+                    return Known::VOID;
+                }
+                if(known == Known::ANY)
+                    emit(Opcode::NOT_VOID, reg);
+            }
+            emit(Opcode::PRINT, base, (uint16_t) num_args);
+            if(wants_result)
+                emit(Opcode::LOAD_VOID, dest);
+            return Known::VOID;
+        }
+
+        uint16_t FunctionCompiler::compile_operand(const Expression* expr, Known& known)
+        {
+            if(!copy_operands && expr && expr->get_type() == Expr_t::IDENTIFIER)
+            {
+                if(const Local* local = lookup(expr))
+                {
+                    known = known_of_variable(local->type);
+                    return local->reg;
+                }
+            }
+            uint16_t reg = alloc_register();
+            known = compile_expression(expr, reg);
+            return reg;
+        }
+
+        // Converts a value stored into something of a declared type, unless
+        // it's known to have that type already
+        void FunctionCompiler::convert(uint16_t reg, Known known, Type_t::Value type)
+        {
+            Known wanted = known_of_variable(type);
+            if(wanted != Known::ANY && known != wanted)
+                emit(Opcode::CONVERT, reg, (uint16_t) type);
+        }
+
+        uint16_t FunctionCompiler::alloc_register()
+        {
+            if(next_register == MAX_REGISTERS)
+            {
+                out_of_registers = true;
+                return MAX_REGISTERS - 1;
+            }
+            uint16_t reg = (uint16_t) next_register++;
+            if(next_register > out.num_registers)
+                out.num_registers = next_register;
+            return reg;
+        }
+
+        // The variable a resolved identifier refers to, nullptr if it
+        // wasn't declared
+        const Local* FunctionCompiler::lookup(const Expression* name) const
+        {
+            return name->get_slot() == NO_SLOT ? nullptr : &locals[name->get_slot()];
+        }
+
+        void FunctionCompiler::emit(Opcode op, uint16_t a, uint16_t b, uint16_t c)
+        {
+            Instruction instr;
+            instr.op = op;
+            instr.a  = a;
+            instr.b  = b;
+            instr.c  = c;
+            out.code.push_back(instr);
+        }
+
+        void FunctionCompiler::emit_wide(Opcode op, uint16_t a, uint32_t bc)
+        {
+            emit(op, a, (uint16_t) bc, (uint16_t) (bc >> 16));
+        }
+
+        size_t FunctionCompiler::emit_jump(Opcode op, uint16_t a)
+        {
+            emit(op, a);
+            return out.code.size() - 1;
+        }
+
+        // Points a jump at the next instruction to be emitted
+        void FunctionCompiler::patch_jump(size_t at)
+        {
+            uint32_t target = (uint32_t) out.code.size();
+            out.code[at].b = (uint16_t) target;
+            out.code[at].c = (uint16_t) (target >> 16);
+        }
+
+        void FunctionCompiler::emit_fail(const char* format, ...)
+        {
+            char message[512];
+            va_list list;
+            va_start(list, format);
+            vsnprintf(message, sizeof(message), format, list);
+            va_end(list);
+
+            out.messages.push_back(message);
+            emit_wide(Opcode::FAIL, 0, (uint32_t) out.messages.size() - 1);
+        }
+    }
+
+    BytecodeProgram compile_program(const Resolution& resolution)
+    {
+        // Every function's signature is known before any is compiled, so
+        // calls can check those defined further down
+        BytecodeProgram program;
+        for(const ResolvedFunction& func : resolution.functions)
+        {
+            BytecodeFunction signature;
+            signature.return_type = func.decl->get_return_type().get_value();
+            for(uint32_t i = 0; i < func.num_params; i++)
+                signature.param_kinds.push_back(kind_of_type(func.slot_types[i]));
+            program.functions.push_back(std::move(signature));
+        }
+
+        for(size_t i = 0; i < resolution.functions.size(); i++)
+        {
+            BytecodeFunction compiled;
+            FunctionCompiler(program, compiled).compile(resolution.functions[i]);
+            program.functions[i] = std::move(compiled);
+        }
+        return program;
+    }
+
+    void BytecodeProgram::disassemble(FILE* out) const
+    {
+        for(const BytecodeFunction& func : functions)
+        {
+            std::string_view name = Interner::global().name(func.name);
+            fprintf(out, "%.*s: %zu params, %u registers\n", (int) name.size(), name.data(),
+                    func.param_kinds.size(), func.num_registers);
+            for(size_t i = 0; i < func.code.size(); i++)
+            {
+                const Instruction& in = func.code[i];
+                fprintf(out, "  %4zu  %-14s", i, opcode_name(in.op));
+                switch(in.op)
+                {
+                    case Opcode::LOAD_INT      : fprintf(out, "r%u, %d", in.a, (int32_t) in.bc());   break;
+                    case Opcode::LOAD_CONST    :
+                    {
+                        const Value& k = func.constants[in.bc()];
+                        fprintf(out, "r%u, K%u", in.a, in.bc());
+                        if(k.kind == Value::INT)
+                            fprintf(out, "  ; %" PRId64, k.int_value);
+                        else if(k.kind == Value::FLOAT)
+                            fprintf(out, "  ; %g", k.flt_value);
+                        else if(k.kind == Value::STRING)
+                            fprintf(out, "  ; \"%.*s\"", (int) k.str_len, k.str_value);
+                    }
+                    break;
+                    case Opcode::JUMP          : fprintf(out, "%u", in.bc());                        break;
+                    case Opcode::JUMP_IF_FALSE : fprintf(out, "r%u, %u", in.a, in.bc());             break;
+                    case Opcode::CALL          :
+                    case Opcode::TAIL_CALL     :
+                    {
+                        std::string_view callee = Interner::global().name(functions[in.bc()].name);
+                        fprintf(out, "r%u, %.*s", in.a, (int) callee.size(), callee.data());
+                    }
+                    break;
+                    case Opcode::FAIL          : fprintf(out, "\"%s\"", func.messages[in.bc()].c_str()); break;
+                    case Opcode::LOAD_VOID     :
+                    case Opcode::NOT_VOID      :
+                    case Opcode::RETURN        : fprintf(out, "r%u", in.a);                          break;
+                    case Opcode::RETURN_VOID   :                                                     break;
+                    case Opcode::MOVE          :
+                    case Opcode::NEGATE        : fprintf(out, "r%u, r%u", in.a, in.b);               break;
+                    case Opcode::CONVERT       : fprintf(out, "r%u, %s", in.a, Type_t((Type_t::Value) in.b).to_string().c_str()); break;
+                    case Opcode::PRINT         : fprintf(out, "r%u, %u", in.a, in.b);                break;
+                    case Opcode::ADD_IMM       : case Opcode::SUB_IMM : case Opcode::LT_IMM  : case Opcode::GT_IMM :
+                    case Opcode::LEQ_IMM       : case Opcode::GEQ_IMM : case Opcode::EQU_IMM : case Opcode::NEQ_IMM :
+                        fprintf(out, "r%u, r%u, %d", in.a, in.b, in.imm());
+                    break;
+                    default                    : fprintf(out, "r%u, r%u, r%u", in.a, in.b, in.c);    break;
+                }
+                fputc('\n', out);
+            }
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+#ifndef LANG_BYTECODE_H
+#define LANG_BYTECODE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "Declaration.h"
+#include "Resolver.h"
+#include "Value.h"
+
+// Every instruction the compiler emits, in the order the VM's dispatch table
+// lists their handlers. r[x] is register x of the running function, K[x] its
+// constant x; `imm` is c as a signed 16-bit integer and `bc` is b and c read
+// as one 32-bit operand.
+#define LANG_OPCODES(X)                                                          \
+    X(MOVE)             /* r[a] = r[b]                                        */ \
+    X(LOAD_INT)         /* r[a] = bc as a signed 32-bit integer               */ \
+    X(LOAD_CONST)       /* r[a] = K[bc]                                       */ \
+    X(LOAD_VOID)        /* r[a] = what a void function returns                */ \
+    X(ADD) X(SUB) X(MUL) X(DIV)                     /* r[a] = r[b] op r[c]    */ \
+    X(LT) X(GT) X(LEQ) X(GEQ) X(EQU) X(NEQ)                                      \
+    X(ADD_IMM) X(SUB_IMM)                           /* r[a] = r[b] op imm     */ \
+    X(LT_IMM) X(GT_IMM) X(LEQ_IMM) X(GEQ_IMM) X(EQU_IMM) X(NEQ_IMM)              \
+    X(NEGATE)           /* r[a] = -r[b]                                       */ \
+    X(CONVERT)          /* r[a] = r[a] converted to the Type_t::Value b       */ \
+    X(JUMP)             /* continue at instruction bc                         */ \
+    X(JUMP_IF_FALSE)    /* continue at bc if r[a] is 0, it has to be a number */ \
+    X(CALL)             /* r[a] = function bc(r[a], r[a + 1], ...)            */ \
+    X(TAIL_CALL)        /* same, in place of the running function's frame,    */ \
+                        /* always followed by the RETURN of r[a] it replaces  */ \
+    X(PRINT)            /* print r[a] ... r[a + b - 1]                        */ \
+    X(NOT_VOID)         /* fail if r[a] came from a void function, for print  */ \
+    X(RETURN)           /* return r[a] converted to the return type           */ \
+    X(RETURN_VOID)                                                               \
+    X(FAIL)             /* stop with the function's message bc                */
+
+enum class Opcode : uint8_t
+{
+#define LANG_OPCODE_ENUM(name) name,
+    LANG_OPCODES(LANG_OPCODE_ENUM)
+#undef LANG_OPCODE_ENUM
+    COUNT
+};
+
+const char* opcode_name(Opcode op);
+
+struct Instruction
+{
+    Opcode   op;
+    uint8_t  unused = 0;
+    uint16_t a      = 0;
+    uint16_t b      = 0;
+    uint16_t c      = 0;
+
+    uint32_t bc()  const { return b | (uint32_t) c << 16; }
+    int16_t  imm() const { return (int16_t) c; }
+};
+static_assert(sizeof(Instruction) == 8, "instructions are expected to stay 8 bytes");
+
+namespace ast {
+    // What both engines stop with once expressions or calls nest deeper than
+    // they run. Which function that happens in differs between them, see
+    // Interpreter.h, so unlike other errors it isn't named.
+    constexpr const char* NESTED_TOO_DEEPLY = "expressions or calls nested too deeply";
+
+    // One function's code. Registers hold its parameters first, then its
+    // variables, then whatever expressions need while they're evaluated; a
+    // call's arguments go in consecutive registers at the caller's top,
+    // which become the callee's first registers.
+    struct BytecodeFunction
+    {
+        Symbol                   name        = NO_SYMBOL;
+        Type_t::Value            return_type = Type_t::VOID;
+        Value::Kind              return_kind = Value::VOID;    // Returned values convert to it, VOID takes any
+        std::vector<Value::Kind> param_kinds;                  // Same for the arguments
+        uint32_t                 num_registers = 0;
+
+        std::vector<Instruction> code;
+        std::vector<Value>       constants;
+        std::vector<std::string> messages;  // Runtime errors the compiler already knows about
+    };
+
+    struct BytecodeProgram
+    {
+        std::vector<BytecodeFunction> functions;    // Same order as Resolution::functions
+
+        void disassemble(FILE* out) const;
+    };
+
+    // Compiles every function resolve_program() found. Compiling never
+    // fails: anything that would be a runtime error in the tree walker, like
+    // a call with the wrong number of arguments, becomes a FAIL instruction
+    // where it would have been evaluated. So do names that didn't resolve,
+    // though programs with any aren't run.
+    BytecodeProgram compile_program(const Resolution& resolution);
+}
+
+#endif
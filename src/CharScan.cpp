@@ -0,0 +1,234 @@
+#include "CharScan.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #include <immintrin.h>
+    #define LANG_SCAN_X86 1
+#else
+    #define LANG_SCAN_X86 0
+#endif
+
+#if LANG_SCAN_X86 && (defined(__GNUC__) || defined(__clang__))
+    #define LANG_SCAN_AVX2 1
+    #define LANG_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define LANG_SCAN_AVX2 0
+#endif
+
+namespace scan
+{
+    static constexpr std::array<uint8_t, 256> make_char_class()
+    {
+        std::array<uint8_t, 256> table = {};
+        for(int c = 0; c < 256; c++)
+        {
+            bool alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+            bool digit = (c >= '0' && c <= '9');
+            bool blank = c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+
+            table[c] = (blank ? CH_BLANK : 0) | (alpha ? CH_ALPHA : 0) | (digit ? CH_DIGIT : 0) |
+                       ((alpha || digit || c == '_') ? CH_IDENT : 0);
+        }
+        return table;
+    }
+    const std::array<uint8_t, 256> CHAR_CLASS = make_char_class();
+
+    // Each class knows how to test a single byte and, on x86, a whole vector
+    // of them; the match functions yield 0xFF in every lane that belongs to the run.
+    struct Blank
+    {
+        static bool in_run(char c) { return is_blank(c); }
+    };
+    struct Identifier
+    {
+        static bool in_run(char c) { return is_ident(c); }
+    };
+    struct Number
+    {
+        static bool in_run(char c) { return is_digit(c) || c == '.'; }
+    };
+    struct StringBody
+    {
+        static bool in_run(char c) { return c != '"' && c != '\\' && c != '\n'; }
+    };
+
+    template<typename Class>
+    static size_t skip_scalar(const char* data, size_t pos, size_t end)
+    {
+        while(pos < end && Class::in_run(data[pos]))
+            pos++;
+        return pos;
+    }
+
+#if LANG_SCAN_X86
+    static inline int first_set_bit(uint32_t mask)
+    {
+    #if defined(_MSC_VER) && !defined(__clang__)
+        unsigned long idx;
+        _BitScanForward(&idx, mask);
+        return (int) idx;
+    #else
+        return __builtin_ctz(mask);
+    #endif
+    }
+
+    // Signed byte compares are fine here, every class is made of ASCII
+    // characters and bytes >= 0x80 compare as negative, i.e. never in range
+    static inline __m128i in_range_128(__m128i v, char lo, char hi)
+    {
+        return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+                             _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+    }
+    static inline __m128i equal_128(__m128i v, char c)
+    {
+        return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+    }
+
+    static inline __m128i match_128(Blank, __m128i v)
+    {
+        return _mm_or_si128(_mm_or_si128(equal_128(v, ' '), equal_128(v, '\t')),
+                            _mm_or_si128(equal_128(v, '\r'), in_range_128(v, '\v', '\f')));
+    }
+    static inline __m128i match_128(Identifier, __m128i v)
+    {
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        return _mm_or_si128(_mm_or_si128(in_range_128(lower, 'a', 'z'), in_range_128(v, '0', '9')),
+                            equal_128(v, '_'));
+    }
+    static inline __m128i match_128(Number, __m128i v)
+    {
+        return _mm_or_si128(in_range_128(v, '0', '9'), equal_128(v, '.'));
+    }
+    static inline __m128i match_128(StringBody, __m128i v)
+    {
+        __m128i stop = _mm_or_si128(_mm_or_si128(equal_128(v, '"'), equal_128(v, '\\')), equal_128(v, '\n'));
+        return _mm_xor_si128(stop, _mm_set1_epi8(-1));
+    }
+
+    template<typename Class>
+    static size_t skip_sse2(const char* data, size_t pos, size_t end)
+    {
+        while(pos + 16 <= end)
+        {
+            __m128i  chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            uint32_t stops = ~(uint32_t) _mm_movemask_epi8(match_128(Class{}, chunk)) & 0xFFFF;
+            if(stops)
+                return pos + first_set_bit(stops);
+            pos += 16;
+        }
+        return skip_scalar<Class>(data, pos, end);
+    }
+#endif
+
+#if LANG_SCAN_AVX2
+    LANG_TARGET_AVX2 static inline __m256i in_range_256(__m256i v, char lo, char hi)
+    {
+        return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)),
+                                _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v));
+    }
+    LANG_TARGET_AVX2 static inline __m256i equal_256(__m256i v, char c)
+    {
+        return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+    }
+
+    LANG_TARGET_AVX2 static inline __m256i match_256(Blank, __m256i v)
+    {
+        return _mm256_or_si256(_mm256_or_si256(equal_256(v, ' '), equal_256(v, '\t')),
+                               _mm256_or_si256(equal_256(v, '\r'), in_range_256(v, '\v', '\f')));
+    }
+    LANG_TARGET_AVX2 static inline __m256i match_256(Identifier, __m256i v)
+    {
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        return _mm256_or_si256(_mm256_or_si256(in_range_256(lower, 'a', 'z'), in_range_256(v, '0', '9')),
+                               equal_256(v, '_'));
+    }
+    LANG_TARGET_AVX2 static inline __m256i match_256(Number, __m256i v)
+    {
+        return _mm256_or_si256(in_range_256(v, '0', '9'), equal_256(v, '.'));
+    }
+    LANG_TARGET_AVX2 static inline __m256i match_256(StringBody, __m256i v)
+    {
+        __m256i stop = _mm256_or_si256(_mm256_or_si256(equal_256(v, '"'), equal_256(v, '\\')), equal_256(v, '\n'));
+        return _mm256_xor_si256(stop, _mm256_set1_epi8(-1));
+    }
+
+    template<typename Class>
+    LANG_TARGET_AVX2 static size_t skip_avx2(const char* data, size_t pos, size_t end)
+    {
+        while(pos + 32 <= end)
+        {
+            __m256i  chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+            uint32_t stops = ~(uint32_t) _mm256_movemask_epi8(match_256(Class{}, chunk));
+            if(stops)
+                return pos + first_set_bit(stops);
+            pos += 32;
+        }
+        return skip_sse2<Class>(data, pos, end);
+    }
+#endif
+
+    static const Scanners SCALAR_SCANNERS = {
+        skip_scalar<Blank>, skip_scalar<Identifier>, skip_scalar<Number>, skip_scalar<StringBody>
+    };
+#if LANG_SCAN_X86
+    static const Scanners SSE2_SCANNERS = {
+        skip_sse2<Blank>, skip_sse2<Identifier>, skip_sse2<Number>, skip_sse2<StringBody>
+    };
+#endif
+#if LANG_SCAN_AVX2
+    static const Scanners AVX2_SCANNERS = {
+        skip_avx2<Blank>, skip_avx2<Identifier>, skip_avx2<Number>, skip_avx2<StringBody>
+    };
+#endif
+
+    Impl best_supported_impl()
+    {
+    #if LANG_SCAN_AVX2
+        if(__builtin_cpu_supports("avx2"))
+            return Impl::AVX2;
+    #endif
+    #if LANG_SCAN_X86
+        return Impl::SSE2;
+    #else
+        return Impl::SCALAR;
+    #endif
+    }
+
+    static Scanners scanners_for(Impl impl)
+    {
+        switch(impl)
+        {
+        #if LANG_SCAN_AVX2
+            case Impl::AVX2: return AVX2_SCANNERS;
+        #endif
+        #if LANG_SCAN_X86
+            case Impl::SSE2: return SSE2_SCANNERS;
+        #endif
+            default:         return SCALAR_SCANNERS;
+        }
+    }
+
+    // Chosen during static initialisation so the lexer never has to check
+    static Impl current_impl = best_supported_impl();
+    Scanners    active       = scanners_for(current_impl);
+
+    bool select_impl(Impl impl)
+    {
+        if(impl > best_supported_impl())
+            return false;
+        active       = scanners_for(impl);
+        current_impl = impl;
+        return true;
+    }
+
+    Impl active_impl() { return current_impl; }
+
+    const char* impl_name(Impl impl)
+    {
+        switch(impl)
+        {
+            case Impl::AVX2: return "avx2";
+            case Impl::SSE2: return "sse2";
+            default:         return "scalar";
+        }
+    }
+}
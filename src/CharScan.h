@@ -0,0 +1,56 @@
+#pragma once
+#ifndef LANG_CHAR_SCAN_H
+#define LANG_CHAR_SCAN_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Character classification for the lexer's inner loops. Each skip_* function
+// returns the index of the first byte in [pos, end) that is not part of the
+// run (or `end`). The vectorised versions look at 16 or 32 bytes at a time
+// and are picked once at startup based on what the CPU supports; they all
+// produce exactly the same results as the scalar fallback.
+//
+// Only ASCII is classified, unlike <ctype.h> this never depends on the locale.
+namespace scan
+{
+    enum CharClass : uint8_t
+    {
+        CH_BLANK = 1 << 0,   // ' ' \t \r \v \f (newlines are handled separately)
+        CH_ALPHA = 1 << 1,
+        CH_DIGIT = 1 << 2,
+        CH_IDENT = 1 << 3,   // alnum or '_'
+    };
+    extern const std::array<uint8_t, 256> CHAR_CLASS;
+
+    inline bool is_blank(char c) { return CHAR_CLASS[(uint8_t) c] & CH_BLANK; }
+    inline bool is_alpha(char c) { return CHAR_CLASS[(uint8_t) c] & CH_ALPHA; }
+    inline bool is_digit(char c) { return CHAR_CLASS[(uint8_t) c] & CH_DIGIT; }
+    inline bool is_ident(char c) { return CHAR_CLASS[(uint8_t) c] & CH_IDENT; }
+
+    enum class Impl { SCALAR, SSE2, AVX2 };
+
+    struct Scanners
+    {
+        size_t (*skip_blank)      (const char*, size_t pos, size_t end);
+        size_t (*skip_identifier) (const char*, size_t pos, size_t end);
+        size_t (*skip_number)     (const char*, size_t pos, size_t end);   // digits and '.'
+        size_t (*skip_string_body)(const char*, size_t pos, size_t end);   // stops at '"', '\\' or '\n'
+    };
+    extern Scanners active;
+
+    Impl best_supported_impl();
+    Impl active_impl();
+    const char* impl_name(Impl);
+
+    // Returns false if the CPU doesn't support the requested implementation
+    bool select_impl(Impl);
+
+    inline size_t skip_blank(const char* data, size_t pos, size_t end)       { return active.skip_blank(data, pos, end); }
+    inline size_t skip_identifier(const char* data, size_t pos, size_t end)  { return active.skip_identifier(data, pos, end); }
+    inline size_t skip_number(const char* data, size_t pos, size_t end)      { return active.skip_number(data, pos, end); }
+    inline size_t skip_string_body(const char* data, size_t pos, size_t end) { return active.skip_string_body(data, pos, end); }
+}
+
+#endif
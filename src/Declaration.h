@@ -23,18 +23,24 @@ namespace ast
 {
     struct ParameterNode : public AST_Node
     {
-        ParameterNode(Type_t type, const std::string& name):
+        ParameterNode(Type_t type, Symbol name):
             type(type), name(name) { }
 
-        int output_graphviz(GraphvizDocument& doc) const override;
         ~ParameterNode() { }
 
-        std::unique_ptr<ParameterNode>* get_next() { return &next; } 
+        ParameterNode** get_next() { return &next; }
+        const ParameterNode* get_next_param() const { return next; }
+        Type_t get_type() const { return type; }
+        Symbol get_name() const { return name; }
+
+        uint32_t get_slot() const     { return slot; }
+        void     set_slot(uint32_t s) { slot = s; }
 
         private:
-            Type_t      type;
-            std::string name;
-            std::unique_ptr<ParameterNode> next = nullptr;
+            Type_t type;
+            Symbol name;
+            uint32_t slot = NO_SLOT;    // Set by resolve_program()
+            ParameterNode* next = nullptr;
     };
 
     class Declaration : public AST_Node
@@ -45,16 +51,13 @@ namespace ast
                 basic_type(type) { }
 
             Type_t get_type() const { return basic_type; }
-            virtual int output_graphviz(GraphvizDocument& doc) const = 0;
             virtual ~Declaration() = default;
 
-            void set_next(std::unique_ptr<ast::Declaration>& n)
-            {
-                next = std::move(n);
-            }
+            void set_next(Declaration* n) { next = n; }
+            Declaration* get_next() const { return next; }
         protected:
             Type_t basic_type;
-            std::unique_ptr<Declaration > next = nullptr;
+            Declaration* next = nullptr;
     };
 
     class FunctionDecl : public Declaration
@@ -62,16 +65,21 @@ namespace ast
         public:
             FunctionDecl():
                 Declaration(Type_t::FUNCTION) { }
-            FunctionDecl(const std::string& name, ParameterNode* params, Type_t ret_type, ast::Statement* body):
+            FunctionDecl(Symbol name, ParameterNode* params, Type_t ret_type, ast::Statement* body):
                 Declaration(Type_t::FUNCTION), name(name), params(params), return_type(ret_type), body(body) { }
 
-            int output_graphviz(GraphvizDocument& doc) const override;
-            
+
+            Symbol               get_name() const        { return name; }
+            const ParameterNode* get_params() const      { return params; }
+            ParameterNode*       get_params()            { return params; }
+            Type_t               get_return_type() const { return return_type; }
+            const Statement*     get_body() const        { return body; }
+            Statement**          body_ref()              { return &body; }
         private:
-            std::string name = {};
-            std::unique_ptr<ParameterNode> params = nullptr;
+            Symbol name = NO_SYMBOL;
+            ParameterNode* params = nullptr;
             Type_t return_type = Type_t::VOID;
-            std::unique_ptr<Statement> body = nullptr;
+            Statement* body = nullptr;
     };
 
     class VariableDecl : public Declaration
@@ -79,29 +87,77 @@ namespace ast
         public:
             VariableDecl():
                 Declaration(Type_t::VOID) {}
-            VariableDecl(Type_t type, const std::string& name, Expression* expr = nullptr):
+            VariableDecl(Type_t type, Symbol name, Expression* expr = nullptr):
                 Declaration(type), name(name), expr(expr) {}
-            int output_graphviz(GraphvizDocument& ) const override;
             ~VariableDecl() override { }
+
+            Symbol            get_name() const { return name; }
+            const Expression* get_expr() const { return expr; }
+            Expression**      expr_ref()       { return &expr; }
+
+            uint32_t get_slot() const     { return slot; }
+            void     set_slot(uint32_t s) { slot = s; }
         private:
-            std::string name = {};
-            std::unique_ptr<Expression> expr = nullptr;
+            Symbol name = NO_SYMBOL;
+            uint32_t slot = NO_SLOT;    // Set by resolve_program(), variables in functions only
+            Expression* expr = nullptr;
     };
 
     class VarDeclStatement : public Statement
     {
     public:
-        VarDeclStatement() = default;
+        VarDeclStatement():
+            Statement(Stmt_t::DECL) { }
         VarDeclStatement(VariableDecl* decl):
-            decl(decl) { }
-        int output_graphviz(GraphvizDocument&) const override;
+            Statement(Stmt_t::DECL), decl(decl) { }
         ~VarDeclStatement() override { }
+
+        const VariableDecl* get_decl() const { return decl; }
+        VariableDecl*       get_decl()       { return decl; }
     private:
-        std::unique_ptr<VariableDecl> decl = nullptr;
+        VariableDecl* decl = nullptr;
     };
 
-    std::unique_ptr<Declaration> parse_declaration(ParserState*);
-    std::unique_ptr<Declaration> maybe_parse_function_decl(ParserState*);
-    std::unique_ptr<Declaration> maybe_parse_variable_decl(ParserState*);
+    // The declarations of a whole program, chained through Declaration::next.
+    // Every node lives in `arena` so the tree is freed in one go along with it.
+    struct ParseResult
+    {
+        std::unique_ptr<Arena> arena = nullptr;
+        Declaration*           root  = nullptr;
+    };
+
+    ParseResult  parse_program(ParserState*);
+    Declaration* parse_declaration(ParserState*);
+
+    // One past the '}' matching the first '{' at or after `begin`, or `eof`
+    // if the braces never balance. A top-level declaration starting at
+    // `begin` that parses ends exactly there: nothing before its body can
+    // hold a brace, and only parse_block() consumes them, always in pairs.
+    // One that doesn't parse stops the parser inside it, so where it would
+    // have ended doesn't matter.
+    size_t find_declaration_end(const Token* tokens, size_t begin, size_t eof);
+
+    // The same over a stream that isn't in one piece, token_at(i) gives token i
+    template<typename TokenAt>
+    size_t find_declaration_end(const TokenAt& token_at, size_t begin, size_t eof)
+    {
+        size_t depth = 0;
+        for(size_t i = begin; i < eof; i++)
+        {
+            TokenType type = token_at(i).type;
+            if(type == TOKEN_LEFT_CBRACK)
+                depth++;
+            else if(type == TOKEN_RIGHT_CBRACK)
+            {
+                if(depth == 0)
+                    return eof;     // Closes nothing, so this one won't parse
+                if(--depth == 0)
+                    return i + 1;
+            }
+        }
+        return eof;
+    }
+    Declaration* maybe_parse_function_decl(ParserState*);
+    Declaration* maybe_parse_variable_decl(ParserState*);
 };
 #endif
@@ -1,191 +1,268 @@
 #include "Expression.h"
+#include "ParseProfile.h"
 
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <vector>
 
 namespace ast {
-    // Backtracks the current token to the identifier in the event 
-    // that this is not a function call
-    std::unique_ptr<Expression> maybe_parse_func_call(ParserState* parser)
+    namespace
     {
-        Token* ident_token = parser->curr_token;
-        auto ast_ident = std::make_unique<Expression>(Expr_t::IDENTIFIER, ident_token->lexeme);
-        parser->get_next_token();
+        // A parse_expression() level or an atom still waiting on a nested
+        // expression, these used to be recursive calls
+        enum class Pending : uint8_t { OPERAND, PAREN, NEGATE, ARGUMENT };
 
-        if(parser->match_token(TOKEN_LEFT_PAREN))
+        struct Frame
         {
-            parser->get_next_token(); // consume '('
-
-            std::unique_ptr<Expression>  arg_root = nullptr;
-            std::unique_ptr<Expression>* curr_arg = &arg_root;
-            bool expecting_another_argument = false;
+            Pending       kind;
+            int           min_prec = 0;         // OPERAND: the level's own precedence floor
+            Expression*   result   = nullptr;   // OPERAND: what's been parsed of the level so far
+            Operator_Info op       = {};        // OPERAND: the operator waiting for its rhs
+            Symbol        callee   = NO_SYMBOL; // ARGUMENT
+            Expression*   args     = nullptr;   // ARGUMENT: ARG chain so far
+            Expression*   last_arg = nullptr;
+            ProfileMark   mark     = {};        // PAREN, NEGATE, ARGUMENT: where the atom started, when profiling
+        };
 
-            while(!parser->match_token(TOKEN_RIGHT_PAREN))
-            {
-                auto arg = ast::parse_expression(parser);
-                if(!arg && expecting_another_argument)
-                {
-                    parser->emit_error("Invalid argument!\n");
-                    parser->curr_token = ident_token;
-                    return nullptr;
-                }
-                *curr_arg = std::make_unique<Expression>(Expr_t::ARG, arg.release());
-                 curr_arg = (*curr_arg)->rhs();
-
-                 if(parser->match_token(TOKEN_COMMA))
-                 {
-                     parser->get_next_token();
-                     expecting_another_argument = true;
-                 }
-            }
-            if(!parser->match_token(TOKEN_RIGHT_PAREN))
-            {
-                parser->emit_error("Unmatched parenthesis on function call");
-                parser->curr_token = ident_token;
-                return nullptr;
-            }
-            parser->get_next_token(); // consume ')'
-            return std::make_unique<Expression>(Expr_t::CALL, ast_ident.release(), arg_root.release());
-        } 
-        parser->curr_token = ident_token;
-        return nullptr;
-    }
-    std::unique_ptr<Expression> parse_atom(ParserState* parser)
-    {
-        std::unique_ptr<Expression> atom = nullptr;
+        // Where parse_expression() is at with the frame on top of the stack
+        enum class Step { ATOM, HAVE_ATOM, OPERATORS, DELIVER };
 
-        if(parser->match_token(TOKEN_IDENTIFIER))
+        Frame level(int min_prec)
         {
-            atom = ast::maybe_parse_func_call(parser);
-            if(atom == nullptr)
-            {
-                atom = std::make_unique<Expression>(Expr_t::IDENTIFIER, parser->curr_token->lexeme);
-                parser->get_next_token();
-            }
+            Frame frame { Pending::OPERAND };
+            frame.min_prec = min_prec;
+            return frame;
         }
-        else if(parser->match_token(TOKEN_INT_LITERAL))
-        {
-            atom = std::make_unique<Expression>((int64_t) parser->curr_token->int_value);
-            parser->get_next_token();
-        }
-        else if(parser->match_token(TOKEN_FLOAT_LITERAL))
-        {
-            atom = std::make_unique<Expression>(parser->curr_token->flt_value);
-            parser->get_next_token();
-        }
-        else if(parser->match_token(TOKEN_LEFT_PAREN))
-        {
-            parser->get_next_token();   // consume '('
 
-            atom = ast::parse_expression(parser);
-            if (!parser->match_token(TOKEN_RIGHT_PAREN))
-            {
-                parser->emit_error("Unmatched parenthesis!\n");
-                return nullptr;
-            }
-            parser->get_next_token(); // consume ')'
-        }
-        else if(parser->match_token(TOKEN_OP_MINUS))
+        Expression* make_call(ParserState* parser, const Frame& call)
         {
-            parser->get_next_token(); // consume '-'
-            atom = ast::parse_expression(parser); // TODO: actually do the negation
-            atom = std::make_unique<Expression>(Expr_t::NEGATE, atom.release());
+            auto ast_ident = make_node<Expression>(parser, Expr_t::IDENTIFIER, call.callee);
+            return make_node<Expression>(parser, Expr_t::CALL, ast_ident, call.args);
         }
-        else if (parser->match_token(TOKEN_STR_LITERAL))
+
+        // An atom that opened a nested expression is done with it
+        void end_atom(const ParserState* parser, const Frame& frame)
         {
-            atom = std::make_unique<Expression>(Expr_t::STRING_LITERAL, parser->curr_token->lexeme);
-            parser->get_next_token();
+            if(!parser->profile)
+                return;
+            if(frame.kind == Pending::ARGUMENT)
+                profile_end(parser, Production::FUNC_CALL, frame.mark);
+            profile_end(parser, Production::ATOM, frame.mark);
         }
-        return atom;
     }
-    std::unique_ptr<Expression> parse_expression(ParserState* parser, int min_prec)
+
+    // Precedence climbing, but the pending levels are kept on an explicit
+    // stack rather than the call stack, so any amount of nesting parses in
+    // constant stack space. Builds the same nodes in the same order and
+    // reports the same errors as the recursive version did:
+    //
+    //   Expr  := Atom (BinOp Expr)*
+    //   Atom  := IDENTIFIER '(' Args ')' | IDENTIFIER | INT | FLOAT | STRING
+    //          | '(' Expr ')' | '-' Expr
+    //
+    // Note that '-' negates the whole expression after it.
+    Expression* parse_expression(ParserState* parser, int min_prec)
     {
-        auto result = ast::parse_atom(parser);
+        ProfileScope profile(parser, Production::EXPRESSION);
 
-        if (!result)
+        // parse_expression() never calls back into itself, so one stack per
+        // thread is reused instead of allocating for every expression
+        thread_local std::vector<Frame> stack;
+        stack.clear();
+        stack.push_back(level(min_prec));
+
+        Expression* value = nullptr;
+        Step        step  = Step::ATOM;
+        while(true)
         {
-            parser->emit_error("Invalid expression!\n");
-            return result;
-        }
+            switch(step)
+            {
+            case Step::ATOM:
+            {
+                // Either an atom is complete or it opens a nested expression
+                value = nullptr;
+                step  = Step::HAVE_ATOM;
 
-        bool is_binary_op = false;
-        Operator_Info curr_op;
+                Frame atom { Pending::OPERAND };
+                if(parser->profile)
+                    atom.mark = profile_begin(parser, Production::ATOM);
 
-        while ((is_binary_op = check_if_binary_op(parser, &curr_op)) && curr_op.precedence >= min_prec)
-        {
-            Token* bin_op = parser->curr_token;
-            parser->get_next_token();
+                if(parser->match_token(TOKEN_IDENTIFIER))
+                {
+                    if(parser->peek(1).type == TOKEN_LEFT_PAREN)
+                    {
+                        // Starts where the atom does, so it shares the atom's mark
+                        if(parser->profile)
+                            profile_begin(parser, Production::FUNC_CALL);
+
+                        Frame& call = atom;
+                        call.kind   = Pending::ARGUMENT;
+                        call.callee = parser->current().symbol;
+                        parser->get_next_token(); // consume identifier
+                        parser->get_next_token(); // consume '('
+
+                        if(!parser->match_token(TOKEN_RIGHT_PAREN))
+                        {
+                            stack.push_back(call);
+                            stack.push_back(level(0));
+                            step = Step::ATOM;
+                            break;
+                        }
+                        parser->get_next_token(); // consume ')'
+                        value = make_call(parser, call);
+                    }
+                    else
+                    {
+                        value = make_node<Expression>(parser, Expr_t::IDENTIFIER, parser->current().symbol);
+                        parser->get_next_token();
+                    }
+                }
+                else if(parser->match_token(TOKEN_INT_LITERAL))
+                {
+                    value = make_node<Expression>(parser, (int64_t) parser->current().int_value);
+                    parser->get_next_token();
+                }
+                else if(parser->match_token(TOKEN_FLOAT_LITERAL))
+                {
+                    value = make_node<Expression>(parser, parser->current().flt_value);
+                    parser->get_next_token();
+                }
+                else if(parser->match_token(TOKEN_STR_LITERAL))
+                {
+                    value = make_node<Expression>(parser, Expr_t::STRING_LITERAL, parser->arena->copy(parser->lexeme(parser->curr_token)));
+                    parser->get_next_token();
+                }
+                else if(parser->match_token(TOKEN_LEFT_PAREN) || parser->match_token(TOKEN_OP_MINUS))
+                {
+                    atom.kind = parser->match_token(TOKEN_LEFT_PAREN) ? Pending::PAREN : Pending::NEGATE;
+                    stack.push_back(atom);
+                    stack.push_back(level(0));
+                    parser->get_next_token(); // consume '(' or '-'
+                    step = Step::ATOM;
+                }
+
+                // Anything that didn't open a nested expression is finished,
+                // including nothing at all
+                if(step == Step::HAVE_ATOM)
+                    end_atom(parser, atom);
+            }
+            break;
 
-            int next_min_prec = curr_op.precedence + (curr_op.is_left_assoc ? 1 : 0);
-            auto rhs = ast::parse_expression(parser, next_min_prec);
+            case Step::HAVE_ATOM:
+                // `value` is the first operand of the level on top
+                if(!value)
+                {
+                    parser->emit_error("Invalid expression!\n");
+                    stack.pop_back();
+                    step = Step::DELIVER;
+                    break;
+                }
+                stack.back().result = value;
+                step = Step::OPERATORS;
+            break;
 
-            if (!rhs)
+            case Step::OPERATORS:
             {
-                if (parser->status == PARSE_SUCCESS) parser->status = PARSE_ERR_MALFORMED_EXPR;
-                parser->curr_token = bin_op;
-                return nullptr;
+                Frame& frame = stack.back();
+                Operator_Info curr_op;
+                if(check_if_binary_op(parser, &curr_op) && curr_op.precedence >= frame.min_prec)
+                {
+                    parser->get_next_token();
+                    frame.op = curr_op;
+                    stack.push_back(level(curr_op.precedence + (curr_op.is_left_assoc ? 1 : 0)));
+                    step = Step::ATOM;
+                    break;
+                }
+                value = frame.result;
+                stack.pop_back();
+                step = Step::DELIVER;
             }
+            break;
 
-            // TODO: get the type of the expression
-            result = std::make_unique<Expression>(curr_op.expr_type, result.release(), rhs.release());
-        }
-        return result;
-    }
+            case Step::DELIVER:
+            {
+                // `value` is a finished nested expression, or nullptr if it
+                // failed, for whatever is on top
+                if(stack.empty())
+                    return value;
 
-    int Expression::output_graphviz(GraphvizDocument& doc) const
-    {
-        static const char* EXPR_FMT   = "    expr_%d[label=\"{%s|{<f1>lhs|<f2>rhs}}\"];\n";
-        static const char* EXPR_FMT_S = "    expr_%d[label=\"{\\\"%s\\\"|{<f1>lhs|<f2>rhs}}\"];\n";
-        static const char* EXPR_FMT_I = "    expr_%d[label=\"{%ld|{<f1>lhs|<f2>rhs}}\"];\n";
-        static const char* EXPR_FMT_F = "    expr_%d[label=\"{%.2f|{<f1>lhs|<f2>rhs}}\"];\n";
-        static const std::unordered_map<Expr_t, std::string> op_lexemes = {
-            { Expr_t::ADD   , "+" }, { Expr_t::SUB   ,  "-" }, { Expr_t::MUL, "*" }, { Expr_t::DIV, "/" },
-            { Expr_t::ASSIGN, "=" }, { Expr_t::COMP_LT, "\\<" }
-        };
+                Frame& frame = stack.back();
+                switch(frame.kind)
+                {
+                case Pending::OPERAND:
+                    if(!value)
+                    {
+                        if (parser->status == PARSE_SUCCESS) parser->status = PARSE_ERR_MALFORMED_EXPR;
+                        stack.pop_back();
+                        break;
+                    }
+                    // TODO: get the type of the expression
+                    frame.result = make_node<Expression>(parser, frame.op.expr_type, frame.result, value);
+                    step = Step::OPERATORS;
+                break;
 
-        char buffer[1024] = {};
+                case Pending::PAREN:
+                {
+                    Frame paren = frame;
+                    stack.pop_back();
+                    step = Step::HAVE_ATOM;
+                    if (!parser->match_token(TOKEN_RIGHT_PAREN))
+                    {
+                        parser->emit_error("Unmatched parenthesis!\n");
+                        value = nullptr;
+                    }
+                    else
+                        parser->get_next_token(); // consume ')'
+                    end_atom(parser, paren);
+                }
+                break;
 
-        int expr_id = doc.next_id();
-        switch(expr_type)
-        {
-        case Expr_t::IDENTIFIER:
-            std::snprintf(buffer, 1024, EXPR_FMT, expr_id, str_value.c_str()); break;
-        case Expr_t::CALL:
-            std::snprintf(buffer, 1024, EXPR_FMT, expr_id, "\\<call\\>"); break;
-        case Expr_t::ARG:
-            std::snprintf(buffer, 1024, EXPR_FMT, expr_id, "\\<args\\>"); break;
-        case Expr_t::INT_LITERAL:
-            std::snprintf(buffer, 1024, EXPR_FMT_I, expr_id, int_value); 
-            break;
-        case Expr_t::FLOAT_LITERAL:
-            std::snprintf(buffer, 1024, EXPR_FMT_F, expr_id, flt_value); 
-            break;
-        case Expr_t::STRING_LITERAL:
-            std::snprintf(buffer, 1024, EXPR_FMT_S, expr_id, str_value.c_str());
-            break;
-        default: 
-            if (op_lexemes.find(expr_type) != op_lexemes.end())
-                std::snprintf(buffer, 1024, EXPR_FMT, expr_id, op_lexemes.at(expr_type).c_str()); 
-            else
-                std::snprintf(buffer, 1024, EXPR_FMT, expr_id, "op"); 
-            break;
-        }
-        doc.oss << buffer;
+                case Pending::NEGATE:
+                    value = make_node<Expression>(parser, Expr_t::NEGATE, value); // TODO: actually do the negation
+                    step  = Step::HAVE_ATOM;
+                    end_atom(parser, frame);
+                    stack.pop_back();
+                break;
 
-        if(lhs_)
-        {
-            int lhs_id = lhs_->output_graphviz(doc);
-            doc.oss << "    expr_" << expr_id << ":<f1> -> expr_" << lhs_id << ";\n";
-        }
+                case Pending::ARGUMENT:
+                {
+                    step = Step::HAVE_ATOM;
+                    if(!value)
+                    {
+                        parser->emit_error("Invalid argument!\n");
+                        end_atom(parser, frame);
+                        stack.pop_back();
+                        break;
+                    }
+                    Expression* arg = make_node<Expression>(parser, Expr_t::ARG, value);
+                    if(frame.last_arg)
+                        *frame.last_arg->rhs() = arg;
+                    else
+                        frame.args = arg;
+                    frame.last_arg = arg;
 
-        if(rhs_)
-        {
-            int rhs_id = rhs_->output_graphviz(doc);
-            doc.oss << "    expr_" << expr_id << ":<f2> -> expr_" << rhs_id << ";\n";
+                    if(parser->match_token(TOKEN_COMMA))
+                        parser->get_next_token();
+
+                    if(!parser->match_token(TOKEN_RIGHT_PAREN))
+                    {
+                        stack.push_back(level(0));
+                        step = Step::ATOM;
+                        break;
+                    }
+                    parser->get_next_token(); // consume ')'
+                    value = make_call(parser, frame);
+                    end_atom(parser, frame);
+                    stack.pop_back();
+                }
+                break;
+                }
+            }
+            break;
+            }
         }
-        return expr_id;
     }
 }
 
@@ -200,15 +277,12 @@ bool check_if_binary_op(ParserState* parser, Operator_Info* op_info)
         { TOKEN_OP_EQU    , 0 , false, Expr_t::ASSIGN   } ,
     };
     
-    if (parser->curr_token != NULL)
+    for (size_t i = 0; i < 11; ++i)
     {
-        for (size_t i = 0; i < 11; ++i)
+        if (parser->current().type == info[i].op)
         {
-            if (parser->curr_token->type == info[i].op)
-            {
-                *op_info = info[i];
-                return true;
-            }
+            *op_info = info[i];
+            return true;
         }
     }
     return false;
@@ -7,12 +7,16 @@
 #include <unordered_map>
 #include "Node.h"
 
-enum class Expr_t { 
+enum class Expr_t : uint8_t { 
     NONE           , ADD      , MUL        , DIV         , SUB           ,
     COMP_LT        , COMP_NEQ , COMP_LEQ   , ASSIGN      , COMP_GT       ,
     COMP_GEQ       , COMP_EQU , IDENTIFIER , INT_LITERAL , FLOAT_LITERAL ,
     STRING_LITERAL , NEGATE   , ARG        , CALL        ,
 };
+
+// A name the resolver hasn't bound to anything
+constexpr uint32_t NO_SLOT = UINT32_MAX;
+
 class Type_t { 
 public:
     enum Value
@@ -31,6 +35,7 @@ public:
         return str.at(value);
     }
     bool operator==(const Value& v) const { return value == v; }
+    Value get_value() const { return value; }
 private:
     Value value;
 };
@@ -49,12 +54,17 @@ namespace ast {
     private:
         Expr_t expr_type = Expr_t::NONE;
 
+        // Identifiers' slot in their function's frame, or the index of the
+        // function a call calls. Set by resolve_program(), see Resolver.h.
+        uint32_t slot = NO_SLOT;
+
         int64_t     int_value = 0;
         double      flt_value = 0.0;
-        std::string str_value = {};
+        Symbol      symbol    = NO_SYMBOL;     // Identifiers
+        std::string_view str_value = {};       // String literals, copied into the parse's arena
 
-        std::unique_ptr<Expression> lhs_ = nullptr;
-        std::unique_ptr<Expression> rhs_ = nullptr;
+        Expression* lhs_ = nullptr;
+        Expression* rhs_ = nullptr;
     public:
         Expression() = default;
         Expression(Expr_t expr_type, Expression* lhs = nullptr, Expression* rhs = nullptr):
@@ -66,25 +76,30 @@ namespace ast {
         Expression(double flt_value ) : 
             expr_type(Expr_t::FLOAT_LITERAL), flt_value(flt_value) {}
 
-        Expression(Expr_t type, const std::string& str) : 
+        Expression(Expr_t type, std::string_view str) : 
             expr_type(type), str_value(str) { }
 
+        Expression(Expr_t type, Symbol sym) :
+            expr_type(type), symbol(sym) { }
+
         int64_t get_int()  const    { return int_value; }
         double  get_flt()  const    { return flt_value; }
         Expr_t  get_type() const    { return expr_type; }
-        std::string get_str() const { return str_value; }
+        std::string_view get_str() const { return str_value; }
+        Symbol  get_symbol() const  { return symbol; }
+        uint32_t get_slot() const   { return slot; }
+        void     set_slot(uint32_t s) { slot = s; }
+        const Expression* get_lhs() const { return lhs_; }
+        const Expression* get_rhs() const { return rhs_; }
 
-        int output_graphviz(GraphvizDocument& doc) const override;
         ~Expression() override { }
         
-        std::unique_ptr<ast::Expression>* rhs() { return &rhs_; }
-        std::unique_ptr<ast::Expression>* lhs() { return &lhs_; }
+        Expression** rhs() { return &rhs_; }
+        Expression** lhs() { return &lhs_; }
     };
 
 
-    std::unique_ptr<Expression> parse_atom(ParserState*);
-    std::unique_ptr<Expression> parse_expression(ParserState*, int min_prec = 0);
-    std::unique_ptr<Expression> maybe_parse_func_call(ParserState*);
+    Expression* parse_expression(ParserState*, int min_prec = 0);
 };
 
 bool check_if_binary_op(ParserState*, Operator_Info*);
@@ -0,0 +1,273 @@
+#include "FlatAst.h"
+
+namespace ast
+{
+    namespace
+    {
+        struct Flattener
+        {
+            FlatAst& ast;
+
+            // Indices of list items already flattened but not yet copied into
+            // stmt_lists / expr_lists, nested lists stack up on top
+            std::vector<NodeIndex> pending;
+
+            NodeIndex push(FlatExpr flat)
+            {
+                ast.exprs.push_back(flat);
+                return (NodeIndex) ast.exprs.size() - 1;
+            }
+
+            uint32_t take_pending(size_t mark, std::vector<NodeIndex>& list)
+            {
+                uint32_t first = (uint32_t) list.size();
+                list.insert(list.end(), pending.begin() + mark, pending.end());
+                pending.resize(mark);
+                return first;
+            }
+
+            // An expression whose operands are being flattened
+            struct Visit
+            {
+                const Expression* expr;
+                const Expression* next_arg;     // CALL: ARG node of the next argument
+                uint32_t          next_operand; // Otherwise: 0 lhs, 1 rhs, 2 done
+                size_t            mark;         // Where its operands start in pending
+            };
+            std::vector<Visit> visits;
+
+            static bool is_leaf(Expr_t type)
+            {
+                return type == Expr_t::IDENTIFIER    || type == Expr_t::INT_LITERAL ||
+                       type == Expr_t::FLOAT_LITERAL || type == Expr_t::STRING_LITERAL;
+            }
+
+            void visit(const Expression* expr)
+            {
+                const Expression* first_arg = expr->get_type() == Expr_t::CALL ? expr->get_rhs() : nullptr;
+                visits.push_back({ expr, first_arg, 0, pending.size() });
+            }
+
+            // False once every operand of `visit` has been handed out
+            static bool next_operand(Visit& visit, const Expression*& operand)
+            {
+                const Expression* expr = visit.expr;
+                if(expr->get_type() == Expr_t::CALL)
+                {
+                    // The callee is always an identifier, and the ARG chain
+                    // becomes a plain list of the argument expressions
+                    if(visit.next_arg == nullptr)
+                        return false;
+                    operand        = visit.next_arg->get_lhs();
+                    visit.next_arg = visit.next_arg->get_rhs();
+                    return true;
+                }
+                if(is_leaf(expr->get_type()) || visit.next_operand == 2)
+                    return false;
+                operand = visit.next_operand++ == 0 ? expr->get_lhs() : expr->get_rhs();
+                return true;
+            }
+
+            // Its operands are the last entries of pending from `mark` on
+            NodeIndex finish(const Expression* expr, size_t mark)
+            {
+                FlatExpr flat;
+                flat.type = expr->get_type();
+                switch(expr->get_type())
+                {
+                    case Expr_t::IDENTIFIER:
+                        flat.a = expr->get_symbol();
+                    break;
+                    case Expr_t::INT_LITERAL:
+                        flat.a = (uint32_t) ast.ints.size();
+                        ast.ints.push_back(expr->get_int());
+                    break;
+                    case Expr_t::FLOAT_LITERAL:
+                        flat.a = (uint32_t) ast.floats.size();
+                        ast.floats.push_back(expr->get_flt());
+                    break;
+                    case Expr_t::STRING_LITERAL:
+                    {
+                        std::string_view text = expr->get_str();
+                        flat.a = (uint32_t) ast.strings.size();
+                        ast.strings.push_back({ (uint32_t) ast.chars.size(), (uint32_t) text.size() });
+                        ast.chars.append(text);
+                    }
+                    break;
+                    case Expr_t::CALL:
+                        flat.a = expr->get_lhs() ? expr->get_lhs()->get_symbol() : NO_SYMBOL;
+                        flat.c = (uint32_t) (pending.size() - mark);
+                        flat.b = take_pending(mark, ast.expr_lists);
+                    break;
+                    default:
+                        flat.a = pending[mark];
+                        flat.b = pending[mark + 1];
+                        pending.resize(mark);
+                    break;
+                }
+                return push(flat);
+            }
+
+            // Post-order over an explicit stack, operator chains can be as
+            // deep as the source makes them
+            NodeIndex expression(const Expression* root)
+            {
+                if(root == nullptr)
+                    return NO_NODE;
+
+                visit(root);
+                while(!visits.empty())
+                {
+                    const Expression* operand = nullptr;
+                    if(next_operand(visits.back(), operand))
+                    {
+                        if(operand)
+                            visit(operand);
+                        else
+                            pending.push_back(NO_NODE);
+                        continue;
+                    }
+                    Visit done = visits.back();
+                    visits.pop_back();
+                    pending.push_back(finish(done.expr, done.mark));
+                }
+                NodeIndex idx = pending.back();
+                pending.pop_back();
+                return idx;
+            }
+
+            // Everything but ifs, those are flattened by block()
+            NodeIndex statement(const Statement* stmt)
+            {
+                FlatStmt flat;
+                flat.type = stmt->get_type();
+                if(stmt->get_type() == Stmt_t::DECL)
+                {
+                    const VariableDecl* decl = static_cast<const VarDeclStatement*>(stmt)->get_decl();
+                    flat.a = expression(decl->get_expr());
+                    flat.b = decl->get_name();
+                    flat.c = decl->get_type().get_value();
+                }
+                else
+                    flat.a = expression(static_cast<const ExprStatement*>(stmt)->get_expr());
+
+                ast.stmts.push_back(flat);
+                return (NodeIndex) ast.stmts.size() - 1;
+            }
+
+            // A block whose statements are being flattened, or an if whose blocks are
+            struct Nested
+            {
+                const Statement*   next;        // Blocks: the statement to flatten next
+                const IfStatement* if_stmt;     // Ifs: the statement, nullptr for blocks
+                FlatStmt           flat;        // Ifs: what is known of it so far
+                uint32_t           branch;      // Ifs: 0 then, 1 else, 2 done
+                size_t             mark;        // Blocks: where their statements start in pending
+            };
+            std::vector<Nested> nested;
+
+            // Post-order over an explicit stack like expression(), ifs nest as
+            // deep as the source makes them
+            NodeIndex block(const Statement* first)
+            {
+                if(first == nullptr)
+                    return NO_NODE;
+
+                size_t base = nested.size();
+                nested.push_back({ first, nullptr, {}, 0, pending.size() });
+                while(true)
+                {
+                    Nested& top = nested.back();
+                    if(!top.if_stmt && top.next)
+                    {
+                        const Statement* stmt = top.next;
+                        top.next = stmt->next;
+                        if(stmt->get_type() == Stmt_t::IF)
+                        {
+                            auto     if_stmt = static_cast<const IfStatement*>(stmt);
+                            FlatStmt flat;
+                            flat.type = Stmt_t::IF;
+                            flat.a    = expression(if_stmt->get_condition());
+                            nested.push_back({ nullptr, if_stmt, flat, 0, 0 });
+                        }
+                        else
+                            pending.push_back(statement(stmt));
+                        continue;
+                    }
+                    if(top.if_stmt && top.branch < 2)
+                    {
+                        const Statement* branch = top.branch++ == 0 ? top.if_stmt->get_body() : top.if_stmt->get_else();
+                        if(branch)
+                            nested.push_back({ branch, nullptr, {}, 0, pending.size() });
+                        continue;
+                    }
+
+                    NodeIndex done;
+                    if(top.if_stmt)
+                    {
+                        ast.stmts.push_back(top.flat);
+                        done = (NodeIndex) ast.stmts.size() - 1;
+                    }
+                    else
+                    {
+                        FlatBlock flat;
+                        flat.count = (uint32_t) (pending.size() - top.mark);
+                        flat.first = take_pending(top.mark, ast.stmt_lists);
+
+                        ast.blocks.push_back(flat);
+                        done = (NodeIndex) ast.blocks.size() - 1;
+                    }
+                    nested.pop_back();
+                    if(nested.size() == base)
+                        return done;
+
+                    Nested& parent = nested.back();
+                    if(!parent.if_stmt)
+                        pending.push_back(done);
+                    else if(parent.branch == 1)
+                        parent.flat.b = done;
+                    else
+                        parent.flat.c = done;
+                }
+            }
+
+            void function(const FunctionDecl* func)
+            {
+                FlatFunction flat;
+                flat.name        = func->get_name();
+                flat.return_type = func->get_return_type().get_value();
+                flat.first_param = (uint32_t) ast.params.size();
+                for(const ParameterNode* param = func->get_params(); param; param = param->get_next_param())
+                    ast.params.push_back({ param->get_name(), param->get_type().get_value() });
+                flat.num_params  = (uint32_t) ast.params.size() - flat.first_param;
+                flat.body        = block(func->get_body());
+
+                ast.functions.push_back(flat);
+            }
+        };
+    }
+
+    FlatAst flatten(const Declaration* root, size_t num_nodes)
+    {
+        // Nearly every node is an expression
+        FlatAst ast;
+        ast.exprs.reserve(num_nodes);
+        Flattener flattener { ast, {}, {}, {} };
+
+        // Top-level variables aren't parsed yet, see maybe_parse_variable_decl()
+        for(const Declaration* decl = root; decl; decl = decl->get_next())
+            if(decl->get_type() == Type_t::FUNCTION)
+                flattener.function(static_cast<const FunctionDecl*>(decl));
+        return ast;
+    }
+
+    size_t FlatAst::memory_bytes() const
+    {
+        return functions.size()  * sizeof(FlatFunction) + params.size()     * sizeof(FlatParam)
+             + blocks.size()     * sizeof(FlatBlock)    + stmts.size()      * sizeof(FlatStmt)
+             + exprs.size()      * sizeof(FlatExpr)     + stmt_lists.size() * sizeof(NodeIndex)
+             + expr_lists.size() * sizeof(NodeIndex)    + ints.size()       * sizeof(int64_t)
+             + floats.size()     * sizeof(double)       + strings.size()    * sizeof(FlatString)
+             + chars.size();
+    }
+}
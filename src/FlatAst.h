@@ -0,0 +1,109 @@
+#pragma once
+#ifndef LANG_AST_FLAT_AST_H
+#define LANG_AST_FLAT_AST_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Declaration.h"
+
+// The same program as the node tree but laid out in a handful of flat arrays
+// of small fixed-size records, linked by 32-bit indices rather than pointers.
+// It holds no pointers at all so it can be copied, written out or mapped back
+// in as is, and walking it touches a few dense arrays instead of chasing
+// nodes scattered across the heap.
+namespace ast
+{
+    using NodeIndex = uint32_t;
+    constexpr NodeIndex NO_NODE = UINT32_MAX;
+
+    // What a, b and c hold depends on the type:
+    //   binary operators, ASSIGN     a = lhs, b = rhs
+    //   NEGATE                       a = operand
+    //   IDENTIFIER                   a = Symbol
+    //   INT_LITERAL, FLOAT_LITERAL   a = index into ints / floats
+    //   STRING_LITERAL               a = index into strings
+    //   CALL                         a = callee Symbol, b = first argument in expr_lists, c = argument count
+    // Operands always come before the expression using them, so a forward
+    // scan over exprs sees every expression after its operands.
+    struct FlatExpr
+    {
+        Expr_t   type;
+        uint32_t a = NO_NODE;
+        uint32_t b = NO_NODE;
+        uint32_t c = NO_NODE;
+    };
+    static_assert(sizeof(FlatExpr) == 16, "FlatExpr is expected to stay compact");
+
+    //   EXPR, RETURN   a = expression (NO_NODE if it failed to parse)
+    //   DECL           a = initialiser (NO_NODE without one), b = Symbol, c = Type_t::Value
+    //   IF             a = condition, b = then block, c = else block (NO_NODE without one)
+    struct FlatStmt
+    {
+        Stmt_t   type;
+        uint32_t a = NO_NODE;
+        uint32_t b = NO_NODE;
+        uint32_t c = NO_NODE;
+    };
+    static_assert(sizeof(FlatStmt) == 16, "FlatStmt is expected to stay compact");
+
+    // Statements [first, first + count) of stmt_lists
+    struct FlatBlock
+    {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    struct FlatParam
+    {
+        Symbol        name;
+        Type_t::Value type;
+    };
+
+    struct FlatFunction
+    {
+        Symbol        name;
+        Type_t::Value return_type;
+        uint32_t      first_param;  // Into params
+        uint32_t      num_params;
+        uint32_t      body;         // Into blocks
+    };
+
+    struct FlatString
+    {
+        uint32_t offset;            // Into chars
+        uint32_t length;
+    };
+
+    struct FlatAst
+    {
+        std::vector<FlatFunction> functions;    // In source order
+        std::vector<FlatParam>    params;
+        std::vector<FlatBlock>    blocks;
+        std::vector<FlatStmt>     stmts;
+        std::vector<FlatExpr>     exprs;
+
+        std::vector<NodeIndex>    stmt_lists;   // Statements of each block, in order
+        std::vector<NodeIndex>    expr_lists;   // Arguments of each call, in order
+
+        // Literal payloads
+        std::vector<int64_t>      ints;
+        std::vector<double>       floats;
+        std::vector<FlatString>   strings;
+        std::string               chars;
+
+        std::string_view string_at(uint32_t idx) const
+        {
+            return std::string_view(chars).substr(strings[idx].offset, strings[idx].length);
+        }
+        size_t memory_bytes() const;
+    };
+
+    // num_nodes, e.g. ParserState::num_nodes, is only used to size the arrays up front
+    FlatAst flatten(const Declaration* root, size_t num_nodes = 0);
+}
+
+#endif
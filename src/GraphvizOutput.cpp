@@ -1,3 +1,330 @@
 #include "GraphvizOutput.h"
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
+
+namespace
+{
+    using namespace ast;
+
+    // The node tree links lists through a `next` field and writes an item's
+    // edge to its successor only once the whole rest of the list is written.
+    // Here lists are arrays, so the items are written in a loop and the edges
+    // between them after, in reverse, which comes out the same.
+    struct GraphvizWriter
+    {
+        const FlatAst&    ast;
+        GraphvizDocument& doc;
+        char              buffer[1024];
+
+        std::vector<int>  pending_ids;  // Ids of list items waiting for their edges
+
+        void write(const char* fmt, ...) __attribute__((format(printf, 2, 3)))
+        {
+            va_list args;
+            va_start(args, fmt);
+            std::vsnprintf(buffer, sizeof(buffer), fmt, args);
+            va_end(args);
+            doc.oss << buffer;
+        }
+
+        void edge(const char* from, int from_id, const char* port, const char* to, int to_id)
+        {
+            doc.oss << "    " << from << from_id << ":<" << port << "> -> " << to << to_id << ";\n";
+        }
+
+        int identifier(Symbol sym)
+        {
+            int expr_id = doc.next_id();
+            write("    expr_%d[label=\"{%s|{<f1>lhs|<f2>rhs}}\"];\n", expr_id, std::string(Interner::global().name(sym)).c_str());
+            return expr_id;
+        }
+
+        // Writes the node's own line, and for a call its callee as well,
+        // everything else comes after its operands
+        int open(NodeIndex idx)
+        {
+            static const char* EXPR_FMT = "    expr_%d[label=\"{%s|{<f1>lhs|<f2>rhs}}\"];\n";
+
+            const FlatExpr& expr = ast.exprs[idx];
+            switch(expr.type)
+            {
+                case Expr_t::IDENTIFIER:
+                    return identifier(expr.a);
+                case Expr_t::INT_LITERAL:
+                {
+                    int expr_id = doc.next_id();
+                    write("    expr_%d[label=\"{%ld|{<f1>lhs|<f2>rhs}}\"];\n", expr_id, (long) ast.ints[expr.a]);
+                    return expr_id;
+                }
+                case Expr_t::FLOAT_LITERAL:
+                {
+                    int expr_id = doc.next_id();
+                    write("    expr_%d[label=\"{%.2f|{<f1>lhs|<f2>rhs}}\"];\n", expr_id, ast.floats[expr.a]);
+                    return expr_id;
+                }
+                case Expr_t::STRING_LITERAL:
+                {
+                    int expr_id = doc.next_id();
+                    write("    expr_%d[label=\"{\\\"%s\\\"|{<f1>lhs|<f2>rhs}}\"];\n", expr_id, std::string(ast.string_at(expr.a)).c_str());
+                    return expr_id;
+                }
+                case Expr_t::CALL:
+                {
+                    int call_id = doc.next_id();
+                    write(EXPR_FMT, call_id, "\\<call\\>");
+
+                    int callee_id = identifier(expr.a);
+                    edge("expr_", call_id, "f1", "expr_", callee_id);
+                    return call_id;
+                }
+                default:
+                    break;
+            }
+
+            const char* lexeme = "op";
+            switch(expr.type)
+            {
+                case Expr_t::ADD    : lexeme = "+";    break;
+                case Expr_t::SUB    : lexeme = "-";    break;
+                case Expr_t::MUL    : lexeme = "*";    break;
+                case Expr_t::DIV    : lexeme = "/";    break;
+                case Expr_t::ASSIGN : lexeme = "=";    break;
+                case Expr_t::COMP_LT: lexeme = "\\<";  break;
+                default: break;
+            }
+            int expr_id = doc.next_id();
+            write(EXPR_FMT, expr_id, lexeme);
+            return expr_id;
+        }
+
+        // An expression whose operands are being written
+        struct Visit
+        {
+            NodeIndex idx;
+            int       id;
+            uint32_t  next;     // Operand to write next, an argument index for calls
+            size_t    mark;     // Calls: where their "<args>" ids start in pending_ids
+        };
+        std::vector<Visit> visits;
+
+        void visit(NodeIndex idx)
+        {
+            int id = open(idx);
+            visits.push_back({ idx, id, 0, pending_ids.size() });
+        }
+
+        // Depth-first over an explicit stack, operator chains can be as deep
+        // as the source makes them. Each operand's edge is written once the
+        // operand itself is, as the node tree does.
+        int expression(NodeIndex root)
+        {
+            visit(root);
+            int done_id = -1;   // The operand that was just finished
+            while(true)
+            {
+                Visit&          top  = visits.back();
+                const FlatExpr& expr = ast.exprs[top.idx];
+                NodeIndex       operand = NO_NODE;
+
+                if(expr.type == Expr_t::CALL)
+                {
+                    // Each argument hangs off an "<args>" node like the ARG chain it came from
+                    if(done_id >= 0)
+                        edge("expr_", pending_ids.back(), "f1", "expr_", done_id);
+                    while(operand == NO_NODE && top.next < expr.c)
+                    {
+                        int arg_id = doc.next_id();
+                        write("    expr_%d[label=\"{%s|{<f1>lhs|<f2>rhs}}\"];\n", arg_id, "\\<args\\>");
+                        pending_ids.push_back(arg_id);
+                        operand = ast.expr_lists[expr.b + top.next++];
+                    }
+                    if(operand == NO_NODE && expr.c > 0)
+                    {
+                        for(size_t i = pending_ids.size(); i > top.mark + 1; i--)
+                            edge("expr_", pending_ids[i - 2], "f2", "expr_", pending_ids[i - 1]);
+                        edge("expr_", top.id, "f2", "expr_", pending_ids[top.mark]);
+                        pending_ids.resize(top.mark);
+                    }
+                }
+                else if(expr.type != Expr_t::IDENTIFIER    && expr.type != Expr_t::INT_LITERAL &&
+                        expr.type != Expr_t::FLOAT_LITERAL && expr.type != Expr_t::STRING_LITERAL)
+                {
+                    if(done_id >= 0)
+                        edge("expr_", top.id, top.next == 1 ? "f1" : "f2", "expr_", done_id);
+                    while(operand == NO_NODE && top.next < 2)
+                        operand = top.next++ == 0 ? expr.a : expr.b;
+                }
+
+                if(operand != NO_NODE)
+                {
+                    done_id = -1;
+                    visit(operand);
+                    continue;
+                }
+                done_id = top.id;
+                visits.pop_back();
+                if(visits.empty())
+                    return done_id;
+            }
+        }
+
+        // Everything but ifs, those are written by block()
+        int statement(NodeIndex idx)
+        {
+            const FlatStmt& stmt = ast.stmts[idx];
+            if(stmt.type == Stmt_t::DECL)
+            {
+                int stmt_id = doc.next_id();
+
+                int decl_id = doc.next_id();
+                write("    decl_%d[label=\"{%s|{<f1>type|<f2>expr}}\"];\n", decl_id, std::string(Interner::global().name(stmt.b)).c_str());
+                int type_id = doc.next_id();
+                write("    str_%d[label=\"{%s}\"];\n", type_id, Type_t((Type_t::Value) stmt.c).to_string().c_str());
+                edge("decl_", decl_id, "f1", "str_", type_id);
+                if(stmt.a != NO_NODE)
+                    edge("decl_", decl_id, "f2", "expr_", expression(stmt.a));
+
+                write("    stmt_%d[label=\"{VarDeclStatement|{<f1>decl|<f2>next}}\"]\n", stmt_id);
+                edge("stmt_", stmt_id, "f1", "decl_", decl_id);
+                return stmt_id;
+            }
+
+            int stmt_id = doc.next_id();
+            write("    stmt_%d[label=\"{%s|{<f1>expr|<f2>next}}\"];\n", stmt_id,
+                  stmt.type == Stmt_t::RETURN ? "ReturnStatement" : "ExprStatement");
+            if(stmt.a != NO_NODE)
+                edge("stmt_", stmt_id, "f1", "expr_", expression(stmt.a));
+            return stmt_id;
+        }
+
+        // A block whose statements are being written, or an if whose blocks are
+        struct Nested
+        {
+            NodeIndex idx;      // Into blocks, or into stmts for an if
+            int       id;       // Ifs: their own
+            uint32_t  next;     // Blocks: statement to write next. Ifs: 0 then, 1 else, 2 done
+            size_t    mark;     // Blocks: where their statement ids start in pending_ids
+            bool      is_if;
+        };
+        std::vector<Nested> nested;
+
+        void open_if(NodeIndex idx)
+        {
+            const FlatStmt& stmt = ast.stmts[idx];
+            int if_id = doc.next_id();
+            write("    stmt_%d[label=\"{IfStatement|{<f1>condition|<f2>then|<f3>else|<f4>next}}\"];\n", if_id);
+            if(stmt.a != NO_NODE)
+                edge("stmt_", if_id, "f1", "expr_", expression(stmt.a));
+            nested.push_back({ idx, if_id, 0, 0, true });
+        }
+
+        int close_block(const Nested& top)
+        {
+            const FlatBlock& block = ast.blocks[top.idx];
+            for(size_t i = pending_ids.size(); i > top.mark + 1; i--)
+            {
+                NodeIndex   prev = ast.stmt_lists[block.first + (i - 2 - top.mark)];
+                const char* port = ast.stmts[prev].type == Stmt_t::IF ? "f4" : "f2";
+                edge("stmt_", pending_ids[i - 2], port, "stmt_", pending_ids[i - 1]);
+            }
+
+            int first_id = pending_ids[top.mark];
+            pending_ids.resize(top.mark);
+            return first_id;
+        }
+
+        // Depth-first over an explicit stack like expression(), ifs nest as
+        // deep as the source makes them. An if's blocks are written after its
+        // condition, and each edge once the block it points at is.
+        int block(NodeIndex root)
+        {
+            size_t base = nested.size();
+            nested.push_back({ root, -1, 0, pending_ids.size(), false });
+            while(true)
+            {
+                Nested& top = nested.back();
+                if(!top.is_if && top.next < ast.blocks[top.idx].count)
+                {
+                    NodeIndex stmt_idx = ast.stmt_lists[ast.blocks[top.idx].first + top.next++];
+                    if(ast.stmts[stmt_idx].type == Stmt_t::IF)
+                        open_if(stmt_idx);
+                    else
+                        pending_ids.push_back(statement(stmt_idx));
+                    continue;
+                }
+                if(top.is_if && top.next < 2)
+                {
+                    const FlatStmt& stmt   = ast.stmts[top.idx];
+                    NodeIndex       branch = top.next++ == 0 ? stmt.b : stmt.c;
+                    if(branch != NO_NODE)
+                        nested.push_back({ branch, -1, 0, pending_ids.size(), false });
+                    continue;
+                }
+
+                int done_id = top.is_if ? top.id : close_block(top);
+                nested.pop_back();
+                if(nested.size() == base)
+                    return done_id;
+
+                Nested& parent = nested.back();
+                if(parent.is_if)
+                    edge("stmt_", parent.id, parent.next == 1 ? "f2" : "f3", "stmt_", done_id);
+                else
+                    pending_ids.push_back(done_id);
+            }
+        }
+
+        int function(const FlatFunction& func)
+        {
+            int decl_id = doc.next_id();
+            write("    decl_%d[label=\"{FunctionDecl | {<f1>name |<f2> params|<f3> ret_type|<f4> body|<f5>next}}\"];\n", decl_id);
+            int name_id = doc.next_id();
+            write("    str_%d[label=\"{\\\"%s\\\"}\"];\n", name_id, std::string(Interner::global().name(func.name)).c_str());
+            int ret_type_id = doc.next_id();
+            write("    str_%d[label=\"{%s}\"];\n", ret_type_id, Type_t(func.return_type).to_string().c_str());
+
+            edge("decl_", decl_id, "f1", "str_", name_id);
+            edge("decl_", decl_id, "f3", "str_", ret_type_id);
+
+            if(func.num_params > 0)
+            {
+                size_t mark = pending_ids.size();
+                for(uint32_t i = 0; i < func.num_params; i++)
+                {
+                    const FlatParam& param = ast.params[func.first_param + i];
+
+                    int param_id = doc.next_id();
+                    write("    param_%d[label=\"{ParameterNode|{<f1>name|<f2>type|<f3>next}}\"];\n", param_id);
+                    int param_name_id = doc.next_id();
+                    write("    str_%d[label=\"{\\\"%s\\\"}\"];\n", param_name_id, std::string(Interner::global().name(param.name)).c_str());
+                    int type_id = doc.next_id();
+                    write("    str_%d[label=\"{%s}\"];\n", type_id, Type_t(param.type).to_string().c_str());
+
+                    edge("param_", param_id, "f1", "str_", param_name_id);
+                    edge("param_", param_id, "f2", "str_", type_id);
+                    pending_ids.push_back(param_id);
+                }
+                for(size_t i = pending_ids.size(); i > mark + 1; i--)
+                    edge("param_", pending_ids[i - 2], "f3", "param_", pending_ids[i - 1]);
+
+                edge("decl_", decl_id, "f2", "param_", pending_ids[mark]);
+                pending_ids.resize(mark);
+            }
+            if(func.body != NO_NODE)
+                edge("decl_", decl_id, "f4", "stmt_", block(func.body));
+            return decl_id;
+        }
+    };
+}
+
+void output_graphviz(const ast::FlatAst& ast, GraphvizDocument& doc)
+{
+    GraphvizWriter writer { ast, doc, {}, {}, {}, {} };
+
+    std::vector<int> decl_ids;
+    for(const ast::FlatFunction& func : ast.functions)
+        decl_ids.push_back(writer.function(func));
+    for(size_t i = decl_ids.size(); i > 1; i--)
+        writer.edge("decl_", decl_ids[i - 2], "f5", "decl_", decl_ids[i - 1]);
+}
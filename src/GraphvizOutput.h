@@ -3,5 +3,10 @@
 
 #include "Declaration.h"
 #include "Statement.h"
+#include "FlatAst.h"
 #include <sstream>
+
+// Writes the declarations of `ast` to `doc` as a Graphviz record per node
+void output_graphviz(const ast::FlatAst& ast, GraphvizDocument& doc);
+
 #endif
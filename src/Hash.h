@@ -0,0 +1,57 @@
+#pragma once
+#ifndef LANG_HASH_H
+#define LANG_HASH_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+// Small, fast, non-cryptographic 64-bit hash. Good enough for hash tables
+// and for telling whether a chunk of source or tokens changed; not meant to
+// withstand anyone crafting collisions.
+namespace hash
+{
+    constexpr uint64_t SEED = 0x9E3779B97F4A7C15ull;
+
+    inline uint64_t mix(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    inline uint64_t combine(uint64_t h, uint64_t value)
+    {
+        return mix(h ^ (value + SEED + (h << 6) + (h >> 2)));
+    }
+
+    inline uint64_t bytes(const void* data, size_t len, uint64_t h = SEED)
+    {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        h ^= len * 0x9DDFEA08EB382D69ull;
+
+        while(len >= 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, p, 8);
+            h = (h ^ (word * 0x87C37B91114253D5ull)) * 0x4CF5AD432745937Full;
+            h = (h << 31) | (h >> 33);
+            p += 8; len -= 8;
+        }
+
+        uint64_t tail = 0;
+        std::memcpy(&tail, p, len);
+        return mix(h ^ tail);
+    }
+
+    inline uint64_t string(std::string_view s, uint64_t h = SEED)
+    {
+        return bytes(s.data(), s.size(), h);
+    }
+}
+
+#endif
@@ -0,0 +1,303 @@
+#include "IncrementalLexer.h"
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    // Bytes lexed past the end of the edit before looking for a resync,
+    // doubled every time a window goes by without one
+    const size_t FIRST_WINDOW_SIZE = 1024;
+
+    // Room for new tokens the gap gets at least, whenever it has to grow
+    const size_t MIN_GAP_SIZE = 256;
+
+    // String literals are stored without their quotes
+    size_t token_begin(const Token& token)
+    {
+        return token.offset - (token.type == TOKEN_STR_LITERAL ? 1 : 0);
+    }
+    size_t token_end(const Token& token, size_t input_len)
+    {
+        size_t end = token.offset + token.length + (token.type == TOKEN_STR_LITERAL ? 1 : 0);
+        return std::min(end, input_len);
+    }
+
+    size_t start_of_line(const char* data, size_t pos)
+    {
+        while(pos > 0 && data[pos - 1] != '\n')
+            pos--;
+        return pos;
+    }
+
+    // One past the first newline at or after pos
+    size_t end_of_line(const char* data, size_t pos, size_t input_len)
+    {
+        if(pos >= input_len)
+            return input_len;
+        const void* newline = memchr(data + pos, '\n', input_len - pos);
+        return newline ? static_cast<const char*>(newline) - data + 1 : input_len;
+    }
+
+    uint16_t column(size_t offset, size_t line_start)
+    {
+        return static_cast<uint16_t>(std::min<size_t>(offset - line_start + 1, UINT16_MAX));
+    }
+
+    // First index in [lo, hi) whose token doesn't satisfy `pred`, which has
+    // to hold for all the tokens before it and none after
+    template<typename Pred>
+    size_t partition_point(const IncrementalLexer& lexer, size_t lo, size_t hi, Pred pred)
+    {
+        while(lo < hi)
+        {
+            size_t mid = lo + (hi - lo) / 2;
+            if(pred(lexer.token(mid)))
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+}
+
+void apply_edit(std::string& source, const TextEdit& edit)
+{
+    source.replace(edit.offset, edit.removed_length, edit.inserted_text.data(), edit.inserted_text.size());
+}
+
+// Past the gap offset and line_number are stored as distances back from
+// input_len and last_line. Going from one to the other is the same
+// subtraction either way.
+Token IncrementalLexer::token(size_t idx) const
+{
+    if(idx < gap_begin)
+        return buffer[idx];
+    Token token       = buffer[idx + (gap_end - gap_begin)];
+    token.offset      = static_cast<uint32_t>(lexer.input_len - token.offset);
+    token.line_number = static_cast<uint32_t>(last_line - token.line_number);
+    return token;
+}
+
+void IncrementalLexer::move_gap(size_t idx)
+{
+    auto flip = [this](Token token)
+    {
+        token.offset      = static_cast<uint32_t>(lexer.input_len - token.offset);
+        token.line_number = static_cast<uint32_t>(last_line - token.line_number);
+        return token;
+    };
+    while(gap_begin > idx)
+        buffer[--gap_end] = flip(buffer[--gap_begin]);
+    while(gap_begin < idx)
+        buffer[gap_begin++] = flip(buffer[gap_end++]);
+}
+
+void IncrementalLexer::insert_at_gap(const Token* tokens, size_t count)
+{
+    // Doubles the buffer when it's too small, so the copying averages out
+    // to a constant per token inserted
+    if(gap_end - gap_begin < count)
+    {
+        size_t tail = buffer.size() - gap_end;
+        size_t gap  = std::max({ count, buffer.size(), MIN_GAP_SIZE });
+        std::vector<Token> grown(gap_begin + gap + tail);
+        std::copy(buffer.begin(), buffer.begin() + gap_begin, grown.begin());
+        std::copy(buffer.begin() + gap_end, buffer.end(), grown.end() - tail);
+        buffer  = std::move(grown);
+        gap_end = gap_begin + gap;
+    }
+    std::copy(tokens, tokens + count, buffer.begin() + gap_begin);
+    gap_begin += count;
+}
+
+size_t IncrementalLexer::tokenize(std::string_view source)
+{
+    lexer.input_string = source;
+    lexer.input_len    = source.size();
+    lexer.print_errors = print_errors;
+    size_t status = lexer.tokenize_string();
+
+    // All of them go in front of the gap, the first edit moves it
+    buffer.swap(lexer.tokens);
+    lexer.tokens.clear();
+    gap_begin = gap_end = buffer.size();
+    last_line = buffer.back().line_number;
+    return status;
+}
+
+size_t IncrementalLexer::retokenize_edit(std::string_view edited_source, const TextEdit& edit, TokenSplice* splice)
+{
+    const size_t old_len = lexer.input_len;
+    const size_t new_len = edited_source.size();
+    const char*  data    = edited_source.data();
+
+    if(buffer.empty())
+    {
+        size_t status = tokenize(edited_source);
+        if(splice)
+            *splice = { 0, 0, num_tokens() };
+        return status;
+    }
+
+    assert(edit.offset + edit.removed_length <= old_len);
+    assert(new_len == old_len - edit.removed_length + edit.inserted_text.size());
+
+    const size_t  edit_end = edit.offset + edit.removed_length;
+    const int64_t delta    = (int64_t) new_len - (int64_t) old_len;
+
+    // The trailing EOF is never reused, it only says where lexing stopped
+    const size_t num_old = num_tokens() - 1;
+    const Token  old_eof = token(num_old);
+
+    // A token that ends right where the edit starts may still be extended by
+    // it, so the first one kept as is has to end strictly before
+    size_t first = partition_point(*this, 0, num_old, [&](const Token& token) {
+        return token_end(token, old_len) < edit.offset;
+    });
+
+    // Only tokens entirely past the edit can line up with new ones again
+    size_t old_idx = partition_point(*this, first, num_old, [&](const Token& token) {
+        return token_begin(token) < edit_end;
+    });
+
+    // Restart right after the last untouched token, in between tokens is the
+    // only state the lexer can be resumed from
+    size_t begin = 0, line = 1, line_start = 0;
+    if(first > 0)
+    {
+        const Token prev = token(first - 1);
+        begin      = token_end(prev, old_len);
+        line       = prev.line_number + std::count(data + prev.offset, data + begin, '\n');
+        line_start = start_of_line(data, begin);
+    }
+
+    // Everything that might change is past the gap from here on, where the
+    // edit doesn't move it
+    move_gap(first);
+
+    // Decoded strings go on the end of the same blocks as before
+    relexer.input_string       = edited_source;
+    relexer.escaped_blocks     = std::move(lexer.escaped_blocks);
+    relexer.escaped_block_used = lexer.escaped_block_used;
+    relexer.escaped_block_size = lexer.escaped_block_size;
+    relexer.tokens.clear();
+
+    // Lexes a window of whole lines at a time and checks the new tokens
+    // against the old ones, stopping at the first one found at the same
+    // shifted offset with the same type and length. From there on the lexer
+    // sees the same characters it did before, so every later token would
+    // come out the same too.
+    size_t window_size  = FIRST_WINDOW_SIZE;
+    size_t status       = LEX_SUCCESS;
+    bool   resynced     = false;
+    size_t num_new      = 0;
+    while(true)
+    {
+        size_t lex_from   = std::max(begin, edit.offset + edit.inserted_text.size());
+        size_t window_end = end_of_line(data, lex_from + window_size, new_len);
+        size_t scanned    = relexer.tokens.size();
+
+        relexer.input_len = window_end;
+        status = relexer.tokenize_range(begin, line, line_start);
+
+        bool reached_end = (window_end == new_len || status != LEX_SUCCESS);
+        begin      = window_end;
+        line       = relexer.curr_line_number;
+        line_start = relexer.line_start_idx;
+
+        // Only a string literal can run past the end of a line, when one is
+        // cut off by the window resume from its opening quote instead
+        if(!reached_end && relexer.tokens.size() > scanned)
+        {
+            const Token& last = relexer.tokens.back();
+            if(last.type == TOKEN_STR_LITERAL && last.offset + last.length >= window_end)
+            {
+                begin      = token_begin(last);
+                line       = last.line_number;
+                line_start = start_of_line(data, begin);
+                relexer.tokens.pop_back();
+                window_size *= 2;
+            }
+        }
+
+        for(num_new = scanned; num_new < relexer.tokens.size() && old_idx < num_old; num_new++)
+        {
+            const Token& new_token = relexer.tokens[num_new];
+            Token        old_token = token(old_idx);
+            while(old_token.offset + delta < new_token.offset && ++old_idx < num_old)
+                old_token = token(old_idx);
+
+            if(old_idx < num_old && old_token.offset + delta == new_token.offset &&
+               old_token.type == new_token.type && old_token.length == new_token.length)
+            {
+                resynced = true;
+                break;
+            }
+        }
+        if(resynced || reached_end)
+            break;
+        window_size *= 2;
+    }
+
+    lexer.escaped_blocks     = std::move(relexer.escaped_blocks);
+    lexer.escaped_block_used = relexer.escaped_block_used;
+    lexer.escaped_block_size = relexer.escaped_block_size;
+
+    size_t num_removed;
+    if(resynced)
+    {
+        // What's left of the old stream stays put: it counts back from the
+        // end of the source and its last line, which the edit moved along
+        // with it
+        const Token&  sync_token = relexer.tokens[num_new];
+        const int64_t line_delta = (int64_t) sync_token.line_number - token(old_idx).line_number;
+        num_removed = old_idx - first;
+        gap_end    += num_removed;
+        last_line   = static_cast<size_t>((int64_t) last_line + line_delta);
+        lexer.input_string = edited_source;
+        lexer.input_len    = new_len;
+
+        // Only the tokens on the line the streams resynced on move sideways
+        const uint32_t sync_line      = buffer[gap_end].line_number;
+        const size_t   new_line_start = start_of_line(data, sync_token.offset);
+        for(size_t i = gap_end; i < buffer.size() && buffer[i].line_number == sync_line; i++)
+            buffer[i].pos_in_line = column(new_len - buffer[i].offset, new_line_start);
+
+        insert_at_gap(relexer.tokens.data(), num_new);
+
+        // An error past the resync point is still there, just shifted
+        const Token eof = token(num_tokens() - 1);
+        status = (old_eof.offset < old_len) ? lexer.error : LEX_SUCCESS;
+        lexer.curr_ch_idx      = eof.offset;
+        lexer.curr_char        = eof.offset < new_len ? data[eof.offset] : '\0';
+        lexer.curr_line_number = eof.line_number;
+        lexer.line_start_idx   = start_of_line(data, eof.offset);
+    }
+    else
+    {
+        relexer.insert_token(TOKEN_EOF, std::min(relexer.curr_ch_idx, new_len), 0);
+        num_new     = relexer.tokens.size();
+        num_removed = num_old + 1 - first;
+        gap_end     = buffer.size();
+        last_line   = relexer.tokens.back().line_number;
+        lexer.input_string = edited_source;
+        lexer.input_len    = new_len;
+
+        insert_at_gap(relexer.tokens.data(), num_new);
+
+        lexer.curr_ch_idx      = relexer.curr_ch_idx;
+        lexer.curr_char        = relexer.curr_char;
+        lexer.curr_line_number = relexer.curr_line_number;
+        lexer.line_start_idx   = relexer.line_start_idx;
+        lexer.error            = relexer.error;
+    }
+
+    if(splice)
+        *splice = { first, num_removed, num_new };
+    if(status != LEX_SUCCESS && print_errors)
+        lexer.print_error();
+    return status;
+}
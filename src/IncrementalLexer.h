@@ -0,0 +1,77 @@
+#pragma once
+#ifndef LANG_INCREMENTAL_LEXER_H
+#define LANG_INCREMENTAL_LEXER_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Lexer.h"
+
+// Replaces removed_length bytes at offset with inserted_text
+struct TextEdit
+{
+    size_t           offset;
+    size_t           removed_length;
+    std::string_view inserted_text;
+};
+
+// Where the token stream changed: tokens [first, first + num_removed) of the
+// old stream were replaced by [first, first + num_inserted) in the new one,
+// everything after that is the same tokens shifted
+struct TokenSplice
+{
+    size_t first        = 0;
+    size_t num_removed  = 0;
+    size_t num_inserted = 0;
+};
+
+void apply_edit(std::string& source, const TextEdit& edit);
+
+// Token stream of a source that keeps being edited. The tokens sit in a gap
+// buffer with the gap where the last edit was. The ones before it are
+// stored as usual, the ones after it by how far they are from the end of
+// the source and its last line, which no edit in front of them changes.
+// So an edit only writes the tokens it lexes again, plus the ones between
+// it and the previous edit that the gap moves over, however long the
+// source is.
+class IncrementalLexer
+{
+    public:
+        // Lexes all of `source` like tokenize_string(), which has to outlive
+        // the tokens as it does there
+        size_t tokenize(std::string_view source);
+
+        // Brings the tokens up to date with `edited_source`, which is the
+        // current source with `edit` applied. Lexing restarts at the last
+        // token before the edit and stops as soon as the new tokens line up
+        // with old ones again, the ones after that stay where they are. The
+        // result is the same stream tokenize_string() would give for
+        // edited_source, error included.
+        //
+        // Decoded strings of tokens that were dropped stay allocated until
+        // the next tokenize().
+        size_t retokenize_edit(std::string_view edited_source, const TextEdit& edit, TokenSplice* splice = nullptr);
+
+        size_t num_tokens() const { return buffer.size() - (gap_end - gap_begin); }   // TOKEN_EOF included
+        Token  token(size_t idx) const;                                             // Positioned in the current source
+
+        // The current source, its decoded strings and where lexing stopped,
+        // for lexeme() and print_error(). Its own `tokens` are always empty.
+        const LexerState& state() const { return lexer; }
+
+        bool print_errors = true;   // Whether a failure is reported on stdout
+    private:
+        void move_gap(size_t idx);
+        void insert_at_gap(const Token* tokens, size_t count);
+
+        LexerState         lexer;
+        LexerState         relexer;     // Kept for its buffer, only used during retokenize_edit()
+        std::vector<Token> buffer;
+        size_t             gap_begin = 0;
+        size_t             gap_end   = 0;
+        size_t             last_line = 1;   // Line tokens past the gap count back from, at least that of TOKEN_EOF
+};
+
+#endif
@@ -0,0 +1,209 @@
+#include "IncrementalParser.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <string>
+
+#include "Hash.h"
+
+namespace ast
+{
+    namespace
+    {
+        // Roughly how much tree each token turns into, a declaration's arena
+        // starts out big enough that most need only the one block
+        const size_t BYTES_PER_TOKEN = 64;
+        const size_t MIN_ARENA_SIZE  = 1024;
+
+        // Tokens handed to the parser at a time, it reads at most one batch
+        // past the end of a declaration
+        const size_t BATCH_SIZE = 256;
+
+        struct StreamReader : TokenSource
+        {
+            StreamReader(const IncrementalLexer& lexer): lexer(lexer) { }
+
+            void next_batch(std::vector<Token>& window) override
+            {
+                size_t end = std::min(next + BATCH_SIZE, lexer.num_tokens());
+                for(; next < end; next++)
+                    window.push_back(lexer.token(next));
+            }
+
+            const IncrementalLexer& lexer;
+            size_t                  next = 0;
+        };
+
+        template<typename T>
+        void append(std::string& out, T value)
+        {
+            out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        // Everything the tree is built from, none of where it came from. Each
+        // token is written out in full so two ranges encode the same exactly
+        // when their tokens are the same.
+        void encode_tokens(const IncrementalLexer& lexer, size_t begin, size_t end, std::string& out)
+        {
+            out.clear();
+            for(size_t i = begin; i < end; i++)
+            {
+                const Token token = lexer.token(i);
+                append(out, (uint8_t) token.type);
+                switch(token.type)
+                {
+                    case TOKEN_IDENTIFIER    : append(out, token.symbol);    break;
+                    case TOKEN_INT_LITERAL   : append(out, token.int_value); break;
+                    case TOKEN_FLOAT_LITERAL : append(out, token.flt_value); break;
+                    case TOKEN_STR_LITERAL   :
+                    {
+                        std::string_view text = lexer.state().lexeme(token);
+                        append(out, (uint32_t) text.size());
+                        out.append(text);
+                    }
+                    break;
+                    default: break;
+                }
+            }
+        }
+    }
+
+    Declaration* IncrementalParser::parse(ParserState* parser, const IncrementalLexer& lexer, const TokenSplice* splice)
+    {
+        generation++;
+        reused = parsed = 0;
+        uncached.clear();
+
+        const size_t eof = lexer.num_tokens() - 1;
+        StreamReader reader(lexer);
+        parser->lexer = &lexer.state();
+        parser->attach_source(&reader);
+
+        // Only consulted when there's a splice to map positions through
+        std::vector<Placed> old_layout = std::move(layout);
+        layout.clear();
+        layout.reserve(old_layout.size());
+        size_t old_idx = 0;
+
+        std::string  encoded;
+        Declaration* root      = nullptr;
+        Declaration* last_decl = nullptr;
+        while(parser->curr_token < eof)
+        {
+            size_t          begin  = parser->curr_token;
+            size_t          end    = 0;
+            CachedDecl*     cached = nullptr;
+
+            // The declaration that started at the same place in the old
+            // stream, if the edit left all of its tokens alone
+            if(splice && !old_layout.empty())
+            {
+                size_t old_begin = begin;
+                if(begin >= splice->first + splice->num_inserted)
+                    old_begin = begin - splice->num_inserted + splice->num_removed;
+                else if(begin >= splice->first)
+                    old_begin = SIZE_MAX;
+
+                while(old_idx < old_layout.size() && old_layout[old_idx].begin < old_begin)
+                    old_idx++;
+                if(old_idx < old_layout.size() && old_layout[old_idx].begin == old_begin)
+                {
+                    const Placed& placed = old_layout[old_idx];
+                    bool untouched = placed.end <= splice->first || placed.begin >= splice->first + splice->num_removed;
+                    if(untouched && placed.cached && placed.cached->generation != generation)
+                    {
+                        cached = placed.cached;
+                        end    = begin + (placed.end - placed.begin);
+                    }
+                }
+            }
+
+            uint64_t key = 0;
+            if(cached == nullptr)
+            {
+                end = find_declaration_end([&lexer](size_t i) { return lexer.token(i); }, begin, eof);
+                encode_tokens(lexer, begin, end, encoded);
+                key = hash::string(encoded);
+
+                // The hash only narrows it down, the tokens have to match
+                auto matches = cache.equal_range(key);
+                for(auto it = matches.first; it != matches.second && !cached; ++it)
+                    if(it->second.generation != generation && it->second.tokens == encoded)
+                        cached = &it->second;
+            }
+
+            Declaration* decl = nullptr;
+            if(cached)
+            {
+                // Skip over it as if it had just been parsed
+                cached->generation       = generation;
+                decl                     = cached->decl;
+                parser->num_nodes       += cached->num_nodes;
+                parser->curr_token       = end;
+                parser->consumed_upto    = end;
+                parser->curr_line_idx    = lexer.token(end - 1).line_number;
+                parser->curr_pos_in_line = lexer.token(end - 1).pos_in_line;
+                reused++;
+            }
+            else
+            {
+                // Skipping declarations can leave the parser's window behind
+                if(begin >= parser->window_begin + parser->window.size())
+                {
+                    reader.next = begin;
+                    parser->attach_source(&reader, begin);
+                }
+
+                auto   arena      = std::make_unique<Arena>(std::max((end - begin) * BYTES_PER_TOKEN, MIN_ARENA_SIZE));
+                size_t num_errors = parser->errors.size();
+                size_t num_nodes  = parser->num_nodes;
+
+                parser->arena = arena.get();
+                decl = parse_declaration(parser);
+                parser->arena = nullptr;
+                parsed++;
+
+                // Same as parse_program(), nothing after a failed declaration counts
+                if(decl == nullptr)
+                    break;
+
+                if(parser->errors.size() == num_errors && parser->curr_token == end)
+                {
+                    auto it = cache.emplace(key, CachedDecl { std::move(arena), key, std::move(encoded), decl, parser->num_nodes - num_nodes, generation });
+                    cached  = &it->second;
+                }
+                else
+                    uncached.push_back(std::move(arena));
+                parser->discard_consumed();
+            }
+            layout.push_back({ begin, parser->curr_token, cached });
+
+            if(root == nullptr)
+                root = decl;
+            else
+                last_decl->set_next(decl);
+            last_decl = decl;
+        }
+        if(last_decl)
+            last_decl->set_next(nullptr);
+        parser->source = nullptr;     // The reader goes away with this call
+
+        // Whatever this parse didn't use is gone from the source. Every entry
+        // was placed by the last parse, so that's where to look for them.
+        for(const Placed& placed : old_layout)
+        {
+            if(placed.cached == nullptr || placed.cached->generation == generation)
+                continue;
+            auto matches = cache.equal_range(placed.cached->key);
+            for(auto it = matches.first; it != matches.second; ++it)
+            {
+                if(&it->second == placed.cached)
+                {
+                    cache.erase(it);
+                    break;
+                }
+            }
+        }
+        return root;
+    }
+}
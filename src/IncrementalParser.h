@@ -0,0 +1,80 @@
+#pragma once
+#ifndef LANG_INCREMENTAL_PARSER_H
+#define LANG_INCREMENTAL_PARSER_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Declaration.h"
+#include "IncrementalLexer.h"
+
+namespace ast
+{
+    // Parses a program again and again as it's edited, reusing the tree of
+    // every top-level declaration whose tokens haven't changed since the
+    // last parse. Declarations are told apart by their tokens' types and
+    // values, not their positions, so one that merely moved still counts as
+    // unchanged. They're looked up by a hash of those, but a hit only counts
+    // if the tokens themselves are equal too. The trees don't record positions either, so a
+    // reused one is exactly what parsing it again would build.
+    //
+    // Finding and hashing every declaration is still a pass over all the
+    // tokens. Given the TokenSplice retokenize_edit() reported, declarations
+    // clear of the edit are taken over by position instead, and only the
+    // ones it touched are looked at at all. The parser reads those straight
+    // from the IncrementalLexer's gap buffer, a batch at a time.
+    //
+    // Each declaration gets its own small arena, which is freed once a parse
+    // no longer uses that declaration.
+    class IncrementalParser
+    {
+        public:
+            // Does what parse_program() does over the tokens of `lexer`:
+            // parser->errors, status and num_nodes come out the same. The
+            // parser is pointed at the lexer here, it only needs to be
+            // fresh. The returned chain is owned by this object and stays
+            // valid until the next call. `splice`, if given, has to describe
+            // the only edit since the last call.
+            Declaration* parse(ParserState* parser, const IncrementalLexer& lexer, const TokenSplice* splice = nullptr);
+
+            size_t num_reused() const { return reused; }   // By the last parse
+            size_t num_parsed() const { return parsed; }
+        private:
+            struct CachedDecl
+            {
+                std::unique_ptr<Arena> arena;
+                uint64_t     key;
+                std::string  tokens;            // What key is the hash of, see encode_tokens()
+                Declaration* decl      = nullptr;
+                size_t       num_nodes = 0;
+                uint64_t     generation = 0;    // Last parse that used it
+            };
+
+            // Declarations that parsed without errors, keyed by hash. The same
+            // text can occur more than once, each copy needs its own tree.
+            // Everything in it was used by the last parse.
+            std::unordered_multimap<uint64_t, CachedDecl> cache;
+            // Trees in use that can't be reused, because parsing them reported
+            // errors whose positions would go stale
+            std::vector<std::unique_ptr<Arena>> uncached;
+
+            // Where each declaration of the last parse was in the token stream
+            struct Placed
+            {
+                size_t      begin;
+                size_t      end;
+                CachedDecl* cached;     // nullptr when it isn't in the cache
+            };
+            std::vector<Placed> layout;
+
+            uint64_t generation = 0;
+            size_t   reused     = 0;
+            size_t   parsed     = 0;
+    };
+}
+
+#endif
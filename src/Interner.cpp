@@ -0,0 +1,132 @@
+#include "Interner.h"
+#include "Hash.h"
+
+#include <string.h>
+#include <algorithm>
+
+Interner& Interner::global()
+{
+    static Interner instance;
+    return instance;
+}
+
+Interner::Interner()
+{
+    well_known.int_type   = intern("int");
+    well_known.float_type = intern("float");
+    well_known.print      = intern("print");
+}
+
+Interner::~Interner()
+{
+    for(Shard& shard : shards)
+        for(auto& page : shard.pages)
+            delete[] page.load(std::memory_order_relaxed);
+}
+
+static unsigned floor_log2(uint32_t value)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long idx;
+    _BitScanReverse(&idx, value);
+    return (unsigned) idx;
+#else
+    return 31u - (unsigned) __builtin_clz(value);
+#endif
+}
+
+void Interner::locate(uint32_t local_idx, unsigned& page, uint32_t& offset)
+{
+    const uint32_t first_page = 1u << FIRST_PAGE_BITS;
+    page   = floor_log2(local_idx + first_page) - FIRST_PAGE_BITS;
+    offset = local_idx + first_page - (first_page << page);
+}
+
+std::string_view Interner::name(Symbol sym) const
+{
+    const Shard& shard = shards[sym & (NUM_SHARDS - 1)];
+    unsigned page;
+    uint32_t offset;
+    locate(sym >> SHARD_BITS, page, offset);
+    return shard.pages[page].load(std::memory_order_acquire)[offset];
+}
+
+Symbol Interner::intern(std::string_view text)
+{
+    const uint64_t hash      = hash::string(text);
+    const unsigned shard_idx = (unsigned) (hash >> 60) & (NUM_SHARDS - 1);
+    Shard& shard = shards[shard_idx];
+
+    std::lock_guard<std::mutex> guard(shard.lock);
+    if(!shard.table.empty())
+    {
+        const size_t mask = shard.table.size() - 1;
+        for(size_t i = (size_t) hash & mask; shard.table[i].sym != NO_SYMBOL; i = (i + 1) & mask)
+        {
+            const Slot& slot = shard.table[i];
+            if(slot.hash == hash && name(slot.sym) == text)
+                return slot.sym;
+        }
+    }
+    return insert(shard, shard_idx, text, hash);
+}
+
+Symbol Interner::insert(Shard& shard, unsigned shard_idx, std::string_view text, uint64_t hash)
+{
+    if((shard.num_names + 1) * 2 > shard.table.size())
+        grow_table(shard);
+
+    unsigned page;
+    uint32_t offset;
+    uint32_t local_idx = shard.num_names++;
+    locate(local_idx, page, offset);
+
+    std::string_view* names = shard.pages[page].load(std::memory_order_relaxed);
+    if(names == nullptr)
+    {
+        names = new std::string_view[(size_t) 1 << (FIRST_PAGE_BITS + page)];
+        shard.pages[page].store(names, std::memory_order_release);
+    }
+    names[offset] = std::string_view(store_chars(shard, text), text.size());
+
+    const Symbol sym  = (local_idx << SHARD_BITS) | shard_idx;
+    const size_t mask = shard.table.size() - 1;
+    size_t i = (size_t) hash & mask;
+    while(shard.table[i].sym != NO_SYMBOL)
+        i = (i + 1) & mask;
+    shard.table[i] = { hash, sym };
+
+    count.fetch_add(1, std::memory_order_relaxed);
+    return sym;
+}
+
+void Interner::grow_table(Shard& shard)
+{
+    std::vector<Slot> old_table = std::move(shard.table);
+    shard.table.assign(std::max<size_t>(64, old_table.size() * 2), Slot { 0, NO_SYMBOL });
+
+    const size_t mask = shard.table.size() - 1;
+    for(const Slot& slot : old_table)
+    {
+        if(slot.sym == NO_SYMBOL)
+            continue;
+        size_t i = (size_t) slot.hash & mask;
+        while(shard.table[i].sym != NO_SYMBOL)
+            i = (i + 1) & mask;
+        shard.table[i] = slot;
+    }
+}
+
+const char* Interner::store_chars(Shard& shard, std::string_view text)
+{
+    if(shard.block_used + text.size() > shard.block_size)
+    {
+        shard.block_size = std::max<size_t>(text.size(), 16 * 1024);
+        shard.block_used = 0;
+        shard.blocks.emplace_back(new char[shard.block_size]);
+    }
+    char* chars = shard.blocks.back().get() + shard.block_used;
+    memcpy(chars, text.data(), text.size());
+    shard.block_used += text.size();
+    return chars;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#ifndef LANG_INTERNER_H
+#define LANG_INTERNER_H
+
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// Identifiers are interned once, at lex time, and referred to by a 32-bit
+// Symbol from then on, so names compare and hash as plain integers.
+using Symbol = uint32_t;
+constexpr Symbol NO_SYMBOL = UINT32_MAX;
+
+// Process-wide table of interned strings. Interning locks one of a number of
+// shards picked by the string's hash, so threads lexing different files (or
+// different chunks of one) rarely contend. Looking a symbol's name up never
+// locks: names live in pages that never move once published.
+class Interner
+{
+    public:
+        static Interner& global();
+
+        Symbol           intern(std::string_view text);
+        std::string_view name(Symbol sym) const;
+        size_t           size() const { return count.load(std::memory_order_relaxed); }
+
+        // Names the front end itself needs to recognise
+        struct WellKnown
+        {
+            Symbol int_type;
+            Symbol float_type;
+            Symbol print;
+        };
+        const WellKnown& known() const { return well_known; }
+
+        Interner();
+        Interner(const Interner&) = delete;
+        Interner& operator=(const Interner&) = delete;
+        ~Interner();
+    private:
+        static constexpr unsigned SHARD_BITS = 4;
+        static constexpr unsigned NUM_SHARDS = 1u << SHARD_BITS;
+
+        // Each shard's names are kept in pages that double in size, page k
+        // holding FIRST_PAGE << k names, so small programs stay small
+        static constexpr unsigned FIRST_PAGE_BITS = 8;
+        static constexpr unsigned MAX_PAGES       = 32 - SHARD_BITS - FIRST_PAGE_BITS;
+
+        struct Slot
+        {
+            uint64_t hash;
+            Symbol   sym;
+        };
+
+        struct Shard
+        {
+            std::mutex lock;
+
+            // Open addressing, NO_SYMBOL marks an empty slot
+            std::vector<Slot> table;
+            uint32_t          num_names = 0;
+
+            std::array<std::atomic<std::string_view*>, MAX_PAGES> pages = {};
+
+            // Backing storage for the characters of the names
+            std::vector<std::unique_ptr<char[]>> blocks;
+            size_t block_used = 0;
+            size_t block_size = 0;
+        };
+
+        static void locate(uint32_t local_idx, unsigned& page, uint32_t& offset);
+
+        Symbol insert(Shard& shard, unsigned shard_idx, std::string_view text, uint64_t hash);
+        const char* store_chars(Shard& shard, std::string_view text);
+        void grow_table(Shard& shard);
+
+        std::array<Shard, NUM_SHARDS> shards;
+        std::atomic<size_t> count { 0 };
+        WellKnown well_known;
+};
+
+#endif
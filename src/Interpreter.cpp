@@ -1,21 +1,472 @@
 #include "Interpreter.h"
 
+#include <inttypes.h>
+#include <stdarg.h>
+#include <string.h>
+#include <algorithm>
+
 namespace ast {
-    void Interpreter::run() const 
+    namespace
+    {
+        // Evaluation recurses through the tree, a few hundred bytes of stack
+        // per level. Deeper than this is reported rather than overflowing.
+        const size_t MAX_DEPTH = 10000;
+
+        const char* name_of(Symbol sym)
+        {
+            return sym == NO_SYMBOL ? "?" : Interner::global().name(sym).data();
+        }
+
+        int name_len(Symbol sym)
+        {
+            return sym == NO_SYMBOL ? 1 : (int) Interner::global().name(sym).size();
+        }
+    }
+
+    const char* engine_name(Engine engine)
     {
-        
+        return engine == Engine::TREE ? "tree" : "bytecode";
     }
 
-    void Interpreter::execute_expression(ast::Expression* expr)
+    bool engine_from_name(const char* name, Engine& engine)
     {
-        if(expr->get_type() == Expr_t::CALL)
+        for(Engine candidate : { Engine::TREE, Engine::BYTECODE })
         {
-            // Execute the call instruction
-        } else
+            if(strcmp(name, engine_name(candidate)) == 0)
+            {
+                engine = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    Interpreter::Interpreter(ast::ParseResult&& parsed, Engine engine):
+        program(std::move(parsed)), resolution(resolve_program(program.root))
+    {
+        if(engine == Engine::BYTECODE)
         {
-            // Otherwise, it may be a binary expression or a single value
+            compiled = compile_program(resolution);
+            vm       = std::make_unique<VirtualMachine>(compiled);
+        }
+    }
 
+    bool Interpreter::run()
+    {
+        Value result;
+        return call(Interner::global().intern("main"), nullptr, 0, result);
+    }
+
+    bool Interpreter::call(Symbol function, const Value* call_args, size_t num_args, Value& result)
+    {
+        error_msg.clear();
+        if(!resolution.errors.empty())
+        {
+            if(resolution.errors.size() == 1)
+                return fail("%s", resolution.errors[0].c_str());
+            return fail("%s (and %zu more)", resolution.errors[0].c_str(), resolution.errors.size() - 1);
         }
+
+        uint32_t index = resolution.find(function);
+        if(index == UINT32_MAX)
+            return fail("there's no function %.*s() to run", name_len(function), name_of(function));
+
+        if(vm)
+        {
+            if(vm->call(index, call_args, num_args, result))
+                return true;
+            error_msg = vm->error();
+            return false;
+        }
+
+        reserve_slots(frame_top + num_args);
+        std::copy(call_args, call_args + num_args, slots.begin() + frame_top);
+        return invoke(&resolution.functions[index], num_args, result);
     }
-}
 
+    void Interpreter::set_output(FILE* out)
+    {
+        output = out;
+        if(vm)
+            vm->set_output(out);
+    }
+
+    void Interpreter::memoize(size_t entries)
+    {
+        std::vector<bool> pure = find_pure_functions(resolution);
+        memo.clear();
+        memo.resize(pure.size());
+        std::vector<MemoCache*> caches(pure.size());
+        for(size_t i = 0; i < pure.size(); i++)
+        {
+            if(pure[i])
+            {
+                memo[i]   = std::make_unique<MemoCache>(resolution.functions[i].num_params, entries);
+                caches[i] = memo[i].get();
+            }
+        }
+        if(vm)
+            vm->set_memo(std::move(caches));
+    }
+
+    std::vector<Interpreter::MemoStats> Interpreter::memo_stats() const
+    {
+        std::vector<MemoStats> stats;
+        for(size_t i = 0; i < memo.size(); i++)
+            if(memo[i])
+                stats.push_back({ resolution.functions[i].decl->get_name(), memo[i]->hits(), memo[i]->misses() });
+        return stats;
+    }
+
+    uint64_t Interpreter::num_calls() const
+    {
+        return vm ? vm->num_calls() : calls;
+    }
+
+    bool Interpreter::fail(const char* format, ...)
+    {
+        char message[512];
+        va_list list;
+        va_start(list, format);
+        vsnprintf(message, sizeof(message), format, list);
+        va_end(list);
+
+        // Only the innermost failure is reported, callers just pass it on
+        if(error_msg.empty())
+        {
+            error_msg = message;
+            if(current && strcmp(message, NESTED_TOO_DEEPLY) != 0)
+            {
+                error_msg += " in ";
+                error_msg.append(Interner::global().name(current->decl->get_name()));
+                error_msg += "()";
+            }
+        }
+        return false;
+    }
+
+    // Runs a function with its arguments in the slots from frame_top on,
+    // which become the first of its frame. A tail call it makes runs in
+    // that same frame once its arguments have moved down, so recursing
+    // through `return f(...)` doesn't grow the native stack.
+    bool Interpreter::invoke(const ResolvedFunction* func, size_t num_args, Value& result)
+    {
+        const ResolvedFunction* caller        = current;
+        size_t                  saved_base    = frame_base;
+        size_t                  saved_top     = frame_top;
+        size_t                  args_at       = frame_top;
+        size_t                  keys_base     = memo_keys.size();
+        MemoCache*              pending       = nullptr;    // Gets the result, keyed from keys_base
+        bool                    ok;
+        frame_base = frame_top;
+        result     = Value();
+        for(;;)
+        {
+            // Reported in the calling function, which is still current
+            Symbol name = func->decl->get_name();
+            if(num_args != func->num_params)
+            {
+                ok = fail("%.*s() takes %u arguments but was given %zu", name_len(name), name_of(name),
+                          func->num_params, num_args);
+                break;
+            }
+
+            frame_top = frame_base + func->num_slots;
+            reserve_slots(frame_top);
+            current = func;
+
+            ok = true;
+            for(uint32_t i = 0; i < func->num_params && ok; i++)
+                ok = convert(slots[args_at + i], func->slot_types[i], slots[frame_base + i]);
+            if(!ok)
+                break;
+
+            // A result remembered for these arguments returns straight away.
+            // The parameters may be assigned to, so the key is kept aside.
+            if(MemoCache* cache = memo.empty() ? nullptr : memo[func - resolution.functions.data()].get())
+            {
+                if(const Value* found = cache->find(slots.data() + frame_base))
+                {
+                    result = *found;
+                    break;
+                }
+                memo_keys.insert(memo_keys.end(), slots.begin() + frame_base, slots.begin() + frame_base + func->num_params);
+                pending = cache;
+            }
+            calls++;
+
+            Flow flow = execute_block(func->decl->get_body());
+            if(flow == Flow::TAIL_CALL)
+            {
+                // What this function returns isn't remembered, or a long
+                // chain of tail calls would keep a key for each
+                memo_keys.resize(keys_base);
+                pending  = nullptr;
+                func     = tail_call.callee;
+                num_args = tail_call.num_args;
+                args_at  = tail_call.args_at;
+                continue;
+            }
+
+            // Whatever a void function returns is dropped
+            bool returns_value = !(func->decl->get_return_type() == Type_t::VOID);
+            if(flow == Flow::FAILED)
+                ok = false;
+            else if(flow == Flow::RETURN && returns_value)
+            {
+                Value value = return_value;
+                ok = convert(value, func->decl->get_return_type().get_value(), result);
+            }
+            else if(flow == Flow::NEXT && returns_value)
+                ok = fail("reached the end without returning a value");
+            break;
+        }
+
+        if(pending && ok)
+            pending->store(memo_keys.data() + keys_base, result);
+        memo_keys.resize(keys_base);
+
+        frame_base = saved_base;
+        frame_top  = saved_top;
+        current    = caller;
+        return ok;
+    }
+
+    // Evaluates the arguments of a call into the slots from frame_top on,
+    // which it moves past each of them so calls among the later ones leave
+    // them be. The caller puts frame_top back.
+    bool Interpreter::push_arguments(const Expression* call_args)
+    {
+        for(const Expression* arg = call_args; arg; arg = arg->get_rhs())
+        {
+            Value value;
+            if(!execute_expression(arg->get_lhs(), value))
+                return false;
+            reserve_slots(frame_top + 1);
+            slots[frame_top++] = value;
+        }
+        return true;
+    }
+
+    void Interpreter::reserve_slots(size_t end)
+    {
+        if(slots.size() < end)
+            slots.resize(std::max(end, slots.size() * 2));
+    }
+
+    Interpreter::Flow Interpreter::execute_block(const Statement* stmts)
+    {
+        Flow flow = Flow::NEXT;
+        for(const Statement* stmt = stmts; stmt && flow == Flow::NEXT; stmt = stmt->next)
+            flow = execute_statement(stmt);
+        return flow;
+    }
+
+    Interpreter::Flow Interpreter::execute_statement(const Statement* stmt)
+    {
+        switch(stmt->get_type())
+        {
+        case Stmt_t::EXPR:
+        {
+            Value ignored;
+            return execute_expression(static_cast<const ExprStatement*>(stmt)->get_expr(), ignored) ? Flow::NEXT : Flow::FAILED;
+        }
+        case Stmt_t::RETURN:
+        {
+            // A call to a function with the same return type is left for
+            // invoke() to make in place of this one, just its arguments are
+            // evaluated here
+            const Expression* expr = static_cast<const ExprStatement*>(stmt)->get_expr();
+            if(expr && expr->get_type() == Expr_t::CALL && expr->get_slot() < resolution.functions.size())
+            {
+                const ResolvedFunction* callee = &resolution.functions[expr->get_slot()];
+                if(callee->decl->get_return_type() == current->decl->get_return_type().get_value())
+                {
+                    size_t args_at = frame_top;
+                    bool   ok      = push_arguments(expr->get_rhs());
+                    tail_call = { callee, args_at, frame_top - args_at };
+                    frame_top = args_at;
+                    return ok ? Flow::TAIL_CALL : Flow::FAILED;
+                }
+            }
+
+            // Not evaluated into return_value directly, calls in the
+            // expression set it too
+            Value value;
+            if(!execute_expression(expr, value))
+                return Flow::FAILED;
+            return_value = value;
+            return Flow::RETURN;
+        }
+
+        case Stmt_t::DECL:
+        {
+            const VariableDecl* decl = static_cast<const VarDeclStatement*>(stmt)->get_decl();
+            Type_t::Value       type = decl->get_type().get_value();
+
+            Value value = Value::of_int(0);
+            if(decl->get_expr() && !execute_expression(decl->get_expr(), value))
+                return Flow::FAILED;
+            // Looked up after the initialiser, whose calls may have grown
+            // the slots
+            if(!convert(value, type, slots[frame_base + decl->get_slot()]))
+                return Flow::FAILED;
+            return Flow::NEXT;
+        }
+        case Stmt_t::IF:
+        {
+            auto  if_stmt = static_cast<const IfStatement*>(stmt);
+            Value condition;
+            if(!execute_expression(if_stmt->get_condition(), condition))
+                return Flow::FAILED;
+            if(!condition.is_number())
+            {
+                fail("the condition of an if has to be a number");
+                return Flow::FAILED;
+            }
+
+            bool taken = condition.kind == Value::INT ? condition.int_value != 0 : condition.flt_value != 0.0;
+            if(taken)
+                return execute_block(if_stmt->get_body());
+            return if_stmt->get_else() ? execute_block(if_stmt->get_else()) : Flow::NEXT;
+        }
+        default:
+            fail("can't run this kind of statement");
+            return Flow::FAILED;
+        }
+    }
+
+    bool Interpreter::execute_expression(const Expression* expr, Value& result)
+    {
+        if(expr == nullptr)
+            return fail("an expression didn't parse");
+        if(depth == MAX_DEPTH)
+            return fail("%s", NESTED_TOO_DEEPLY);
+
+        depth++;
+        bool ok = true;
+        switch(expr->get_type())
+        {
+        case Expr_t::INT_LITERAL    : result = Value::of_int(expr->get_int());    break;
+        case Expr_t::FLOAT_LITERAL  : result = Value::of_float(expr->get_flt());  break;
+        case Expr_t::STRING_LITERAL : result = Value::of_string(expr->get_str()); break;
+
+        case Expr_t::IDENTIFIER:
+            result = slots[frame_base + expr->get_slot()];
+        break;
+
+        case Expr_t::ASSIGN:
+        {
+            const Expression* target = expr->get_lhs();
+            if(target->get_type() != Expr_t::IDENTIFIER)
+            {
+                ok = fail("only variables can be assigned to");
+                break;
+            }
+            Value value;
+            if(!(ok = execute_expression(expr->get_rhs(), value)))
+                break;
+
+            // Looked up after the right-hand side, whose calls may have
+            // grown the slots
+            uint32_t slot = target->get_slot();
+            if((ok = convert(value, current->slot_types[slot], slots[frame_base + slot])))
+                result = slots[frame_base + slot];
+        }
+        break;
+
+        case Expr_t::NEGATE:
+        {
+            Value value;
+            if(!(ok = execute_expression(expr->get_lhs(), value)))
+                break;
+            if(const char* error = apply_negate(value, result))
+                ok = fail("%s", error);
+        }
+        break;
+
+        case Expr_t::CALL:
+            ok = execute_call(expr, result);
+        break;
+
+        default:
+        {
+            Value lhs, rhs;
+            ok = execute_expression(expr->get_lhs(), lhs) && execute_expression(expr->get_rhs(), rhs) &&
+                 binary(expr->get_type(), lhs, rhs, result);
+        }
+        break;
+        }
+        depth--;
+        return ok;
+    }
+
+    bool Interpreter::execute_call(const Expression* call, Value& result)
+    {
+        uint32_t callee = call->get_slot();
+        if(callee == PRINT_BUILTIN)
+        {
+            result = Value();
+            return print(call->get_rhs());
+        }
+
+        // The arguments go straight where the callee's frame will be
+        size_t args_at = frame_top;
+        bool   ok      = push_arguments(call->get_rhs());
+        size_t num_args = frame_top - args_at;
+        frame_top = args_at;
+        return ok && invoke(&resolution.functions[callee], num_args, result);
+    }
+
+    // Writes its arguments one after the other and ends the line
+    bool Interpreter::print(const Expression* print_args)
+    {
+        // Everything is evaluated before anything is written, so prints
+        // inside the arguments come out first
+        size_t args_base = args.size();
+        for(const Expression* arg = print_args; arg; arg = arg->get_rhs())
+        {
+            Value value;
+            bool  ok = execute_expression(arg->get_lhs(), value);
+            if(ok && value.kind == Value::VOID)
+                ok = fail("print() was given a function call that returns nothing");
+            if(!ok)
+            {
+                args.resize(args_base);
+                return false;
+            }
+            args.push_back(value);
+        }
+        if(output)
+        {
+            for(size_t i = args_base; i < args.size(); i++)
+            {
+                const Value& value = args[i];
+                switch(value.kind)
+                {
+                    case Value::INT    : fprintf(output, "%" PRId64, value.int_value);      break;
+                    case Value::FLOAT  : fprintf(output, "%g", value.flt_value);            break;
+                    case Value::STRING : fwrite(value.str_value, 1, value.str_len, output); break;
+                    case Value::VOID   : break;
+                }
+            }
+            fputc('\n', output);
+        }
+        args.resize(args_base);
+        return true;
+    }
+
+    bool Interpreter::binary(Expr_t op, const Value& lhs, const Value& rhs, Value& result)
+    {
+        if(const char* error = apply_binary(op, lhs, rhs, result))
+            return fail("%s", error);
+        return true;
+    }
+
+    bool Interpreter::convert(const Value& value, Type_t::Value type, Value& result)
+    {
+        if(const char* error = convert_value(value, type, result))
+            return fail("%s", error);
+        return true;
+    }
+}
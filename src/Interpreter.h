@@ -1,37 +1,131 @@
 #pragma once
+#ifndef LANG_INTERPRETER_H
+#define LANG_INTERPRETER_H
 
+#include <stdint.h>
+#include <stdio.h>
+#include <cstddef>
+#include <string>
+#include <string_view>
 #include <memory>
-#include <unordered_map>
+#include <vector>
+
 #include "Declaration.h"
+#include "Statement.h"
+#include "Value.h"
+#include "Resolver.h"
+#include "Memo.h"
+#include "Bytecode.h"
+#include "VirtualMachine.h"
 
 namespace ast {
-    class SymbolTable
-    {
-        public:
-            void enter_context();
-            void exit_context();
+    // How a program is run: by walking its tree, or by compiling every
+    // function to bytecode up front and running that on a VirtualMachine
+    enum class Engine : uint8_t { TREE, BYTECODE };
 
-            // Query the symbol table, starting from the current context and 
-            // travels up the tables while the symbol has not been found
-            ast::Expression* query(const std::string& sym_name);
-        private:
-            std::vector<std::unordered_map<std::string, ast::Expression*>> symbols;
-    };
+    const char* engine_name(Engine engine);
+    bool        engine_from_name(const char* name, Engine& engine);
 
+    // Runs a parsed program, starting from main().
+    // Ints are 64-bit and wrap around, an int and a float make a float,
+    // comparisons give 0 or 1 and anything but 0 is true. Values are
+    // converted to the declared type of whatever they're stored in, which
+    // for variables declared without an initialiser starts out as 0.
+    //
+    // Runtime errors stop the program. run() and call() then return false
+    // and error() says what went wrong, there are no positions to report
+    // since the tree doesn't keep any. Both engines give the same output and
+    // errors, except for where they stop deep recursion: the tree walker
+    // recurses on the native stack and gives up sooner. Either way the error
+    // is NESTED_TOO_DEEPLY, without a function, and what ran before it may
+    // differ.
     class Interpreter
     {
         public:
             Interpreter() = default;
-            Interpreter(std::unique_ptr<ast::Declaration>& root):
-                root(std::move(root))
+            Interpreter(ast::ParseResult&& program, Engine engine = Engine::BYTECODE);
+
+            bool run();
+            // Calls one of the program's functions directly
+            bool call(Symbol function, const Value* args, size_t num_args, Value& result);
+
+            // Names resolve_program() couldn't bind and functions defined
+            // more than once, run() and call() refuse programs with any
+            const std::vector<std::string>& unresolved() const { return resolution.errors; }
+
+            // Where print() writes to, nullptr throws the output away
+            void set_output(FILE* out);
+
+            // Remembers the results of every function find_pure_functions()
+            // proves pure, up to `entries` per function, from the next call
+            // on. Recursions that keep asking for the same results, like a
+            // naive fibonacci, then only compute each one once.
+            void memoize(size_t entries = MemoCache::DEFAULT_ENTRIES);
+
+            struct MemoStats
             {
+                Symbol   function;
+                uint64_t hits   = 0;
+                uint64_t misses = 0;
+            };
+            std::vector<MemoStats> memo_stats() const;  // One per function memoized, in source order
 
-            }
+            Engine                 engine() const   { return vm ? Engine::BYTECODE : Engine::TREE; }
+            const BytecodeProgram& bytecode() const { return compiled; }    // Empty unless engine() is BYTECODE
 
-            void run() const;
-            void execute_expression(ast::Expression* expr);
+            const std::string& error() const { return error_msg; }
+            uint64_t num_calls() const;     // Of the program's functions, builtins aside
         private:
-            std::unique_ptr<ast::Declaration> root;
-            ast::SymbolTable symbols;
+            // TAIL_CALL returns to invoke() to make the call in tail_call
+            enum class Flow : uint8_t { NEXT, RETURN, TAIL_CALL, FAILED };
+
+            Flow execute_block(const Statement* stmts);
+            Flow execute_statement(const Statement* stmt);
+            bool execute_expression(const Expression* expr, Value& result);
+            bool execute_call(const Expression* call, Value& result);
+            bool invoke(const ResolvedFunction* func, size_t num_args, Value& result);
+            bool push_arguments(const Expression* args);
+            void reserve_slots(size_t end);
+            bool print(const Expression* args);
+
+            bool binary(Expr_t op, const Value& lhs, const Value& rhs, Value& result);
+            bool convert(const Value& value, Type_t::Value type, Value& result);
+            bool fail(const char* format, ...);
+
+            ast::ParseResult program;
+            Resolution       resolution;
+
+            // The frames of every call in progress, one after the other.
+            // Variables are read and written by their resolved slot, starting
+            // from frame_base, so nothing is looked up by name.
+            std::vector<Value> slots;
+            size_t             frame_base = 0;
+            size_t             frame_top  = 0;
+
+            std::vector<Value>      args;          // Arguments print() is given, for every one in progress
+            const ResolvedFunction* current = nullptr;
+
+            std::vector<std::unique_ptr<MemoCache>> memo;       // By function index, empty unless memoizing
+            std::vector<Value>                      memo_keys;  // Arguments of the memoized calls in progress
+
+            struct TailCall
+            {
+                const ResolvedFunction* callee;
+                size_t                  args_at;    // Its arguments are in the slots from here on
+                size_t                  num_args;
+            };
+            TailCall tail_call = {};
+
+            Value                   return_value;
+            size_t                  depth = 0;      // Of nested expressions, calls included
+            uint64_t                calls = 0;
+
+            FILE*       output = stdout;
+            std::string error_msg;
+
+            BytecodeProgram                 compiled;
+            std::unique_ptr<VirtualMachine> vm;
     };
 }
+
+#endif
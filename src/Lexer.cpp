@@ -4,123 +4,186 @@
 #include <ctype.h>
 #include <string.h>
 #include <stdio.h>
+#include <charconv>
 
 #include "Lexer.h"
+#include "CharScan.h"
 
-void LexerState::insert_token(const std::string& lexeme, enum TokenType type)
+void LexerState::insert_token(enum TokenType type, size_t start_idx, size_t length)
 {
-    tokens = do_insert_token(lexeme, type, tokens);
+    Token token;
+    token.offset      = static_cast<uint32_t>(start_idx);
+    token.length      = static_cast<uint32_t>(length);
+    token.line_number = static_cast<uint32_t>(curr_line_number);
+    token.pos_in_line = static_cast<uint16_t>(std::min<size_t>(start_idx - line_start_idx + 1, UINT16_MAX));
+    token.type        = type;
+    token.flags       = 0;
+    token.int_value   = 0;
+
+    const char* first = input_string.data() + start_idx;
+    switch(type)
+    {
+        case TOKEN_IDENTIFIER:
+            token.symbol = Interner::global().intern(std::string_view(first, length));
+        break;
+        default:
+        break;
+    }
+    tokens.push_back(token);
 }
 
-Token* LexerState::do_insert_token(const std::string& lexeme, TokenType type, Token* token_stream)
+char* LexerState::alloc_escaped(size_t max_length)
 {
-    if(token_stream == NULL)
+    const size_t needed = sizeof(uint32_t) + max_length;
+    if(escaped_block_used + needed > escaped_block_size)
     {
-        Token* new_token       = new Token();
-        new_token->next        = NULL;
-        new_token->prev        = NULL;
-        new_token->type        = type;
-        new_token->line_number = curr_line_number;
-        new_token->pos_in_line = curr_pos_in_line;
-
-        switch(type)
-        {
-            case TOKEN_IDENTIFIER:
-                new_token->lexeme = lexeme;
-            break;
-            case TOKEN_INT_LITERAL:
-                new_token->int_value = std::stol(lexeme);
-            break;
-            case TOKEN_FLOAT_LITERAL:
-                new_token->flt_value = std::stod(lexeme);
-            break;
-            default:
-                new_token->lexeme = lexeme;
-            break;
-        }
-        return new_token;
+        escaped_block_size = std::max<size_t>(needed, 64 * 1024);
+        escaped_block_used = 0;
+        escaped_blocks.emplace_back(new char[escaped_block_size]);
     }
-    token_stream->next       = do_insert_token(lexeme, type, token_stream->next);
-    token_stream->next->prev = token_stream;
-    return token_stream;
+    char* record = escaped_blocks.back().get() + escaped_block_used;
+    escaped_block_used += needed;
+    return record;
 }
 
 size_t LexerState::tokenize_string()
 {
-    curr_ch_idx        = 0;
-    num_tokens         = 0;
+    // Rough guess of one token per four bytes of source to avoid regrowing the buffer
+    tokens.clear();
+    tokens.reserve(on_batch ? batch_size : input_len / 4 + 1);
+    // The tokens that pointed into the decoded strings are gone, so the block
+    // in use is kept for this source and any earlier ones are freed
+    if(escaped_block_size == 0)
+        escaped_blocks.clear();
+    else if(escaped_blocks.size() > 1)
+    {
+        escaped_blocks.front() = std::move(escaped_blocks.back());
+        escaped_blocks.resize(1);
+    }
+    escaped_block_used = 0;
 
-    line_start_idx     = 0;
-    curr_line_number   = 1;
-    curr_pos_in_line   = 1;
+    size_t status = tokenize_range(0, 1, 0);
+    if(status != LEX_SUCCESS && print_errors)
+        print_error();
 
-    // TODO: Try to perform this within the main loop as opposed to a preprocessing function
-    // to avoid having to traverse the entire contents of the file twice
-    preprocess_string(input_string, input_len);
+    insert_token(TOKEN_EOF, std::min(curr_ch_idx, input_len), 0);
+    if(on_batch)
+        on_batch(tokens);
+    return status;
+}
+
+// Appends the tokens from `begin` up to input_len. Stops at the first
+// unrecognised character or number that doesn't fit its type, leaving the
+// state pointing at it for print_error().
+size_t LexerState::tokenize_range(size_t begin, size_t first_line, size_t first_line_start)
+{
+    curr_ch_idx      = begin;
+    curr_line_number = first_line;
+    line_start_idx   = first_line_start;
+    error            = LEX_SUCCESS;
 
-    size_t status = LEX_SUCCESS;
     while(curr_ch_idx < input_len)
     {
+        if(on_batch && tokens.size() >= batch_size)
+            on_batch(tokens);
+
         bool read_valid_token = true;
-        while(isspace(input_string[curr_ch_idx]))
-        {
-            curr_pos_in_line++;
-            curr_ch_idx++;
-            if (input_string[curr_ch_idx] == '\n')
-            {
-                curr_line_number++;
-                curr_pos_in_line = 1;
-                line_start_idx = curr_ch_idx + 1;
-            }
-        }
-        curr_char = input_string[curr_ch_idx];
+        skip_whitespace_and_comments();
+        if(curr_ch_idx >= input_len) break;
 
-        if(!curr_char) break;
+        curr_char = input_string[curr_ch_idx];
 
-        if(isalpha(curr_char) && (read_valid_token &= maybe_parse_identifier()))  continue;
-        if(isdigit(curr_char) && (read_valid_token &= maybe_parse_num_literal())) continue;
+        if(scan::is_alpha(curr_char) && (read_valid_token &= maybe_parse_identifier()))  continue;
+        if(scan::is_digit(curr_char))
+        {
+            if(!maybe_parse_num_literal())
+                return error;
+            continue;
+        }
         if(curr_char == '\"'  && (read_valid_token &= maybe_parse_str_literal())) continue;
         
         read_valid_token &= maybe_parse_operators();
         if (!read_valid_token)
-        {
-            printf("[Error] Unrecognized token at line %llu \"%c\"\n", curr_line_number, curr_char);
-            printf("    \"");
-            while(input_string[line_start_idx++] != '\n')
-                printf("%c", input_string[line_start_idx - 1]);
-            printf("\"\n");
-            printf("\n\n");
-            status = LEX_ERR_UNKNOWN_TOKEN;
-            break;
-        }
+            return error = LEX_ERR_UNKNOWN_TOKEN;
         curr_ch_idx++;
     }
-    insert_token("EOF", TOKEN_EOF);
-    return status;
+    return LEX_SUCCESS;
 }
 
-bool LexerState::maybe_parse_num_literal()
+void LexerState::print_error() const
 {
-    size_t end_idx  = curr_ch_idx + 1;
-    int num_periods = 0;
+    if(error == LEX_ERR_INVALID_INT || error == LEX_ERR_INVALID_REAL)
+    {
+        size_t end = scan::skip_number(input_string.data(), curr_ch_idx + 1, input_len);
+        printf("[Error] Invalid %s literal at line %zu \"%.*s\"\n", error == LEX_ERR_INVALID_INT ? "int" : "float",
+               curr_line_number, (int) (end - curr_ch_idx), input_string.data() + curr_ch_idx);
+    }
+    else
+        printf("[Error] Unrecognized token at line %zu \"%c\"\n", curr_line_number, curr_char);
+    printf("    \"");
+    for(size_t i = line_start_idx; i < input_string.size() && input_string[i] != '\n'; i++)
+        printf("%c", input_string[i]);
+    printf("\"\n");
+    printf("\n\n");
+}
 
-    char char_at_end = input_string[end_idx];
-    while(end_idx < input_len && (isdigit(char_at_end) || char_at_end == '.'))
+void LexerState::skip_whitespace_and_comments()
+{
+    const char* data = input_string.data();
+    while(true)
     {
-        if(input_string[end_idx] == '.')
-            num_periods++;
-        char_at_end = input_string[++end_idx];
+        curr_ch_idx = scan::skip_blank(data, curr_ch_idx, input_len);
+        if(curr_ch_idx >= input_len)
+            return;
+
+        char c = data[curr_ch_idx];
+        if(c == '\n')
+        {
+            curr_line_number++;
+            line_start_idx = ++curr_ch_idx;
+        }
+        else if(c == '/' && curr_ch_idx + 1 < input_len && data[curr_ch_idx + 1] == '/')
+        {
+            // Leave the newline itself to the next iteration so it is counted
+            const void* newline = memchr(data + curr_ch_idx, '\n', input_len - curr_ch_idx);
+            curr_ch_idx = newline ? static_cast<const char*>(newline) - data : input_len;
+        }
+        else
+        {
+            return;
+        }
     }
+}
 
-    if(num_periods > 1)
-        return false;
+bool LexerState::maybe_parse_num_literal()
+{
+    const char* data    = input_string.data();
+    size_t      end_idx = scan::skip_number(data, curr_ch_idx + 1, input_len);
+    auto    num_periods = std::count(data + curr_ch_idx, data + end_idx, '.');
 
     size_t num_len      = end_idx - curr_ch_idx;
     enum TokenType type = (num_periods == 0 ? TOKEN_INT_LITERAL : TOKEN_FLOAT_LITERAL);
 
-    lexeme_buffer = input_string.substr(curr_ch_idx, num_len);
+    // One that's out of range is an error rather than some other number
+    const char*            first     = data + curr_ch_idx;
+    int64_t                int_value = 0;
+    double                 flt_value = 0.0;
+    std::from_chars_result parsed;
+    if(type == TOKEN_INT_LITERAL)
+        parsed = std::from_chars(first, data + end_idx, int_value);
+    else
+        parsed = std::from_chars(first, data + end_idx, flt_value);
+    if(num_periods > 1 || parsed.ec != std::errc() || parsed.ptr != data + end_idx)
+    {
+        error = (type == TOKEN_INT_LITERAL ? LEX_ERR_INVALID_INT : LEX_ERR_INVALID_REAL);
+        return false;
+    }
 
-    insert_token(lexeme_buffer, type);
+    insert_token(type, curr_ch_idx, num_len);
+    if(type == TOKEN_INT_LITERAL)
+        tokens.back().int_value = int_value;
+    else
+        tokens.back().flt_value = flt_value;
     curr_ch_idx = end_idx;
 
     return true;
@@ -129,101 +192,105 @@ bool LexerState::maybe_parse_num_literal()
 
 bool LexerState::maybe_parse_str_literal()
 {
-    lexeme_buffer = "";
-    
     curr_ch_idx++; // consume left (")
-    while(curr_ch_idx < input_len - 1 && input_string[curr_ch_idx] != '\"')
-        lexeme_buffer += input_string[curr_ch_idx++];
 
+    // Insert up front so the token keeps the position of where the literal starts
+    insert_token(TOKEN_STR_LITERAL, curr_ch_idx, 0);
+    Token& str_token = tokens.back();
+
+    bool has_escapes = false;
+    while(true)
+    {
+        curr_ch_idx = scan::skip_string_body(input_string.data(), curr_ch_idx, input_len);
+        if(curr_ch_idx >= input_len || input_string[curr_ch_idx] == '\"')
+            break;
+
+        if(input_string[curr_ch_idx] == '\n')
+        {
+            curr_line_number++;
+            line_start_idx = curr_ch_idx + 1;
+        }
+        else if(curr_ch_idx + 1 < input_len)  // '\\'
+        {
+            has_escapes = true;
+            if(input_string[++curr_ch_idx] == '\n')
+            {
+                curr_line_number++;
+                line_start_idx = curr_ch_idx + 1;
+            }
+        }
+        curr_ch_idx++;
+    }
+    str_token.length = static_cast<uint32_t>(curr_ch_idx - str_token.offset);
+
+    // Literals without escapes are referenced straight from the source, only
+    // the rare escaped ones get decoded into the side blocks
+    if(has_escapes)
+    {
+        char*    record  = alloc_escaped(str_token.length);
+        char*    decoded = record + sizeof(uint32_t);
+        uint32_t length  = 0;
+        for(size_t i = str_token.offset; i < curr_ch_idx; i++)
+        {
+            char c = input_string[i];
+            if(c == '\\' && i + 1 < curr_ch_idx)
+            {
+                switch(input_string[++i])
+                {
+                    case 'n' : c = '\n'; break;
+                    case 't' : c = '\t'; break;
+                    case 'r' : c = '\r'; break;
+                    case '0' : c = '\0'; break;
+                    default  : c = input_string[i]; break;
+                }
+            }
+            decoded[length++] = c;
+        }
+        std::memcpy(record, &length, sizeof(length));
+        escaped_block_used -= str_token.length - length;
+
+        str_token.flags  |= TOKEN_FLAG_ESCAPED;
+        str_token.escaped = record;
+    }
     curr_ch_idx++; // consume right (")
-    insert_token(lexeme_buffer, TOKEN_STR_LITERAL);
     return true;
 }
 
 bool LexerState::maybe_parse_identifier()
 {
-    static const std::array<std::string, 4> KEYWORDS = {
-        "if", "else", "func", "return"
-    };
-
-    size_t end_idx = curr_ch_idx + 1;
-    while(end_idx < input_len && (isalnum(input_string[end_idx]) || input_string[end_idx] == '_'))
-        end_idx++;
+    size_t end_idx = scan::skip_identifier(input_string.data(), curr_ch_idx + 1, input_len);
     
     const size_t ident_len = end_idx - curr_ch_idx;
-    lexeme_buffer = input_string.substr(curr_ch_idx, ident_len);
+    std::string_view ident(input_string.data() + curr_ch_idx, ident_len);
 
-    enum TokenType type = TOKEN_IDENTIFIER;
-    auto match = std::find(KEYWORDS.begin(), KEYWORDS.end(), lexeme_buffer);
-
-    if (match != KEYWORDS.end())
-        type = static_cast<TokenType>(KEYWORD_IF + (match - KEYWORDS.begin()));
-
-    insert_token(lexeme_buffer, type);
+    insert_token(token_spec::classify_identifier(ident), curr_ch_idx, ident_len);
     curr_ch_idx += ident_len;
 
-    num_tokens++;
     return true;
 }
 
 
 bool LexerState::maybe_parse_operators()
 {
-    // Ordered in the same way as the corresponding TokenTypes
-    static const char  SINGLE_CH_TOKENS[] = { 
-        '+', '-', '*', '/', '=', '(', ')' , ',', ':', ';', '{', '}', '<', '>'
-    };
-    static const char* MULTI_CH_TOKENS[]  = { 
-        "++", "--", "**", "==", "<=", ">=", "!=", "->"
-    };
-
-    bool found_operator = false;
-    if (curr_ch_idx < input_len - 2)
+    const token_spec::OperatorState& state = token_spec::OPERATOR_TABLE[(uint8_t) curr_char];
+
+    if (curr_ch_idx + 1 < input_len)
     {
         char next_char = input_string[curr_ch_idx + 1];
-        char token[3]  = { curr_char, next_char, 0 };
-
-        for (int i = 0; i < 8; ++i)
+        for (uint8_t i = 0; i < state.num_pairs; ++i)
         {
-            if (strcmp(token, MULTI_CH_TOKENS[i]) == 0)
+            if (state.second[i] == next_char)
             {
-                insert_token(token, static_cast<TokenType>(TOKEN_INCREMENT + i));
-                found_operator = true;
-                curr_ch_idx += 2;
-                curr_pos_in_line += 2;
-                curr_char = input_string[curr_ch_idx];
-                break;
+                insert_token(static_cast<TokenType>(state.paired[i]), curr_ch_idx, 2);
+                curr_ch_idx++;  // The caller steps over the second character
+                return true;
             }
         }
     }
 
-    for (int i = 0; i < 14 && !found_operator; i++)
-    {
-        if (SINGLE_CH_TOKENS[i] == curr_char) 
-        {
-            char token[2]  = { curr_char, '\0' };
-            insert_token(token, static_cast<TokenType>(TOKEN_OP_PLUS + i));
-            found_operator = true;
-            break;
-        }
-    }
-    return found_operator;
-}
-
-void preprocess_string(std::string& input_string, size_t input_len)
-{
-    if(input_len > 2) 
-    {
-        // i++ handles skipping the newline when comment is replaced with blanks
-        for(size_t i = 0; i < input_len; i++)
-        {
-            if(input_string[i] == '\r') input_string[i] = ' ';
+    if (state.single == token_spec::NO_TOKEN)
+        return false;
 
-            if (input_string[i] == '/' && input_string[i + 1] == '/')
-            {
-                while(input_string[i] != '\n') 
-                    input_string[i++] = ' ';
-            }
-        }
-    }
+    insert_token(static_cast<TokenType>(state.single), curr_ch_idx, 1);
+    return true;
 }
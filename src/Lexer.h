@@ -3,83 +3,101 @@
 #define LANG_LEXER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <cstddef>
 #include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <array>
 #include <algorithm>
 
+#include "TokenSpec.h"
+#include "Interner.h"
+
 enum LexerError 
 {
     LEX_SUCCESS , LEX_ERR_UNKNOWN_TOKEN , LEX_ERR_INVALID_REAL , LEX_ERR_INVALID_INT ,
 };
 
-enum TokenType 
-{ 
-    TOKEN_IDENTIFIER , TOKEN_INT_LITERAL  , TOKEN_FLOAT_LITERAL , TOKEN_STR_LITERAL  ,
-
-    TOKEN_OP_PLUS    , TOKEN_OP_MINUS     , TOKEN_OP_MUL        , TOKEN_OP_DIV       ,
-    TOKEN_OP_EQU     , TOKEN_LEFT_PAREN   , TOKEN_RIGHT_PAREN   , TOKEN_COMMA        ,
-    TOKEN_COLON      , TOKEN_SEMICOLON    , TOKEN_LEFT_CBRACK   , TOKEN_RIGHT_CBRACK ,
-    TOKEN_COMP_LESS  , TOKEN_COMP_GREATER ,
-
-    TOKEN_INCREMENT  , TOKEN_DECREMENT    , TOKEN_POWER         , TOKEN_COMP_EQUAL   ,
-    TOKEN_COMP_LEQ   , TOKEN_COMP_GEQ     , TOKEN_COMP_NEQ      , TOKEN_ARROW        ,
-
-    KEYWORD_IF       , KEYWORD_ELSE       , KEYWORD_FUNC        , KEYWORD_RETURN     ,
-    TOKEN_EOF        ,
+enum TokenFlags : uint8_t
+{
+    TOKEN_FLAG_ESCAPED = 1 << 0,    // String literal whose decoded text is pointed to by Token::escaped
 };
 
+// Tokens live in a single contiguous buffer and refer back into the source
+// by offset and length rather than owning a copy of their lexeme.
 struct Token 
 {
-    enum   TokenType type;
-    long   int_value;
-    double flt_value;
-    std::string lexeme = {};
-
-    size_t line_number;
-    size_t pos_in_line;
-    size_t line_start_idx;
-
-    Token* next;
-    Token* prev;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t line_number;
+    uint16_t pos_in_line;   // saturates on absurdly long lines
+    enum TokenType type;
+    uint8_t  flags;
+
+    union {
+        int64_t int_value;
+        double  flt_value;
+        Symbol  symbol;         // Identifiers, interned in Interner::global()
+        const char* escaped;    // uint32_t length followed by the decoded characters
+    };
 };
+static_assert(sizeof(Token) == 24, "Token is expected to stay compact");
 
 struct LexerState 
 {
-    std::string input_string;
+    std::string_view input_string;   // Not owned, must outlive the tokens
     size_t input_len;
-    size_t num_tokens;
-    Token* tokens;
+    std::vector<Token> tokens;
+
+    // Decoded text of escaped string literals. Blocks never move once allocated
+    // so tokens can point straight into them, even from another thread.
+    std::vector<std::unique_ptr<char[]>> escaped_blocks;
+    size_t escaped_block_used = 0;
+    size_t escaped_block_size = 0;   // Of the last block, 0 if it can't be reused
 
     size_t curr_line_number;
-    size_t curr_pos_in_line;
     size_t line_start_idx;
 
     char   curr_char;
     size_t curr_ch_idx;
 
-    std::string lexeme_buffer;
+    // When set, tokens are handed off in batches of batch_size as they are
+    // produced instead of accumulating in `tokens` for the whole input. The
+    // callback may swap in a different (empty) vector to keep filling.
+    std::function<void(std::vector<Token>&)> on_batch;
+    size_t batch_size = 0;
+
+    bool print_errors = true;   // Whether tokenize_string() reports a failure on stdout
+    enum LexerError error = LEX_SUCCESS;    // Why the last tokenize_range() stopped, for print_error()
 
     size_t tokenize_string();
+    size_t tokenize_range(size_t begin, size_t first_line, size_t first_line_start);
+    void   print_error() const;
+    void skip_whitespace_and_comments();
     bool maybe_parse_identifier();
     bool maybe_parse_num_literal();
     bool maybe_parse_str_literal();
     bool maybe_parse_operators();
 
-    ~LexerState() 
+    void insert_token(enum TokenType, size_t start_idx, size_t length);
+    char* alloc_escaped(size_t max_length);
+
+    // Text of the token, for string literals this excludes the quotes and has
+    // any escape sequences already decoded
+    std::string_view lexeme(const Token& token) const
     {
-        Token* curr_token = tokens;
-        while (curr_token != NULL) 
+        if(token.flags & TOKEN_FLAG_ESCAPED)
         {
-            Token* to_delete = curr_token;
-            curr_token = curr_token->next;
-            delete to_delete;
+            uint32_t length;
+            std::memcpy(&length, token.escaped, sizeof(length));
+            return std::string_view(token.escaped + sizeof(length), length);
         }
+        return input_string.substr(token.offset, token.length);
     }
-
-    void insert_token(const std::string&, enum TokenType);
-    Token* do_insert_token(const std::string&, enum TokenType, Token*);
 };
-void preprocess_string(std::string&, size_t);
 #endif
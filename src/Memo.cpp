@@ -0,0 +1,145 @@
+#include "Memo.h"
+
+#include <algorithm>
+
+#include "Hash.h"
+#include "Statement.h"
+
+namespace ast {
+    namespace
+    {
+        // What `stmts` calls, PRINT_BUILTIN and NO_SLOT included
+        void find_callees(const Statement* stmts, std::vector<uint32_t>& callees)
+        {
+            std::vector<const Expression*> pending;
+            for(const Statement* stmt = stmts; stmt; stmt = stmt->next)
+            {
+                switch(stmt->get_type())
+                {
+                case Stmt_t::EXPR:
+                case Stmt_t::RETURN:
+                    pending.push_back(static_cast<const ExprStatement*>(stmt)->get_expr());
+                break;
+
+                case Stmt_t::DECL:
+                    pending.push_back(static_cast<const VarDeclStatement*>(stmt)->get_decl()->get_expr());
+                break;
+
+                case Stmt_t::IF:
+                {
+                    auto if_stmt = static_cast<const IfStatement*>(stmt);
+                    pending.push_back(if_stmt->get_condition());
+                    find_callees(if_stmt->get_body(), callees);
+                    find_callees(if_stmt->get_else(), callees);
+                }
+                break;
+
+                default:
+                break;
+                }
+
+                while(!pending.empty())
+                {
+                    const Expression* expr = pending.back();
+                    pending.pop_back();
+                    if(!expr)
+                        continue;
+                    if(expr->get_type() == Expr_t::CALL)
+                        callees.push_back(expr->get_slot());
+                    pending.push_back(expr->get_lhs());
+                    pending.push_back(expr->get_rhs());
+                }
+            }
+        }
+    }
+
+    std::vector<bool> find_pure_functions(const Resolution& resolution)
+    {
+        size_t num_functions = resolution.functions.size();
+        std::vector<std::vector<uint32_t>> callees(num_functions);
+        for(size_t i = 0; i < num_functions; i++)
+            find_callees(resolution.functions[i].decl->get_body(), callees[i]);
+
+        // Everything starts out without effects and gets them through what
+        // it calls, until nothing changes. Recursion alone has none.
+        std::vector<bool> no_effects(num_functions, true);
+        bool changed = true;
+        while(changed)
+        {
+            changed = false;
+            for(size_t i = 0; i < num_functions; i++)
+            {
+                if(!no_effects[i])
+                    continue;
+                for(uint32_t callee : callees[i])
+                {
+                    if(callee >= num_functions || !no_effects[callee])
+                    {
+                        no_effects[i] = false;
+                        changed       = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        std::vector<bool> pure(num_functions);
+        for(size_t i = 0; i < num_functions; i++)
+            pure[i] = no_effects[i] && !(resolution.functions[i].decl->get_return_type() == Type_t::VOID);
+        return pure;
+    }
+
+    MemoCache::MemoCache(uint32_t num_params, size_t num_entries):
+        params(num_params)
+    {
+        size_t size = 1;
+        while(size < num_entries)
+            size *= 2;
+        mask = size - 1;
+        keys.resize(size * num_params);
+        results.resize(size);
+    }
+
+    size_t MemoCache::slot_of(const Value* args) const
+    {
+        uint64_t h = hash::SEED;
+        for(uint32_t i = 0; i < params; i++)
+            h = hash::combine(hash::combine(h, ((uint64_t) args[i].kind << 32) | args[i].str_len), (uint64_t) args[i].int_value);
+        return (size_t) h & mask;
+    }
+
+    // Compared bit for bit, so 0.0 and -0.0 are different arguments, as
+    // they can give different results
+    bool MemoCache::matches(size_t slot, const Value* args) const
+    {
+        if(results[slot].kind == Value::VOID)
+            return false;
+        const Value* key = keys.data() + slot * params;
+        for(uint32_t i = 0; i < params; i++)
+        {
+            if(key[i].kind != args[i].kind || key[i].str_len != args[i].str_len ||
+               key[i].int_value != args[i].int_value)
+                return false;
+        }
+        return true;
+    }
+
+    const Value* MemoCache::find(const Value* args)
+    {
+        size_t slot = slot_of(args);
+        if(matches(slot, args))
+        {
+            num_hits++;
+            return &results[slot];
+        }
+        num_misses++;
+        return nullptr;
+    }
+
+    void MemoCache::store(const Value* args, const Value& result)
+    {
+        size_t slot = slot_of(args);
+        std::copy(args, args + params, keys.begin() + slot * params);
+        results[slot] = result;
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#ifndef LANG_MEMO_H
+#define LANG_MEMO_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+
+#include "Resolver.h"
+#include "Value.h"
+
+namespace ast {
+    // Which of the program's functions always give the same result for the
+    // same arguments and do nothing else, by index into
+    // resolution.functions. A function is pure unless it prints or calls
+    // one that isn't. Assignments don't matter: the only variables a
+    // function can see are its own, and arguments are passed by value.
+    // Functions that return nothing aren't, there's nothing to remember.
+    // The program has to have resolved without errors.
+    std::vector<bool> find_pure_functions(const Resolution& resolution);
+
+    // Results of one pure function by the arguments it was called with,
+    // after they were converted to its parameters' types. It holds a fixed
+    // number of entries and the slot an entry goes in depends only on its
+    // arguments, so a new result replaces whatever was there before.
+    // Recursions mostly ask for what they just computed, which stays.
+    class MemoCache
+    {
+        public:
+            static constexpr size_t DEFAULT_ENTRIES = 4096;
+
+            // `num_entries` is rounded up to a power of two
+            MemoCache(uint32_t num_params, size_t num_entries = DEFAULT_ENTRIES);
+
+            // nullptr if there's no result for `args`, counted as a miss
+            const Value* find(const Value* args);
+            void         store(const Value* args, const Value& result);
+
+            uint32_t num_params() const { return params; }
+            uint64_t hits() const       { return num_hits; }
+            uint64_t misses() const     { return num_misses; }
+        private:
+            size_t slot_of(const Value* args) const;
+            bool   matches(size_t slot, const Value* args) const;
+
+            uint32_t           params;
+            size_t             mask;
+            std::vector<Value> keys;        // num_params per entry
+            std::vector<Value> results;     // VOID where there's no entry yet
+            uint64_t           num_hits   = 0;
+            uint64_t           num_misses = 0;
+    };
+}
+
+#endif
@@ -20,7 +20,6 @@ namespace ast {
     {
         public:
             AST_Node() = default;
-            virtual int output_graphviz(GraphvizDocument&) const = 0;
             virtual ~AST_Node() = default;
     };
 };
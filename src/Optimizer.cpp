@@ -0,0 +1,424 @@
+#include "Optimizer.h"
+
+#include <unordered_map>
+#include <vector>
+
+#include "Statement.h"
+#include "Value.h"
+
+namespace ast {
+    namespace
+    {
+        // What an expression is known to evaluate to before running it.
+        // Strings, void calls and names that aren't declared are all ANY.
+        enum class Known : uint8_t { ANY, INT, FLOAT };
+
+        Known known_of_type(Type_t::Value type)
+        {
+            Value::Kind kind = kind_of_type(type);
+            return kind == Value::INT ? Known::INT : kind == Value::FLOAT ? Known::FLOAT : Known::ANY;
+        }
+
+        bool is_number(Known known) { return known != Known::ANY; }
+
+        bool is_literal(const Expression* expr)
+        {
+            return expr && (expr->get_type() == Expr_t::INT_LITERAL || expr->get_type() == Expr_t::FLOAT_LITERAL ||
+                            expr->get_type() == Expr_t::STRING_LITERAL);
+        }
+
+        Value literal_value(const Expression* expr)
+        {
+            switch(expr->get_type())
+            {
+                case Expr_t::INT_LITERAL   : return Value::of_int(expr->get_int());
+                case Expr_t::FLOAT_LITERAL : return Value::of_float(expr->get_flt());
+                default                    : return Value::of_string(expr->get_str());
+            }
+        }
+
+        // Whether `constant` is `identity` for an operand known to be
+        // `other`: an int literal works for any number, a float one only
+        // leaves floats as they are
+        bool is_identity(const Expression* constant, int64_t identity, Known other)
+        {
+            if(constant->get_type() == Expr_t::INT_LITERAL)
+                return constant->get_int() == identity && is_number(other);
+            if(constant->get_type() == Expr_t::FLOAT_LITERAL)
+                return constant->get_flt() == (double) identity && other == Known::FLOAT;
+            return false;
+        }
+
+        size_t count_nodes(const Expression* root)
+        {
+            size_t count = 0;
+            std::vector<const Expression*> pending = { root };
+            while(!pending.empty())
+            {
+                const Expression* expr = pending.back();
+                pending.pop_back();
+                if(!expr)
+                    continue;
+                count++;
+                pending.push_back(expr->get_lhs());
+                pending.push_back(expr->get_rhs());
+            }
+            return count;
+        }
+
+        size_t count_nodes(const Statement* stmts)
+        {
+            size_t count = 0;
+            for(const Statement* stmt = stmts; stmt; stmt = stmt->next)
+            {
+                count++;
+                switch(stmt->get_type())
+                {
+                case Stmt_t::EXPR:
+                case Stmt_t::RETURN:
+                    count += count_nodes(static_cast<const ExprStatement*>(stmt)->get_expr());
+                break;
+
+                case Stmt_t::DECL:
+                    // The statement and the declaration it holds
+                    count += 1 + count_nodes(static_cast<const VarDeclStatement*>(stmt)->get_decl()->get_expr());
+                break;
+
+                case Stmt_t::IF:
+                {
+                    auto if_stmt = static_cast<const IfStatement*>(stmt);
+                    count += count_nodes(if_stmt->get_condition()) + count_nodes(if_stmt->get_body()) +
+                             count_nodes(if_stmt->get_else());
+                }
+                break;
+
+                default:
+                break;
+                }
+            }
+            return count;
+        }
+
+        bool declares_variables(const Statement* stmts)
+        {
+            for(const Statement* stmt = stmts; stmt; stmt = stmt->next)
+                if(stmt->get_type() == Stmt_t::DECL)
+                    return true;
+            return false;
+        }
+
+        class FunctionOptimizer
+        {
+            public:
+                FunctionOptimizer(Arena& arena, const std::unordered_map<Symbol, Type_t::Value>& returns,
+                                  OptimizeStats& stats):
+                    arena(arena), returns(returns), stats(stats) { }
+
+                void optimize(FunctionDecl* func);
+            private:
+                struct Local
+                {
+                    Symbol name;
+                    Known  known;
+                };
+
+                void  optimize_block(Statement** head);
+                bool  optimize_if(Statement** link);
+                Known optimize_expression(Expression** root);
+                Known finish(Expression** ref, const Known* operands);
+                Known lookup(const Expression* name) const;
+
+                Arena&                                           arena;
+                const std::unordered_map<Symbol, Type_t::Value>& returns;
+                OptimizeStats&                                   stats;
+
+                std::vector<Local> locals;      // Innermost last
+        };
+
+        void FunctionOptimizer::optimize(FunctionDecl* func)
+        {
+            // The resolver turns these away, nothing would run them
+            if(if_depth(func->get_body()) > MAX_IF_DEPTH)
+                return;
+            for(const ParameterNode* param = func->get_params(); param; param = param->get_next_param())
+                locals.push_back({ param->get_name(), known_of_type(param->get_type().get_value()) });
+            optimize_block(func->body_ref());
+        }
+
+        void FunctionOptimizer::optimize_block(Statement** head)
+        {
+            size_t num_locals = locals.size();
+            for(Statement** link = head; *link; )
+            {
+                Statement* stmt = *link;
+                switch(stmt->get_type())
+                {
+                case Stmt_t::EXPR:
+                case Stmt_t::RETURN:
+                    optimize_expression(static_cast<ExprStatement*>(stmt)->expr_ref());
+                break;
+
+                case Stmt_t::DECL:
+                {
+                    VariableDecl* decl = static_cast<VarDeclStatement*>(stmt)->get_decl();
+                    optimize_expression(decl->expr_ref());
+                    locals.push_back({ decl->get_name(), known_of_type(decl->get_type().get_value()) });
+                }
+                break;
+
+                case Stmt_t::IF:
+                    // What replaces a pruned if is looked at from the start
+                    if(optimize_if(link))
+                        continue;
+                break;
+
+                default:
+                break;
+                }
+                link = &stmt->next;
+            }
+            locals.resize(num_locals);
+        }
+
+        // True if the if at *link was replaced by the statements of the
+        // branch taken, or by nothing
+        bool FunctionOptimizer::optimize_if(Statement** link)
+        {
+            auto if_stmt = static_cast<IfStatement*>(*link);
+            optimize_expression(if_stmt->condition_ref());
+
+            Expression* condition = *if_stmt->condition_ref();
+            if(!condition || !(condition->get_type() == Expr_t::INT_LITERAL || condition->get_type() == Expr_t::FLOAT_LITERAL))
+            {
+                optimize_block(if_stmt->body_ref());
+                optimize_block(if_stmt->else_ref());
+                return false;
+            }
+
+            bool taken = condition->get_type() == Expr_t::INT_LITERAL ? condition->get_int() != 0
+                                                                        : condition->get_flt() != 0.0;
+            Statement* kept    = taken ? *if_stmt->body_ref() : *if_stmt->else_ref();
+            Statement* dropped = taken ? *if_stmt->else_ref() : *if_stmt->body_ref();
+            stats.pruned++;
+            stats.removed += count_nodes(dropped);
+
+            // Its variables mustn't become visible after it, so the branch
+            // stays an if, one that's always taken
+            if(declares_variables(kept))
+            {
+                if(!taken)
+                    *if_stmt->condition_ref() = arena.make<Expression>((int64_t) 1);
+                *if_stmt->body_ref() = kept;
+                *if_stmt->else_ref() = nullptr;
+                optimize_block(if_stmt->body_ref());
+                return false;
+            }
+
+            stats.removed += 1 + count_nodes(condition);
+            if(!kept)
+            {
+                *link = if_stmt->next;
+                return true;
+            }
+            Statement* last = kept;
+            while(last->next)
+                last = last->next;
+            last->next = if_stmt->next;
+            *link      = kept;
+            return true;
+        }
+
+        // Expressions can nest far deeper than the native stack would like,
+        // so they're walked with a stack of their own. Operands are done
+        // before what uses them, and what each turned out to be waits on
+        // `results` for it.
+        Known FunctionOptimizer::optimize_expression(Expression** root)
+        {
+            struct Pending
+            {
+                Expression** ref;
+                bool         expanded;
+            };
+            std::vector<Pending> pending = { { root, false } };
+            std::vector<Known>   results;
+            while(!pending.empty())
+            {
+                Pending     top  = pending.back();
+                Expression* expr = *top.ref;
+                if(top.expanded || !expr)
+                {
+                    pending.pop_back();
+                    if(!expr)
+                    {
+                        results.push_back(Known::ANY);
+                        continue;
+                    }
+                    // Every operand pushed one result, the last on top
+                    size_t num_operands = expr->get_type() == Expr_t::ARG ? 2 :
+                                          expr->get_type() == Expr_t::CALL || expr->get_type() == Expr_t::ASSIGN ||
+                                          expr->get_type() == Expr_t::NEGATE ? 1 : 2;
+                    Known operands[2];
+                    for(size_t i = num_operands; i > 0; i--)
+                    {
+                        operands[i - 1] = results.back();
+                        results.pop_back();
+                    }
+                    results.push_back(finish(top.ref, operands));
+                    continue;
+                }
+
+                switch(expr->get_type())
+                {
+                case Expr_t::INT_LITERAL    : results.push_back(Known::INT);   pending.pop_back(); continue;
+                case Expr_t::FLOAT_LITERAL  : results.push_back(Known::FLOAT); pending.pop_back(); continue;
+                case Expr_t::STRING_LITERAL : results.push_back(Known::ANY);   pending.pop_back(); continue;
+                case Expr_t::IDENTIFIER     : results.push_back(lookup(expr)); pending.pop_back(); continue;
+                default                     : break;
+                }
+
+                // The callee's name and the assigned variable aren't
+                // operands, everything else is
+                pending.back().expanded = true;
+                switch(expr->get_type())
+                {
+                case Expr_t::CALL:
+                case Expr_t::ASSIGN:
+                    pending.push_back({ expr->rhs(), false });
+                break;
+                case Expr_t::NEGATE:
+                    pending.push_back({ expr->lhs(), false });
+                break;
+                default:
+                    pending.push_back({ expr->rhs(), false });
+                    pending.push_back({ expr->lhs(), false });
+                break;
+                }
+            }
+            return results.back();
+        }
+
+        // Folds or simplifies *ref now that its operands are done, and says
+        // what it evaluates to
+        Known FunctionOptimizer::finish(Expression** ref, const Known* operands)
+        {
+            Expression* expr = *ref;
+            switch(expr->get_type())
+            {
+            case Expr_t::ARG:
+                return Known::ANY;
+
+            case Expr_t::CALL:
+            {
+                // print() is always the builtin, whatever else is defined
+                Symbol name = expr->get_lhs()->get_symbol();
+                if(name == Interner::global().known().print)
+                    return Known::ANY;
+                auto found = returns.find(name);
+                return found == returns.end() ? Known::ANY : known_of_type(found->second);
+            }
+
+            case Expr_t::ASSIGN:
+                return expr->get_lhs()->get_type() == Expr_t::IDENTIFIER ? lookup(expr->get_lhs()) : Known::ANY;
+
+            case Expr_t::NEGATE:
+            {
+                Value result;
+                if(is_literal(expr->get_lhs()) && !apply_negate(literal_value(expr->get_lhs()), result))
+                {
+                    *ref = result.kind == Value::INT ? arena.make<Expression>(result.int_value)
+                                                     : arena.make<Expression>(result.flt_value);
+                    stats.folded++;
+                    stats.removed += 1;
+                }
+                return operands[0];
+            }
+
+            default:
+            break;
+            }
+
+            // Binary operators from here on
+            Expression* lhs = *expr->lhs();
+            Expression* rhs = *expr->rhs();
+            Known       known;
+            if(operands[0] == Known::INT && operands[1] == Known::INT)
+                known = Known::INT;
+            else if(is_number(operands[0]) && is_number(operands[1]))
+                known = is_comparison(expr->get_type()) ? Known::INT : Known::FLOAT;
+            else
+                known = Known::ANY;
+
+            Value result;
+            if(is_literal(lhs) && is_literal(rhs) &&
+               !apply_binary(expr->get_type(), literal_value(lhs), literal_value(rhs), result) && result.is_number())
+            {
+                *ref = result.kind == Value::INT ? arena.make<Expression>(result.int_value)
+                                                 : arena.make<Expression>(result.flt_value);
+                stats.folded++;
+                stats.removed += 2;
+                return result.kind == Value::INT ? Known::INT : Known::FLOAT;
+            }
+            if(!lhs || !rhs)
+                return known;
+
+            Expression* kept = nullptr;
+            switch(expr->get_type())
+            {
+            case Expr_t::MUL:
+                kept = is_identity(rhs, 1, operands[0]) ? lhs : is_identity(lhs, 1, operands[1]) ? rhs : nullptr;
+            break;
+            case Expr_t::DIV:
+                kept = is_identity(rhs, 1, operands[0]) ? lhs : nullptr;
+            break;
+            case Expr_t::SUB:
+                kept = is_identity(rhs, 0, operands[0]) ? lhs : nullptr;
+            break;
+            case Expr_t::ADD:
+                if(rhs->get_type() == Expr_t::INT_LITERAL && rhs->get_int() == 0 && operands[0] == Known::INT)
+                    kept = lhs;
+                else if(lhs->get_type() == Expr_t::INT_LITERAL && lhs->get_int() == 0 && operands[1] == Known::INT)
+                    kept = rhs;
+            break;
+            default:
+            break;
+            }
+            if(kept)
+            {
+                *ref = kept;
+                stats.simplified++;
+                stats.removed += 2;
+                return kept == lhs ? operands[0] : operands[1];
+            }
+            return known;
+        }
+
+        Known FunctionOptimizer::lookup(const Expression* name) const
+        {
+            for(size_t i = locals.size(); i > 0; i--)
+                if(locals[i - 1].name == name->get_symbol())
+                    return locals[i - 1].known;
+            return Known::ANY;
+        }
+    }
+
+    OptimizeStats optimize_program(ParseResult& program)
+    {
+        // What calls return is known from the first definition of each
+        // function, a program with two doesn't run anyway
+        std::unordered_map<Symbol, Type_t::Value> returns;
+        for(Declaration* decl = program.root; decl; decl = decl->get_next())
+        {
+            if(decl->get_type() == Type_t::FUNCTION)
+            {
+                auto func = static_cast<FunctionDecl*>(decl);
+                returns.emplace(func->get_name(), func->get_return_type().get_value());
+            }
+        }
+
+        OptimizeStats stats;
+        for(Declaration* decl = program.root; decl; decl = decl->get_next())
+            if(decl->get_type() == Type_t::FUNCTION)
+                FunctionOptimizer(*program.arena, returns, stats).optimize(static_cast<FunctionDecl*>(decl));
+        return stats;
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+#ifndef LANG_OPTIMIZER_H
+#define LANG_OPTIMIZER_H
+
+#include <cstddef>
+
+#include "Declaration.h"
+
+namespace ast {
+    struct OptimizeStats
+    {
+        size_t folded     = 0;  // Operations on constants replaced by their result
+        size_t simplified = 0;  // x*1, x+0 and the like replaced by x
+        size_t pruned     = 0;  // Ifs whose condition is a constant
+        size_t removed    = 0;  // Nodes no longer in the tree, net of the literals added
+    };
+
+    // Shrinks the program's function bodies in place, before anything else
+    // looks at them:
+    //   - operators whose operands are all literals become a literal, with
+    //     exactly the result running them would give. Ones that would fail,
+    //     like dividing by zero, are left to fail at run time.
+    //   - x*1, 1*x, x/1 and x-0 become x when x is known to be a number,
+    //     x+0 and 0+x only when it's an int: -0.0 + 0 is 0.0
+    //   - an if with a literal number as its condition keeps only the
+    //     branch taken. That branch replaces the if unless it declares
+    //     variables, which then stay in a block of their own.
+    // Nothing that would be evaluated is dropped, so calls and assignments
+    // happen just as before. Errors in branches that can never be taken, an
+    // undeclared name say, go away with them.
+    //
+    // New literals come from program.arena, the nodes left out of the tree
+    // stay there until it goes.
+    OptimizeStats optimize_program(ParseResult& program);
+}
+
+#endif
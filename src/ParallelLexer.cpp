@@ -0,0 +1,161 @@
+#include "ParallelLexer.h"
+
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    // The only lexer state that can span a line break is being inside a
+    // string literal; comments always end at the newline
+    enum ScanState { IN_CODE, IN_STRING };
+
+    struct Chunk
+    {
+        size_t    begin;
+        size_t    end;          // One past the newline that ends the chunk
+        size_t    newlines;
+        ScanState exit_from_code;
+
+        size_t    first_line;
+        size_t    status;
+        std::unique_ptr<LexerState> lexer;
+    };
+
+    // Follows only quotes, escapes and comments through [begin, end) using the
+    // same rules as the lexer, to find out what state the chunk ends in
+    ScanState scan_chunk(const char* data, size_t begin, size_t end, ScanState state)
+    {
+        for(size_t i = begin; i < end; i++)
+        {
+            char c = data[i];
+            if(state == IN_STRING)
+            {
+                if(c == '\\' && i + 1 < end)
+                    i++;
+                else if(c == '"')
+                    state = IN_CODE;
+            }
+            else if(c == '"')
+            {
+                state = IN_STRING;
+            }
+            else if(c == '/' && i + 1 < end && data[i + 1] == '/')
+            {
+                const void* newline = memchr(data + i, '\n', end - i);
+                if(newline == nullptr)
+                    break;
+                i = static_cast<const char*>(newline) - data;
+            }
+        }
+        return state;
+    }
+}
+
+size_t tokenize_parallel(LexerState& lexer, ThreadPool& pool, size_t min_chunk_size)
+{
+    const char*  data      = lexer.input_string.data();
+    const size_t input_len = lexer.input_len;
+
+    size_t num_chunks = std::min<size_t>(input_len / std::max<size_t>(min_chunk_size, 1), pool.size() * 4);
+    if(num_chunks < 2 || lexer.on_batch)
+        return lexer.tokenize_string();
+
+    // Cut roughly evenly sized chunks, each ending just after a newline
+    std::vector<Chunk> chunks;
+    size_t chunk_begin = 0;
+    for(size_t i = 1; i <= num_chunks && chunk_begin < input_len; i++)
+    {
+        size_t chunk_end = input_len;
+        if(i < num_chunks)
+        {
+            size_t target = std::max(chunk_begin, input_len * i / num_chunks);
+            const void* newline = memchr(data + target, '\n', input_len - target);
+            chunk_end = newline ? static_cast<const char*>(newline) - data + 1 : input_len;
+        }
+        chunks.push_back({ chunk_begin, chunk_end, 0, IN_CODE, 0, LEX_SUCCESS, nullptr });
+        chunk_begin = chunk_end;
+    }
+
+    pool.parallel_for(chunks.size(), [&](size_t i)
+    {
+        Chunk& chunk = chunks[i];
+        chunk.newlines       = std::count(data + chunk.begin, data + chunk.end, '\n');
+        chunk.exit_from_code = scan_chunk(data, chunk.begin, chunk.end, IN_CODE);
+    });
+
+    // Chunks that would start in the middle of a string literal are folded
+    // into the chunk before them, then every chunk learns its first line
+    std::vector<Chunk> merged;
+    ScanState state = IN_CODE;
+    size_t    line  = 1;
+    for(Chunk& chunk : chunks)
+    {
+        const size_t chunk_newlines = chunk.newlines;
+        if(state == IN_STRING)
+        {
+            Chunk& prev = merged.back();
+            prev.end       = chunk.end;
+            prev.newlines += chunk_newlines;
+            state = scan_chunk(data, chunk.begin, chunk.end, IN_STRING);
+        }
+        else
+        {
+            chunk.first_line = line;
+            state = chunk.exit_from_code;
+            merged.push_back(std::move(chunk));
+        }
+        line += chunk_newlines;
+    }
+
+    pool.parallel_for(merged.size(), [&](size_t i)
+    {
+        Chunk& chunk = merged[i];
+        chunk.lexer = std::make_unique<LexerState>();
+        LexerState& chunk_lexer  = *chunk.lexer;
+        chunk_lexer.input_string = lexer.input_string;
+        chunk_lexer.input_len    = chunk.end;
+        chunk_lexer.tokens.reserve((chunk.end - chunk.begin) / 4 + 1);
+
+        chunk.status = chunk_lexer.tokenize_range(chunk.begin, chunk.first_line, chunk.begin);
+    });
+
+    // Everything after the first error is dropped, just like the sequential lexer
+    size_t last = 0;
+    while(last + 1 < merged.size() && merged[last].status == LEX_SUCCESS)
+        last++;
+
+    LexerState& last_lexer = *merged[last].lexer;
+    last_lexer.insert_token(TOKEN_EOF, std::min(last_lexer.curr_ch_idx, input_len), 0);
+
+    std::vector<size_t> first_token(last + 2, 0);
+    for(size_t i = 0; i <= last; i++)
+        first_token[i + 1] = first_token[i] + merged[i].lexer->tokens.size();
+
+    lexer.tokens.clear();
+    lexer.tokens.resize(first_token[last + 1]);
+    pool.parallel_for(last + 1, [&](size_t i)
+    {
+        const std::vector<Token>& chunk_tokens = merged[i].lexer->tokens;
+        std::copy(chunk_tokens.begin(), chunk_tokens.end(), lexer.tokens.begin() + first_token[i]);
+    });
+
+    // Decoded string literals are referenced by pointer, hand their storage over
+    lexer.escaped_blocks.clear();
+    lexer.escaped_block_used = lexer.escaped_block_size = 0;
+    for(size_t i = 0; i <= last; i++)
+        for(auto& block : merged[i].lexer->escaped_blocks)
+            lexer.escaped_blocks.push_back(std::move(block));
+
+    lexer.curr_ch_idx      = last_lexer.curr_ch_idx;
+    lexer.curr_line_number = last_lexer.curr_line_number;
+    lexer.line_start_idx   = last_lexer.line_start_idx;
+    lexer.curr_char        = last_lexer.curr_char;
+    lexer.error            = last_lexer.error;
+
+    size_t status = merged[last].status;
+    if(status != LEX_SUCCESS && lexer.print_errors)
+        lexer.print_error();
+    return status;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#ifndef LANG_PARALLEL_LEXER_H
+#define LANG_PARALLEL_LEXER_H
+
+#include <cstddef>
+
+#include "Lexer.h"
+#include "ThreadPool.h"
+
+// Lexes lexer.input_string by splitting it into chunks at line boundaries and
+// lexing the chunks concurrently on `pool`, then stitching their tokens back
+// into lexer.tokens. The result is the same token stream (and the same error
+// report) tokenize_string() would produce, with one exception: identifiers
+// are interned concurrently so symbol ids may be numbered differently.
+//
+// Inputs too small to be worth splitting are lexed sequentially.
+size_t tokenize_parallel(LexerState& lexer, ThreadPool& pool, size_t min_chunk_size = 256 * 1024);
+
+#endif
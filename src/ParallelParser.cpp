@@ -0,0 +1,133 @@
+#include "ParallelParser.h"
+#include "ParseProfile.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace ast
+{
+    namespace
+    {
+        // A run of whole top-level declarations, tokens [begin, end)
+        struct Chunk
+        {
+            size_t begin;
+            size_t end;
+
+            ParserState            parser;
+            ParseProfile           profile;     // Only filled in when the parent is profiling
+            std::unique_ptr<Arena> arena;
+            Declaration*           first  = nullptr;
+            Declaration*           last   = nullptr;
+            bool                   failed = false;  // A declaration didn't parse, nothing after it counts
+        };
+
+        void parse_chunk(Chunk& chunk, const ParserState& parent)
+        {
+            ParserState& parser  = chunk.parser;
+            parser.lexer         = parent.lexer;
+            parser.token_stream  = parent.token_stream;
+            parser.curr_token    = chunk.begin;
+            parser.consumed_upto = chunk.begin;
+            parser.status        = PARSE_SUCCESS;
+            parser.profile       = parent.profile ? &chunk.profile : nullptr;
+
+            // Errors are reported at the last token consumed, which for the
+            // sequential parser is the '}' before the chunk
+            parser.curr_line_idx    = parent.curr_line_idx;
+            parser.curr_pos_in_line = parent.curr_pos_in_line;
+            if(chunk.begin > 0)
+            {
+                parser.curr_line_idx    = parser.token_at(chunk.begin - 1).line_number;
+                parser.curr_pos_in_line = parser.token_at(chunk.begin - 1).pos_in_line;
+            }
+
+            chunk.arena   = std::make_unique<Arena>();
+            parser.arena  = chunk.arena.get();
+            while(parser.curr_token < chunk.end)
+            {
+                Declaration* decl = parse_declaration(&parser);
+                if(decl == nullptr)
+                {
+                    chunk.failed = true;
+                    break;
+                }
+                if(chunk.first == nullptr)
+                    chunk.first = decl;
+                else
+                    chunk.last->set_next(decl);
+                chunk.last = decl;
+            }
+            assert(chunk.failed || parser.curr_token == chunk.end);
+            parser.arena = nullptr;
+        }
+    }
+
+    ParseResult parse_program_parallel(ParserState* parser, ThreadPool& pool, size_t min_chunk_tokens)
+    {
+        assert(parser->source == nullptr);
+
+        const Token* tokens = parser->token_stream;
+        const size_t eof    = parser->lexer->tokens.size() - 1;
+
+        size_t num_chunks = std::min<size_t>(eof / std::max<size_t>(min_chunk_tokens, 1), pool.size() * 4);
+        if(num_chunks < 2 || parser->curr_token != 0)
+            return parse_program(parser);
+
+        // Cut at the first declaration boundary past each evenly spaced target
+        std::vector<Chunk> chunks;
+        size_t chunk_begin = 0;
+        for(size_t i = 1; i <= num_chunks && chunk_begin < eof; i++)
+        {
+            size_t target    = std::max(chunk_begin + 1, eof * i / num_chunks);
+            size_t chunk_end = chunk_begin;
+            while(chunk_end < target)
+                chunk_end = find_declaration_end(tokens, chunk_end, eof);
+
+            chunks.push_back({ chunk_begin, chunk_end, {}, {}, nullptr });
+            chunk_begin = chunk_end;
+        }
+
+        pool.parallel_for(chunks.size(), [&](size_t i)
+        {
+            parse_chunk(chunks[i], *parser);
+        });
+
+        // Stitch the chunks together up to the first declaration that failed,
+        // the sequential parser would have stopped there
+        ParseResult result;
+        result.arena = std::make_unique<Arena>();
+
+        Declaration* last_decl = nullptr;
+        for(Chunk& chunk : chunks)
+        {
+            ParserState& chunk_parser = chunk.parser;
+            parser->errors.insert(parser->errors.end(), chunk_parser.errors.begin(), chunk_parser.errors.end());
+            if(parser->status == PARSE_SUCCESS)
+                parser->status = chunk_parser.status;
+            parser->num_nodes       += chunk_parser.num_nodes;
+            parser->num_rewinds     += chunk_parser.num_rewinds;
+            if(parser->profile)
+                parser->profile->merge(chunk.profile);
+            parser->curr_token       = chunk_parser.curr_token;
+            parser->consumed_upto    = chunk_parser.consumed_upto;
+            parser->curr_line_idx    = chunk_parser.curr_line_idx;
+            parser->curr_pos_in_line = chunk_parser.curr_pos_in_line;
+
+            result.arena->adopt(*chunk.arena);
+            if(chunk.first)
+            {
+                if(result.root == nullptr)
+                    result.root = chunk.first;
+                else
+                    last_decl->set_next(chunk.first);
+                last_decl = chunk.last;
+            }
+            if(chunk.failed)
+                break;
+        }
+        return result;
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+#ifndef LANG_PARALLEL_PARSER_H
+#define LANG_PARALLEL_PARSER_H
+
+#include <cstddef>
+
+#include "Declaration.h"
+#include "ThreadPool.h"
+
+namespace ast
+{
+    // Does what parse_program() does, but over the whole token stream at
+    // once: a quick pass over the tokens finds where each top-level function
+    // ends by matching up its braces, runs of whole functions are parsed
+    // concurrently on `pool` and the results put back together in source
+    // order. The tree, the errors and parser->status come out the same as
+    // parse_program() would leave them.
+    //
+    // `parser` must be reading lexer.tokens directly, not a TokenSource.
+    // Streams too short to be worth splitting are parsed sequentially.
+    ParseResult parse_program_parallel(ParserState* parser, ThreadPool& pool, size_t min_chunk_tokens = 32 * 1024);
+}
+
+#endif
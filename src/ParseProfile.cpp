@@ -0,0 +1,54 @@
+#include "ParseProfile.h"
+
+#include <inttypes.h>
+
+const char* production_name(Production production)
+{
+    static const char* const names[] = {
+        "declaration", "function_decl", "block", "statement", "if_statement", "var_decl", "return_statement",
+        "expression", "atom", "func_call",
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == (size_t) Production::COUNT, "a production is missing its name");
+    return names[(size_t) production];
+}
+
+void ParseProfile::merge(const ParseProfile& other)
+{
+    for(size_t i = 0; i < stats.size(); i++)
+    {
+        stats[i].calls       += other.stats[i].calls;
+        stats[i].tokens      += other.stats[i].tokens;
+        stats[i].rewinds     += other.stats[i].rewinds;
+        stats[i].nanoseconds += other.stats[i].nanoseconds;
+    }
+}
+
+void ParseProfile::print_table(FILE* out) const
+{
+    fprintf(out, "    %-18s %12s %12s %10s %10s %10s %10s\n",
+            "production", "calls", "tokens", "tok/call", "rewinds", "ms", "ns/call");
+    for(size_t i = 0; i < stats.size(); i++)
+    {
+        const ProductionStats& s = stats[i];
+        fprintf(out, "    %-18s %12" PRIu64 " %12" PRIu64 " %10.2f %10" PRIu64 " %10.3f %10.1f\n",
+                production_name((Production) i), s.calls, s.tokens,
+                s.calls ? (double) s.tokens / s.calls : 0.0, s.rewinds,
+                s.nanoseconds / 1e6, s.calls ? (double) s.nanoseconds / s.calls : 0.0);
+    }
+}
+
+std::string ParseProfile::to_json() const
+{
+    std::string json = "{";
+    for(size_t i = 0; i < stats.size(); i++)
+    {
+        const ProductionStats& s = stats[i];
+        char entry[256];
+        snprintf(entry, sizeof(entry),
+                 "%s\"%s\": { \"calls\": %" PRIu64 ", \"tokens\": %" PRIu64 ", \"rewinds\": %" PRIu64 ", \"seconds\": %.9f }",
+                 i ? ", " : " ", production_name((Production) i), s.calls, s.tokens, s.rewinds, s.nanoseconds / 1e9);
+        json += entry;
+    }
+    json += " }";
+    return json;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#ifndef LANG_PARSE_PROFILE_H
+#define LANG_PARSE_PROFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+#include "Parser.h"
+
+// Grammar rules the parser keeps counts for when profiling. Atoms and calls
+// are parsed inside parse_expression()'s loop rather than by functions of
+// their own, but they're still timed from their first token to their last.
+enum class Production : uint8_t
+{
+    DECLARATION, FUNCTION_DECL, BLOCK, STATEMENT, IF_STATEMENT, VAR_DECL, RETURN_STATEMENT,
+    EXPRESSION, ATOM, FUNC_CALL,
+    COUNT
+};
+
+const char* production_name(Production production);
+
+// Tokens, rewinds and time include whatever was parsed inside the
+// production. One nested in itself, like a block in a block, only counts
+// them for the outermost instance, so no production adds up to more than
+// the whole parse. Calls count every instance.
+struct ProductionStats
+{
+    uint64_t calls       = 0;
+    uint64_t tokens      = 0;
+    uint64_t rewinds     = 0;
+    uint64_t nanoseconds = 0;
+};
+
+// Filled in by the parser while ParserState::profile points at it. Costs a
+// clock read at either end of every production, so profiled parses are
+// noticeably slower than unprofiled ones; leaving profile null costs a
+// branch per production.
+struct ParseProfile
+{
+    std::array<ProductionStats, (size_t) Production::COUNT> stats  = {};
+    std::array<uint32_t, (size_t) Production::COUNT>        active = {};  // Instances currently being parsed
+
+    const ProductionStats& operator[](Production production) const { return stats[(size_t) production]; }
+
+    void merge(const ParseProfile& other);
+
+    void        print_table(FILE* out) const;
+    std::string to_json() const;    // One object keyed by production name
+};
+
+// Where a production started, see profile_begin()
+struct ProfileMark
+{
+    uint64_t start_ns;
+    size_t   start_token;
+    size_t   start_rewinds;
+};
+
+inline uint64_t profile_clock()
+{
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Only call these with parser->profile set, every begin needs its end
+inline ProfileMark profile_begin(const ParserState* parser, Production production)
+{
+    parser->profile->active[(size_t) production]++;
+    return { profile_clock(), parser->curr_token, parser->num_rewinds };
+}
+
+inline void profile_end(const ParserState* parser, Production production, const ProfileMark& mark)
+{
+    ProductionStats& stats = parser->profile->stats[(size_t) production];
+    stats.calls++;
+    if(--parser->profile->active[(size_t) production] > 0)
+        return;
+    stats.tokens      += parser->curr_token  - mark.start_token;
+    stats.rewinds     += parser->num_rewinds - mark.start_rewinds;
+    stats.nanoseconds += profile_clock()     - mark.start_ns;
+}
+
+// Profiles the enclosing function as `production`
+class ProfileScope
+{
+    public:
+        ProfileScope(const ParserState* parser, Production production):
+            parser(parser), production(production)
+        {
+            if(parser->profile)
+                mark = profile_begin(parser, production);
+        }
+        ~ProfileScope()
+        {
+            if(parser->profile)
+                profile_end(parser, production, mark);
+        }
+
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+    private:
+        const ParserState* parser;
+        Production         production;
+        ProfileMark        mark = {};
+};
+
+#endif
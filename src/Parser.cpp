@@ -7,7 +7,7 @@
 
 bool match_token(ParserState* parser, enum TokenType type)
 {
-    return parser->curr_token != NULL && parser->curr_token->type == type;
+    return parser->current().type == type;
 }
 
 void ParserState::emit_error(const std::string& message)
@@ -17,29 +17,73 @@ void ParserState::emit_error(const std::string& message)
 
 bool ParserState::match_token(enum TokenType type)
 {
-    return curr_token-> type != TOKEN_EOF && curr_token->type == type;
+    return current().type != TOKEN_EOF && current().type == type;
 }
 
 bool ParserState::get_next_token()
 {
-    if(curr_token->type != TOKEN_EOF) 
+    if(current().type != TOKEN_EOF) 
     {
-        curr_line_idx    = curr_token->line_number;
-        curr_pos_in_line = curr_token->pos_in_line;
-        curr_token       = curr_token->next;
+        if(curr_token < consumed_upto)
+            num_rewinds++;
+
+        curr_line_idx    = current().line_number;
+        curr_pos_in_line = current().pos_in_line;
+        curr_token++;
+        consumed_upto = curr_token;
+
+        if(source && curr_token - window_begin == window.size())
+        {
+            source->next_batch(window);
+            token_stream = window.data();
+        }
         return true;
     }
     return false;
 }
 
-bool get_next_token (ParserState* parser)
+const Token& ParserState::peek(size_t k)
 {
-    if(parser->curr_token->type != TOKEN_EOF) 
+    size_t idx = curr_token;
+    for(size_t i = 0; i < k && token_at(idx).type != TOKEN_EOF; i++)
     {
-        parser->curr_line_idx    = parser->curr_token->line_number;
-        parser->curr_pos_in_line = parser->curr_token->pos_in_line;
-        parser->curr_token       = parser->curr_token->next;
-        return true;
+        idx++;
+        if(source && idx - window_begin == window.size())
+        {
+            source->next_batch(window);
+            token_stream = window.data();
+        }
     }
-    return false;
+    return token_at(idx);
+}
+
+void ParserState::attach_source(TokenSource* token_source, size_t first_token)
+{
+    source        = token_source;
+    curr_token    = first_token;
+    consumed_upto = first_token;
+    window_begin  = first_token;
+    window.clear();
+
+    source->next_batch(window);
+    token_stream = window.data();
+}
+
+// Drops the tokens before the current one from the window. The parser only
+// ever looks ahead of the current token so this is safe at any point, it's
+// called in between top-level declarations to keep it out of the inner loops.
+void ParserState::discard_consumed()
+{
+    size_t consumed = curr_token - window_begin;
+    if(!source || consumed < window.size() / 2)
+        return;
+
+    window.erase(window.begin(), window.begin() + consumed);
+    window_begin = curr_token;
+    token_stream = window.data();
+}
+
+bool get_next_token (ParserState* parser)
+{
+    return parser->get_next_token();
 }
@@ -3,7 +3,10 @@
 #define LANG_PARSER_H
 
 #include "Lexer.h"
+#include "Arena.h"
 #include <cstddef>
+#include <memory>
+#include <utility>
 #include <vector>
 
 enum lex_error_t {
@@ -32,22 +35,72 @@ enum parse_status_t
     PARSE_ERR_INVALID_TYPE , PARSE_ERR_INVALID_DECL   , PARSE_ERR_INVALID_PARAM   ,
 };
 
+struct ParseProfile;
+
+// Supplies tokens to the parser a batch at a time for when the whole stream
+// isn't available up front, e.g. while it is still being lexed
+struct TokenSource
+{
+    // Appends the next batch to `window`, the final batch ends with TOKEN_EOF
+    virtual void next_batch(std::vector<Token>& window) = 0;
+    virtual ~TokenSource() = default;
+};
+
 struct ParserState
 {
-    Token* token_stream;
-    Token* curr_token;
+    const LexerState* lexer;
+    const Token* token_stream;
+    size_t       curr_token;   // Index of the current token within the whole stream
 
     size_t curr_line_idx;
     size_t curr_pos_in_line;
     parse_status_t status; 
 
+    // Only used when pulling from a TokenSource, `window` then holds the
+    // tokens with stream indices [window_begin, window_begin + window.size())
+    TokenSource*       source       = nullptr;
+    std::vector<Token> window       = {};
+    size_t             window_begin = 0;
+
+    const Token& current() const              { return token_stream[curr_token - window_begin]; }
+    const Token& token_at(size_t idx) const   { return token_stream[idx - window_begin]; }
+    std::string_view lexeme(size_t idx) const { return lexer->lexeme(token_at(idx)); }
+
+    // The token k places after the current one, or TOKEN_EOF if the stream
+    // ends before that. May pull in another batch from `source`, so any
+    // reference to a token from before the call can't be used after it.
+    const Token& peek(size_t k);
+
     void emit_error(const std::string& message);
     bool match_token(enum TokenType);
     bool get_next_token();
 
+    // `first_token` is the stream index of the first token the source hands out
+    void attach_source(TokenSource* token_source, size_t first_token = 0);
+    void discard_consumed();
+
     std::vector<ErrorMessage> errors;
+    size_t num_nodes = 0;   // AST nodes created so far
+
+    // Times the parser went back to a token it had already moved past. The
+    // grammar is decided with peek() up front so this should stay at zero.
+    size_t num_rewinds   = 0;
+    size_t consumed_upto = 0;   // curr_token as of the last get_next_token()
+
+    Arena* arena = nullptr; // Where nodes are allocated, owned by the ParseResult
+
+    ParseProfile* profile = nullptr;    // Counts per grammar rule go here when set, see ParseProfile.h
 };
 
+// Every AST node the parser creates goes through here. Nodes only ever point
+// at each other, they're never freed individually.
+template<typename T, typename... Args>
+T* make_node(ParserState* parser, Args&&... args)
+{
+    parser->num_nodes++;
+    return parser->arena->make<T>(std::forward<Args>(args)...);
+}
+
 bool match_token     (ParserState*, enum TokenType);
 bool get_next_token  (ParserState*);
 
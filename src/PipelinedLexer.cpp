@@ -0,0 +1,45 @@
+#include "PipelinedLexer.h"
+
+void PipelinedLexer::start()
+{
+    lexer.batch_size = batch_size;
+    lexer.on_batch   = [this](Batch& batch)
+    {
+        filled.push(batch);
+        if(!recycled.try_pop(batch))
+            batch = Batch();
+        batch.clear();
+        batch.reserve(batch_size);
+    };
+    thread = std::thread([this]() { status = lexer.tokenize_string(); });
+}
+
+size_t PipelinedLexer::finish()
+{
+    if(!thread.joinable())
+        return status;
+
+    // The parser may give up early, drain what is left so the lexer isn't
+    // stuck waiting for room in the ring
+    Batch batch;
+    while(!reached_eof)
+    {
+        filled.pop(batch);
+        reached_eof = !batch.empty() && batch.back().type == TOKEN_EOF;
+    }
+    thread.join();
+    lexer.on_batch = nullptr;
+    return status;
+}
+
+void PipelinedLexer::next_batch(std::vector<Token>& window)
+{
+    Batch batch;
+    filled.pop(batch);
+    reached_eof = !batch.empty() && batch.back().type == TOKEN_EOF;
+    window.insert(window.end(), batch.begin(), batch.end());
+
+    // If the lexer already has enough spare batches this one is simply freed
+    batch.clear();
+    recycled.try_push(batch);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#ifndef LANG_PIPELINED_LEXER_H
+#define LANG_PIPELINED_LEXER_H
+
+#include <thread>
+#include <vector>
+
+#include "Lexer.h"
+#include "Parser.h"
+#include "TokenQueue.h"
+
+// Runs the lexer on its own thread and feeds its tokens to the parser in
+// batches over a lock-free ring. The ring only holds a fixed number of
+// batches, once it is full the lexer waits for the parser to catch up so
+// memory stays bounded no matter how large the input is.
+class PipelinedLexer : public TokenSource
+{
+    public:
+        PipelinedLexer(LexerState& lexer, size_t batch_size = 4096):
+            lexer(lexer), batch_size(batch_size) { }
+        ~PipelinedLexer() { finish(); }
+
+        void   start();
+        size_t finish();    // Waits for the lexer thread, returns its LexerError
+
+        void next_batch(std::vector<Token>& window) override;
+    private:
+        using Batch = std::vector<Token>;
+
+        LexerState& lexer;
+        size_t      batch_size;
+        size_t      status      = LEX_SUCCESS;
+        bool        reached_eof = false;
+        std::thread thread;
+
+        SpscRing<Batch, 8> filled;      // lexer -> parser
+        SpscRing<Batch, 8> recycled;    // parser -> lexer, spent batches to reuse
+};
+
+#endif
@@ -0,0 +1,195 @@
+#include "Resolver.h"
+
+#include <algorithm>
+
+#include "Statement.h"
+
+namespace ast {
+    namespace
+    {
+        class FunctionResolver
+        {
+            public:
+                FunctionResolver(Resolution& resolution, ResolvedFunction& func, FunctionDecl* decl):
+                    resolution(resolution), func(func), decl(decl) { }
+
+                void resolve();
+            private:
+                struct Local
+                {
+                    Symbol   name;
+                    uint32_t slot;
+                };
+
+                void     resolve_block(Statement* stmts);
+                void     resolve_expression(Expression* root);
+                uint32_t declare(Symbol name, Type_t::Value type);
+                uint32_t lookup(Symbol name) const;
+                void     report(Symbol name, const char* format);
+
+                Resolution&       resolution;
+                ResolvedFunction& func;
+                FunctionDecl*     decl;             // func.decl, which the slots are written into
+
+                std::vector<Local>  locals;         // Innermost last
+                std::vector<Symbol> reported;       // Each missing name is only reported once per function
+        };
+
+        void FunctionResolver::resolve()
+        {
+            for(ParameterNode* param = decl->get_params(); param; param = *param->get_next())
+            {
+                param->set_slot(declare(param->get_name(), param->get_type().get_value()));
+                func.num_params++;
+            }
+            if(if_depth(decl->get_body()) > MAX_IF_DEPTH)
+            {
+                std::string_view name = Interner::global().name(decl->get_name());
+                resolution.errors.push_back("ifs nested too deeply in " + std::string(name) + "()");
+                func.too_deep = true;
+                return;
+            }
+            resolve_block(*decl->body_ref());
+        }
+
+        // Names declared in a block aren't visible after it. Their slots
+        // aren't reused, each declaration keeps its own type in slot_types.
+        void FunctionResolver::resolve_block(Statement* stmts)
+        {
+            size_t num_locals = locals.size();
+            for(Statement* stmt = stmts; stmt; stmt = stmt->next)
+            {
+                switch(stmt->get_type())
+                {
+                case Stmt_t::EXPR:
+                case Stmt_t::RETURN:
+                    resolve_expression(*static_cast<ExprStatement*>(stmt)->expr_ref());
+                break;
+
+                case Stmt_t::DECL:
+                {
+                    // The initialiser can't see the variable it initialises
+                    VariableDecl* var = static_cast<VarDeclStatement*>(stmt)->get_decl();
+                    resolve_expression(*var->expr_ref());
+                    var->set_slot(declare(var->get_name(), var->get_type().get_value()));
+                }
+                break;
+
+                case Stmt_t::IF:
+                {
+                    auto if_stmt = static_cast<IfStatement*>(stmt);
+                    resolve_expression(*if_stmt->condition_ref());
+                    resolve_block(*if_stmt->body_ref());
+                    resolve_block(*if_stmt->else_ref());
+                }
+                break;
+
+                default:
+                break;
+                }
+            }
+            locals.resize(num_locals);
+        }
+
+        // Expressions can nest far deeper than the native stack would like,
+        // so this keeps its own. Nothing in an expression declares anything,
+        // the order names are visited in only matters for the errors.
+        void FunctionResolver::resolve_expression(Expression* root)
+        {
+            std::vector<Expression*> pending = { root };
+            while(!pending.empty())
+            {
+                Expression* expr = pending.back();
+                pending.pop_back();
+                if(!expr)
+                    continue;
+
+                if(expr->get_type() == Expr_t::IDENTIFIER)
+                {
+                    uint32_t slot = lookup(expr->get_symbol());
+                    if(slot == NO_SLOT)
+                        report(expr->get_symbol(), "%.*s isn't declared in %.*s()");
+                    expr->set_slot(slot);
+                    continue;
+                }
+                if(expr->get_type() == Expr_t::CALL)
+                {
+                    // The callee's name isn't a variable, only the arguments
+                    // are looked at further
+                    Symbol   name  = expr->get_lhs()->get_symbol();
+                    uint32_t index = name == Interner::global().known().print ? PRINT_BUILTIN : resolution.find(name);
+                    if(index == UINT32_MAX)
+                    {
+                        report(name, "there's no function %.*s() to call in %.*s()");
+                        index = NO_SLOT;
+                    }
+                    expr->set_slot(index);
+                    pending.push_back(*expr->rhs());
+                    continue;
+                }
+                pending.push_back(*expr->rhs());
+                pending.push_back(*expr->lhs());
+            }
+        }
+
+        uint32_t FunctionResolver::declare(Symbol name, Type_t::Value type)
+        {
+            uint32_t slot = func.num_slots++;
+            locals.push_back({ name, slot });
+            func.slot_types.push_back(type);
+            return slot;
+        }
+
+        uint32_t FunctionResolver::lookup(Symbol name) const
+        {
+            for(size_t i = locals.size(); i > 0; i--)
+                if(locals[i - 1].name == name)
+                    return locals[i - 1].slot;
+            return NO_SLOT;
+        }
+
+        void FunctionResolver::report(Symbol name, const char* format)
+        {
+            if(std::find(reported.begin(), reported.end(), name) != reported.end())
+                return;
+            reported.push_back(name);
+
+            std::string_view missing  = Interner::global().name(name);
+            std::string_view function = Interner::global().name(decl->get_name());
+            char message[512];
+            snprintf(message, sizeof(message), format, (int) missing.size(), missing.data(),
+                     (int) function.size(), function.data());
+            resolution.errors.push_back(message);
+        }
+    }
+
+    Resolution resolve_program(Declaration* root)
+    {
+        // Every function gets its index first so calls can refer to ones
+        // defined further down
+        Resolution                 resolution;
+        std::vector<FunctionDecl*> defined;     // Same order as resolution.functions
+        for(Declaration* decl = root; decl; decl = decl->get_next())
+        {
+            if(!(decl->get_type() == Type_t::FUNCTION))
+                continue;
+            auto func = static_cast<FunctionDecl*>(decl);
+            if(resolution.by_name.emplace(func->get_name(), (uint32_t) resolution.functions.size()).second)
+            {
+                ResolvedFunction resolved;
+                resolved.decl = func;
+                resolution.functions.push_back(std::move(resolved));
+                defined.push_back(func);
+            }
+            else
+            {
+                std::string_view name = Interner::global().name(func->get_name());
+                resolution.errors.push_back(std::string(name) + "() is defined more than once");
+            }
+        }
+
+        for(size_t i = 0; i < defined.size(); i++)
+            FunctionResolver(resolution, resolution.functions[i], defined[i]).resolve();
+        return resolution;
+    }
+}
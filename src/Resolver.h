@@ -0,0 +1,53 @@
+#pragma once
+#ifndef LANG_RESOLVER_H
+#define LANG_RESOLVER_H
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Declaration.h"
+
+namespace ast {
+    // The callee of a call to the print() builtin
+    constexpr uint32_t PRINT_BUILTIN = UINT32_MAX - 1;
+
+    struct ResolvedFunction
+    {
+        const FunctionDecl*        decl;
+        uint32_t                   num_params = 0;
+        uint32_t                   num_slots  = 0;  // Parameters first, then every variable declaration
+        std::vector<Type_t::Value> slot_types;      // What each slot's values are converted to
+        bool                       too_deep   = false;  // Ifs nest past MAX_IF_DEPTH, the body is left alone
+    };
+
+    struct Resolution
+    {
+        std::vector<ResolvedFunction>        functions;    // The first definition of each name, in order
+        std::unordered_map<Symbol, uint32_t> by_name;      // Index into functions
+        std::vector<std::string>             errors;       // Names that can't be bound, functions defined twice
+
+        uint32_t find(Symbol name) const
+        {
+            auto found = by_name.find(name);
+            return found == by_name.end() ? UINT32_MAX : found->second;
+        }
+    };
+
+    // Binds every name in the program's functions once, before anything
+    // runs. Parameters and variables get a slot in their function's frame,
+    // which every use of them is given through set_slot(), and calls are
+    // given the index of the function they call. Nothing is left to look up
+    // by name at run time.
+    //
+    // Functions don't nest and variables outside of them aren't visible
+    // inside, so a frame only ever holds one function's names and a slot
+    // index is all a use needs.
+    //
+    // A function whose ifs nest deeper than MAX_IF_DEPTH is reported as an
+    // error and its body isn't looked at, nor compiled.
+    Resolution resolve_program(Declaration* root);
+}
+
+#endif
@@ -0,0 +1,84 @@
+#include "SourceFile.h"
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <string.h>
+
+#if defined(_WIN32)
+    #include <io.h>
+    #define LANG_HAS_MMAP 0
+#else
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #define LANG_HAS_MMAP 1
+#endif
+
+bool SourceFile::load(const char* path)
+{
+    release();
+
+    bool from_stdin = strcmp(path, "-") == 0;
+    int  fd         = from_stdin ? 0 : open(path, O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    bool loaded = false;
+#if LANG_HAS_MMAP
+    struct stat info;
+    if(!from_stdin && fstat(fd, &info) == 0 && S_ISREG(info.st_mode))
+    {
+        if(info.st_size == 0)
+        {
+            loaded = true;
+        }
+        else
+        {
+            void* addr = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(addr != MAP_FAILED)
+            {
+                madvise(addr, (size_t) info.st_size, MADV_SEQUENTIAL);
+                data   = static_cast<const char*>(addr);
+                size   = (size_t) info.st_size;
+                mapped = true;
+                loaded = true;
+            }
+        }
+    }
+#endif
+    if(!loaded)
+        loaded = read_into_buffer(fd);
+
+    if(!from_stdin)
+        close(fd);
+    return loaded;
+}
+
+bool SourceFile::read_into_buffer(int fd)
+{
+    char chunk[1 << 16];
+    while(true)
+    {
+        auto bytes_read = read(fd, chunk, sizeof(chunk));
+        if(bytes_read < 0)
+            return false;
+        if(bytes_read == 0)
+            break;
+        buffer.append(chunk, (size_t) bytes_read);
+    }
+    data = buffer.data();
+    size = buffer.size();
+    return true;
+}
+
+void SourceFile::release()
+{
+#if LANG_HAS_MMAP
+    if(mapped)
+        munmap(const_cast<char*>(data), size);
+#endif
+    buffer = {};
+    data   = nullptr;
+    size   = 0;
+    mapped = false;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#ifndef LANG_SOURCE_FILE_H
+#define LANG_SOURCE_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read-only view of a program's source text. Regular files are mapped into
+// memory directly, anything that cannot be mapped (pipes, stdin, platforms
+// without mmap) is read into an owned buffer instead. Either way the lexer
+// only ever sees the view, so no copies are made after loading.
+class SourceFile
+{
+    public:
+        SourceFile() = default;
+        SourceFile(const SourceFile&) = delete;
+        SourceFile& operator=(const SourceFile&) = delete;
+        ~SourceFile() { release(); }
+
+        // Passing "-" as the path reads from stdin
+        bool load(const char* path);
+        void release();
+
+        std::string_view view() const { return std::string_view(data, size); }
+        bool is_mapped() const        { return mapped; }
+    private:
+        bool read_into_buffer(int fd);
+
+        const char* data   = nullptr;
+        std::size_t size   = 0;
+        bool        mapped = false;
+        std::string buffer = {};
+};
+
+#endif
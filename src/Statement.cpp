@@ -1,26 +1,51 @@
 #include "Statement.h"
+#include "ParseProfile.h"
 #include <stdlib.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 namespace ast 
 {
-    std::unique_ptr<Statement> parse_statement(ParserState* parser)
+    namespace
     {
-        std::unique_ptr<Statement> stmt = nullptr;
+        // A block or an if still waiting on a nested statement or block,
+        // these used to be recursive calls
+        enum class Pending : uint8_t { BLOCK, SINGLE, IF_BODY, IF_ELSE };
 
-        if (parser->match_token(KEYWORD_IF))
-            stmt = ast::parse_if_statement(parser);
-        else if (parser->match_token(KEYWORD_RETURN))
-            stmt = ast::parse_return_statement(parser);
-        else
+        struct Frame
         {
-            stmt = parse_var_decl_statement(parser);
-            std::unique_ptr<Expression> expr = nullptr; 
-            
-            // If this wasn't a declaration maybe it is an expression
-            if (!stmt)
+            Pending     kind;
+            Statement*  stmts     = nullptr;    // BLOCK: statements so far
+            Statement*  last      = nullptr;    // BLOCK: the one the next is linked after
+            Expression* condition = nullptr;    // IF_*
+            Statement*  body      = nullptr;    // IF_ELSE
+            ProfileMark mark      = {};         // When profiling: BLOCK/SINGLE of the block, IF_* of the statement
+            ProfileMark if_mark   = {};         // IF_*: of the if statement inside it
+        };
+
+        // Where parse_nested() is at with the frame on top of the stack
+        enum class Step { BLOCK, BRACED, STATEMENT, DELIVER };
+
+        // Anything but an if, which is the only statement that nests
+        Statement* parse_simple_statement(ParserState* parser)
+        {
+            if (parser->match_token(KEYWORD_RETURN))
+                return ast::parse_return_statement(parser);
+
+            // IDENTIFIER ':' can only start a declaration, anything else has
+            // to be an expression
+            Statement* stmt = nullptr;
+            if (parser->match_token(TOKEN_IDENTIFIER) && parser->peek(1).type == TOKEN_COLON)
             {
-                expr = ast::parse_expression(parser);
-                stmt = std::make_unique<ExprStatement>(false, expr.release());
+                stmt = parse_var_decl_statement(parser);
+                if (!stmt)
+                    return nullptr;
+            }
+            else
+            {
+                Expression* expr = ast::parse_expression(parser);
+                stmt = make_node<ExprStatement>(parser, false, expr);
             }
 
             if (!parser->match_token(TOKEN_SEMICOLON))
@@ -29,63 +54,175 @@ namespace ast
                 return nullptr;
             }
             parser->get_next_token();
+            return stmt;
         }
-        return stmt;
-    }
 
-    std::unique_ptr<Statement> parse_block(ParserState* parser, bool require_braces)
-    {
-        bool begins_with_left_cbrack = parser->match_token(TOKEN_LEFT_CBRACK);
+        //   Block     := '{' Statement* '}' | Statement
+        //   Statement := 'if' Expr Block ('else' Block)? | Simple
+        //
+        // Nested ifs are kept on an explicit stack, like the levels of
+        // parse_expression(), so any depth of them parses in constant stack
+        // space. Builds the same nodes in the same order and reports the
+        // same errors as the recursive version did, including carrying on
+        // with an if whose block failed to parse.
+        Statement* parse_nested(ParserState* parser, Step step, bool require_braces)
+        {
+            // This never calls back into itself, so one stack per thread is
+            // reused rather than allocating for every function body
+            thread_local std::vector<Frame> stack;
+            stack.clear();
 
-        if (require_braces && !begins_with_left_cbrack)
-            return nullptr;
+            Statement* value = nullptr;
+            while(true)
+            {
+                switch(step)
+                {
+                case Step::BLOCK:
+                {
+                    Frame block { Pending::BLOCK };
+                    if(parser->profile)
+                        block.mark = profile_begin(parser, Production::BLOCK);
 
-        if (begins_with_left_cbrack)
-        {
-            parser->get_next_token();
+                    if(parser->match_token(TOKEN_LEFT_CBRACK))
+                    {
+                        parser->get_next_token();
+                        stack.push_back(block);
+                        step = Step::BRACED;
+                    }
+                    else if(require_braces)
+                    {
+                        if(parser->profile)
+                            profile_end(parser, Production::BLOCK, block.mark);
+                        value = nullptr;
+                        step  = Step::DELIVER;
+                    }
+                    else
+                    {
+                        block.kind = Pending::SINGLE;
+                        stack.push_back(block);
+                        step = Step::STATEMENT;
+                    }
+                    require_braces = false;
+                }
+                break;
 
-            std::unique_ptr<Statement>  stmts     = NULL;
-            std::unique_ptr<Statement>* curr_stmt = &stmts;
+                case Step::BRACED:
+                {
+                    if(!parser->match_token(TOKEN_RIGHT_CBRACK))
+                    {
+                        step = Step::STATEMENT;
+                        break;
+                    }
+                    parser->get_next_token();
+                    value = stack.back().stmts;
+                    if(parser->profile)
+                        profile_end(parser, Production::BLOCK, stack.back().mark);
+                    stack.pop_back();
+                    step = Step::DELIVER;
+                }
+                break;
 
-            while (!parser->match_token(TOKEN_RIGHT_CBRACK))
-            {
-                std::unique_ptr<Statement> stmt = ast::parse_statement(parser);
-                if (stmt == nullptr)
+                case Step::STATEMENT:
                 {
-                    parser->emit_error("No statement!\n");
-                    return nullptr;
+                    ProfileMark mark = {};
+                    if(parser->profile)
+                        mark = profile_begin(parser, Production::STATEMENT);
+
+                    if(!parser->match_token(KEYWORD_IF))
+                    {
+                        value = parse_simple_statement(parser);
+                        if(parser->profile)
+                            profile_end(parser, Production::STATEMENT, mark);
+                        step = Step::DELIVER;
+                        break;
+                    }
+
+                    Frame if_stmt { Pending::IF_BODY };
+                    if_stmt.mark = mark;
+                    if(parser->profile)
+                        if_stmt.if_mark = profile_begin(parser, Production::IF_STATEMENT);
+                    parser->get_next_token(); // consume 'if'
+                    if_stmt.condition = ast::parse_expression(parser);
+                    stack.push_back(if_stmt);
+                    step = Step::BLOCK;
+                }
+                break;
+
+                case Step::DELIVER:
+                {
+                    if(stack.empty())
+                        return value;
+
+                    Frame& top = stack.back();
+                    switch(top.kind)
+                    {
+                    case Pending::BLOCK:
+                        if(value == nullptr)
+                        {
+                            parser->emit_error("No statement!\n");
+                            if(parser->profile)
+                                profile_end(parser, Production::BLOCK, top.mark);
+                            stack.pop_back();
+                            break;
+                        }
+                        if(top.last)
+                            top.last->next = value;
+                        else
+                            top.stmts = value;
+                        top.last = value;
+                        step     = Step::BRACED;
+                    break;
+
+                    case Pending::SINGLE:
+                        if(parser->profile)
+                            profile_end(parser, Production::BLOCK, top.mark);
+                        stack.pop_back();
+                    break;
+
+                    case Pending::IF_BODY:
+                    case Pending::IF_ELSE:
+                        if(top.kind == Pending::IF_BODY && parser->match_token(KEYWORD_ELSE))
+                        {
+                            parser->get_next_token();
+                            top.kind = Pending::IF_ELSE;
+                            top.body = value;
+                            step     = Step::BLOCK;
+                            break;
+                        }
+                        if(top.kind == Pending::IF_BODY)
+                            value = make_node<IfStatement>(parser, top.condition, value, nullptr);
+                        else
+                            value = make_node<IfStatement>(parser, top.condition, top.body, value);
+                        if(parser->profile)
+                        {
+                            profile_end(parser, Production::IF_STATEMENT, top.if_mark);
+                            profile_end(parser, Production::STATEMENT, top.mark);
+                        }
+                        stack.pop_back();
+                    break;
+                    }
+                }
+                break;
                 }
-                *curr_stmt = std::move(stmt);
-                 curr_stmt = &(*curr_stmt)->next;
-            }
-            if (!match_token(parser, TOKEN_RIGHT_CBRACK))
-            {
-                parser->emit_error("No matching right bracket!\n");
-                return nullptr;
             }
-            parser->get_next_token();
-            return stmts;
         }
-        return ast::parse_statement(parser);
     }
-    std::unique_ptr<Statement> parse_if_statement(ParserState* parser)
+
+    Statement* parse_statement(ParserState* parser)
     {
-        parser->get_next_token(); // consume 'if'
-        std::unique_ptr<Expression> condition = ast::parse_expression(parser);
-        std::unique_ptr<Statement > block     = ast::parse_block(parser, false);
-        std::unique_ptr<Statement > else_blk  = nullptr;
+        return parse_nested(parser, Step::STATEMENT, false);
+    }
 
-        if(parser->match_token(KEYWORD_ELSE))
-        {
-            parser->get_next_token();
-            else_blk = ast::parse_block(parser, false);
-        }
-        return std::make_unique<IfStatement>(condition.release(), block.release(), else_blk.release());
+    Statement* parse_block(ParserState* parser, bool require_braces)
+    {
+        return parse_nested(parser, Step::BLOCK, require_braces);
     }
-    std::unique_ptr<Statement> parse_return_statement(ParserState* parser)
+
+    Statement* parse_return_statement(ParserState* parser)
     {
+        ProfileScope profile(parser, Production::RETURN_STATEMENT);
         parser->get_next_token();
-        std::unique_ptr<Expression> ret_expr = ast::parse_expression(parser);
+        Expression* ret_expr = ast::parse_expression(parser);
 
         if (!parser->match_token(TOKEN_SEMICOLON))
         {
@@ -93,61 +230,33 @@ namespace ast
             return nullptr;
         }
         parser->get_next_token();
-        return std::make_unique<ExprStatement>(true, ret_expr.release());
-    }
-
-    int ExprStatement::output_graphviz(GraphvizDocument& doc) const
-    {
-        static const char* expr_fmt  = "    stmt_%d[label=\"{%s|{<f1>expr|<f2>next}}\"];\n";
-
-        int stmt_id = doc.next_id();
-        char buffer[1024] = {};
-
-        std::snprintf(buffer, 1024, expr_fmt, stmt_id, is_return_stmt ? "ReturnStatement" : "ExprStatement");
-        doc.oss << buffer;
-
-        if(expr)
-        {
-            int expr_id = expr->output_graphviz(doc);
-            doc.oss << "    stmt_" << stmt_id << ":<f1> -> expr_" << expr_id << ";\n";
-        }
-        if(next)
-        {
-            int next_id = next->output_graphviz(doc);
-            doc.oss << "    stmt_" << stmt_id << ":<f2> -> stmt_" << next_id << ";\n";
-        }
-        return stmt_id;
+        return make_node<ExprStatement>(parser, true, ret_expr);
     }
 
-    int IfStatement::output_graphviz(GraphvizDocument& doc) const
+    size_t if_depth(const Statement* first)
     {
-        static const char* IF_FMT   = "    stmt_%d[label=\"{IfStatement|{<f1>condition|<f2>then|<f3>else|<f4>next}}\"];\n";
-
-        int if_id = doc.next_id();
-        char buffer[1024] = {};
-
-        std::snprintf(buffer, 1024, IF_FMT, if_id);
-        doc.oss << buffer;
-
-        int cond_id = condition->output_graphviz(doc);
-        doc.oss << "    stmt_" << if_id << ":<f1> -> expr_" << cond_id << ";\n";
+        // Blocks still to look at, with how many ifs they're inside of
+        std::vector<std::pair<const Statement*, size_t>> blocks;
+        if(first)
+            blocks.push_back({ first, 0 });
 
-        if(body)
+        size_t deepest = 0;
+        while(!blocks.empty())
         {
-            int then_id = body->output_graphviz(doc);
-            doc.oss << "    stmt_" << if_id << ":<f2> -> stmt_" << then_id << ";\n";
-        }
-        if(else_blk)
-        {
-            int else_id = else_blk->output_graphviz(doc);
-            doc.oss << "    stmt_" << if_id << ":<f3> -> stmt_" << else_id << ";\n";
-        }
-        if(next)
-        {
-            int next_id = next->output_graphviz(doc);
-            doc.oss << "    stmt_" << if_id << ":<f4> -> stmt_" << next_id << ";\n";
+            auto [stmt, depth] = blocks.back();
+            blocks.pop_back();
+            for(; stmt; stmt = stmt->next)
+            {
+                if(stmt->get_type() != Stmt_t::IF)
+                    continue;
+                auto if_stmt = static_cast<const IfStatement*>(stmt);
+                deepest = std::max(deepest, depth + 1);
+                if(if_stmt->get_body())
+                    blocks.push_back({ if_stmt->get_body(), depth + 1 });
+                if(if_stmt->get_else())
+                    blocks.push_back({ if_stmt->get_else(), depth + 1 });
+            }
         }
-        return if_id;
+        return deepest;
     }
-
 }
@@ -11,7 +11,7 @@
 #include "Expression.h"
 #include "Node.h"
 
-enum class Stmt_t { NONE, IF, FOR, DECL, RETURN, EXPR };
+enum class Stmt_t : uint8_t { NONE, IF, FOR, DECL, RETURN, EXPR };
 
 namespace ast 
 {
@@ -20,11 +20,10 @@ namespace ast
         public:
             Statement() = default;
             Statement(Stmt_t type): stmt_type(type) { }
-            virtual int output_graphviz(GraphvizDocument& doc) const = 0;
             virtual ~Statement() = default;
 
             Stmt_t get_type() const { return stmt_type; }
-            std::unique_ptr<Statement> next = nullptr;
+            Statement* next = nullptr;
         protected:
             Stmt_t stmt_type = Stmt_t::NONE;
     };
@@ -37,12 +36,19 @@ namespace ast
             IfStatement(Expression* expr, Statement* body = nullptr, Statement* else_blk = nullptr):
                 Statement(Stmt_t::IF), condition(expr), body(body), else_blk(else_blk) { }
 
-            int output_graphviz(GraphvizDocument& doc) const override;
             ~IfStatement() override { }
+
+            const Expression* get_condition() const { return condition; }
+            const Statement*  get_body() const      { return body; }
+            const Statement*  get_else() const      { return else_blk; }
+
+            Expression** condition_ref() { return &condition; }
+            Statement**  body_ref()      { return &body; }
+            Statement**  else_ref()      { return &else_blk; }
         private:
-            std::unique_ptr<Expression> condition = nullptr;
-            std::unique_ptr<Statement > body      = nullptr;
-            std::unique_ptr<Statement > else_blk  = nullptr;
+            Expression* condition = nullptr;
+            Statement*  body      = nullptr;
+            Statement*  else_blk  = nullptr;
     };
 
     class ExprStatement : public Statement
@@ -58,19 +64,30 @@ namespace ast
                 is_return_stmt = is_return; 
             }
 
-            int output_graphviz(GraphvizDocument& doc) const override;
             ~ExprStatement() override { }
+
+            const Expression* get_expr() const { return expr; }
+            Expression**      expr_ref()       { return &expr; }
         private:
             bool is_return_stmt = false;
-            std::unique_ptr<Expression> expr;
+            Expression* expr = nullptr;
     };
 
-    std::unique_ptr<Statement> parse_block(ParserState*, bool);
-    std::unique_ptr<Statement> parse_statement(ParserState*);
-    std::unique_ptr<Statement> parse_var_decl_statement(ParserState*);
-    std::unique_ptr<Statement> parse_if_statement(ParserState*);
-    std::unique_ptr<Statement> parse_return_statement(ParserState*);
-    std::optional<std::pair<Type_t, std::string>> parse_ident_type_pair(ParserState*);
+    // The parser and flatten() take ifs nested as deep as they come, but the
+    // resolver, the optimizer and both engines walk a block's ifs
+    // recursively. They turn away a function nested deeper than this rather
+    // than run out of native stack, the same bound the tree engine puts on
+    // expressions and calls.
+    constexpr size_t MAX_IF_DEPTH = 10000;
+
+    // How many ifs deep the block starting at `first` goes, without recursing
+    size_t if_depth(const Statement* first);
+
+    Statement* parse_block(ParserState*, bool);
+    Statement* parse_statement(ParserState*);
+    Statement* parse_var_decl_statement(ParserState*);
+    Statement* parse_return_statement(ParserState*);
+    std::optional<std::pair<Type_t, Symbol>> parse_ident_type_pair(ParserState*);
 }
 
 #endif
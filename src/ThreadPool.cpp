@@ -0,0 +1,61 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned num_threads)
+{
+    if(num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    workers.reserve(num_threads);
+    for(unsigned i = 0; i < num_threads; i++)
+        workers.emplace_back([this]() { worker_loop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    has_work.notify_all();
+    for(std::thread& worker : workers)
+        worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        tasks.push_back(std::move(task));
+    }
+    has_work.notify_one();
+}
+
+void ThreadPool::worker_loop()
+{
+    while(true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            has_work.wait(guard, [this]() { return stopping || !tasks.empty(); });
+            if(tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::Latch::count_down()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if(--remaining == 0)
+        zero.notify_all();
+}
+
+void ThreadPool::Latch::wait()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    zero.wait(guard, [this]() { return remaining == 0; });
+}
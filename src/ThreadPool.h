@@ -0,0 +1,68 @@
+#pragma once
+#ifndef LANG_THREAD_POOL_H
+#define LANG_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling tasks off a shared queue
+class ThreadPool
+{
+    public:
+        explicit ThreadPool(unsigned num_threads = 0);  // 0 means one per core
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        ~ThreadPool();
+
+        void     submit(std::function<void()> task);
+        unsigned size() const { return (unsigned) workers.size(); }
+
+        // Runs fn(0) .. fn(count - 1) across the pool and returns once all of
+        // them are done. The calling thread works through indices as well.
+        template<typename Fn>
+        void parallel_for(size_t count, Fn&& fn)
+        {
+            std::atomic<size_t> next_idx { 0 };
+            auto run_indices = [&]()
+            {
+                for(size_t i = next_idx++; i < count; i = next_idx++)
+                    fn(i);
+            };
+
+            size_t num_helpers = std::min<size_t>(count, workers.size());
+            Latch  done(num_helpers);
+            for(size_t i = 0; i < num_helpers; i++)
+                submit([&]() { run_indices(); done.count_down(); });
+
+            run_indices();
+            done.wait();
+        }
+    private:
+        struct Latch
+        {
+            explicit Latch(size_t count): remaining(count) { }
+            void count_down();
+            void wait();
+
+            size_t remaining;
+            std::mutex lock;
+            std::condition_variable zero;
+        };
+
+        void worker_loop();
+
+        std::vector<std::thread>          workers;
+        std::deque<std::function<void()>> tasks;
+        std::mutex                        lock;
+        std::condition_variable           has_work;
+        bool                              stopping = false;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#pragma once
+#ifndef LANG_TOKEN_QUEUE_H
+#define LANG_TOKEN_QUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <utility>
+
+// Bounded single-producer/single-consumer ring. Exactly one thread may push
+// and exactly one (other) thread may pop; neither side ever takes a lock.
+// The blocking variants spin briefly then yield, which is what provides the
+// backpressure between the lexer and the parser in pipelined mode.
+template<typename T, std::size_t Capacity>
+class SpscRing
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    public:
+        bool try_push(T& item)
+        {
+            const std::size_t tail = tail_.load(std::memory_order_relaxed);
+            if(tail - head_.load(std::memory_order_acquire) == Capacity)
+                return false;
+
+            slots[tail & (Capacity - 1)] = std::move(item);
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool try_pop(T& item)
+        {
+            const std::size_t head = head_.load(std::memory_order_relaxed);
+            if(head == tail_.load(std::memory_order_acquire))
+                return false;
+
+            item = std::move(slots[head & (Capacity - 1)]);
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        void push(T& item)
+        {
+            for(int spins = 0; !try_push(item); spins++)
+                backoff(spins);
+        }
+
+        void pop(T& item)
+        {
+            for(int spins = 0; !try_pop(item); spins++)
+                backoff(spins);
+        }
+    private:
+        static void backoff(int spins)
+        {
+            if(spins > 64)
+                std::this_thread::yield();
+        }
+
+        std::array<T, Capacity> slots = {};
+
+        // Kept on separate cache lines so the two threads don't false share
+        alignas(64) std::atomic<std::size_t> head_ { 0 };
+        alignas(64) std::atomic<std::size_t> tail_ { 0 };
+};
+
+#endif
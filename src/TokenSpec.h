@@ -0,0 +1,155 @@
+#pragma once
+#ifndef LANG_TOKEN_SPEC_H
+#define LANG_TOKEN_SPEC_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <array>
+#include <string_view>
+
+// Single source of truth for every token the lexer knows about. The
+// TokenType enum, the keyword hash table and the operator dispatch table are
+// all generated from this list, so adding a keyword or an operator here is
+// all it takes and their ordering can't drift apart.
+//
+//   TOKEN   (name)            tokens with no fixed spelling
+//   OPERATOR(name, spelling)  one or two characters
+//   KEYWORD (name, spelling)
+#define LANG_TOKEN_SPEC(TOKEN, OPERATOR, KEYWORD)                                              \
+    TOKEN(TOKEN_IDENTIFIER)          TOKEN(TOKEN_INT_LITERAL)                                  \
+    TOKEN(TOKEN_FLOAT_LITERAL)       TOKEN(TOKEN_STR_LITERAL)                                  \
+                                                                                               \
+    OPERATOR(TOKEN_OP_PLUS    , "+") OPERATOR(TOKEN_OP_MINUS     , "-")                        \
+    OPERATOR(TOKEN_OP_MUL     , "*") OPERATOR(TOKEN_OP_DIV       , "/")                        \
+    OPERATOR(TOKEN_OP_EQU     , "=") OPERATOR(TOKEN_LEFT_PAREN   , "(")                        \
+    OPERATOR(TOKEN_RIGHT_PAREN, ")") OPERATOR(TOKEN_COMMA        , ",")                        \
+    OPERATOR(TOKEN_COLON      , ":") OPERATOR(TOKEN_SEMICOLON    , ";")                        \
+    OPERATOR(TOKEN_LEFT_CBRACK, "{") OPERATOR(TOKEN_RIGHT_CBRACK , "}")                        \
+    OPERATOR(TOKEN_COMP_LESS  , "<") OPERATOR(TOKEN_COMP_GREATER , ">")                        \
+                                                                                               \
+    OPERATOR(TOKEN_INCREMENT  , "++") OPERATOR(TOKEN_DECREMENT   , "--")                       \
+    OPERATOR(TOKEN_POWER      , "**") OPERATOR(TOKEN_COMP_EQUAL  , "==")                       \
+    OPERATOR(TOKEN_COMP_LEQ   , "<=") OPERATOR(TOKEN_COMP_GEQ    , ">=")                       \
+    OPERATOR(TOKEN_COMP_NEQ   , "!=") OPERATOR(TOKEN_ARROW       , "->")                       \
+                                                                                               \
+    KEYWORD(KEYWORD_IF    , "if"  )  KEYWORD(KEYWORD_ELSE  , "else")                           \
+    KEYWORD(KEYWORD_FUNC  , "func")  KEYWORD(KEYWORD_RETURN, "return")                         \
+                                                                                               \
+    TOKEN(TOKEN_EOF)
+
+#define LANG_TOKEN_ENUM(name, ...) name,
+enum TokenType : uint8_t
+{
+    LANG_TOKEN_SPEC(LANG_TOKEN_ENUM, LANG_TOKEN_ENUM, LANG_TOKEN_ENUM)
+    TOKEN_TYPE_COUNT
+};
+#undef LANG_TOKEN_ENUM
+
+namespace token_spec
+{
+    constexpr uint8_t NO_TOKEN = 0xFF;
+
+    struct Spelling
+    {
+        TokenType        type;
+        std::string_view text;
+    };
+
+#define LANG_TOKEN_IGNORE(...)
+#define LANG_TOKEN_SPELLING(name, text) { name, text },
+    constexpr Spelling OPERATORS[] = { LANG_TOKEN_SPEC(LANG_TOKEN_IGNORE, LANG_TOKEN_SPELLING, LANG_TOKEN_IGNORE) };
+    constexpr Spelling KEYWORDS[]  = { LANG_TOKEN_SPEC(LANG_TOKEN_IGNORE, LANG_TOKEN_IGNORE, LANG_TOKEN_SPELLING) };
+#undef LANG_TOKEN_SPELLING
+#undef LANG_TOKEN_IGNORE
+
+    // --- Operators: one entry per possible first character --------------------
+
+    constexpr size_t MAX_OPERATOR_PAIRS = 2;
+    struct OperatorState
+    {
+        uint8_t single = NO_TOKEN;                  // token when only this character matches
+        uint8_t num_pairs = 0;
+        char    second[MAX_OPERATOR_PAIRS] = {};    // possible second characters
+        uint8_t paired[MAX_OPERATOR_PAIRS] = {};    // and the tokens they form
+    };
+
+    constexpr std::array<OperatorState, 256> make_operator_table()
+    {
+        std::array<OperatorState, 256> table = {};
+        for(const Spelling& op : OPERATORS)
+        {
+            OperatorState& state = table[(uint8_t) op.text[0]];
+            if(op.text.size() == 1)
+                state.single = op.type;
+            else
+            {
+                // Fails to compile (not a constant expression) if a first
+                // character ever needs more pairs than there is room for
+                if(state.num_pairs == MAX_OPERATOR_PAIRS)
+                    throw "raise MAX_OPERATOR_PAIRS";
+                state.second[state.num_pairs] = op.text[1];
+                state.paired[state.num_pairs] = op.type;
+                state.num_pairs++;
+            }
+        }
+        return table;
+    }
+    constexpr std::array<OperatorState, 256> OPERATOR_TABLE = make_operator_table();
+
+    // --- Keywords: perfect hash on (length, first char, last char) ------------
+
+    constexpr size_t KEYWORD_TABLE_SIZE = 16;
+    constexpr size_t MAX_KEYWORD_LEN    = 8;
+
+    constexpr uint32_t keyword_hash(std::string_view text, uint32_t seed)
+    {
+        uint32_t h = (uint32_t) text.size() * seed;
+        h ^= (uint8_t) text.front() * 0x9E3779B1u;
+        h ^= (uint8_t) text.back()  * seed * 0x85EBCA77u;
+        return (h >> 16) & (KEYWORD_TABLE_SIZE - 1);
+    }
+
+    constexpr bool seed_is_perfect(uint32_t seed)
+    {
+        bool used[KEYWORD_TABLE_SIZE] = {};
+        for(const Spelling& kw : KEYWORDS)
+        {
+            uint32_t slot = keyword_hash(kw.text, seed);
+            if(used[slot] || kw.text.size() > MAX_KEYWORD_LEN)
+                return false;
+            used[slot] = true;
+        }
+        return true;
+    }
+
+    constexpr uint32_t find_keyword_seed()
+    {
+        for(uint32_t seed = 1; seed < 100000; seed++)
+            if(seed_is_perfect(seed))
+                return seed;
+        throw "no perfect hash seed, grow KEYWORD_TABLE_SIZE";
+    }
+    constexpr uint32_t KEYWORD_SEED = find_keyword_seed();
+
+    constexpr std::array<Spelling, KEYWORD_TABLE_SIZE> make_keyword_table()
+    {
+        std::array<Spelling, KEYWORD_TABLE_SIZE> table = {};
+        for(auto& slot : table)
+            slot = { TOKEN_IDENTIFIER, {} };
+        for(const Spelling& kw : KEYWORDS)
+            table[keyword_hash(kw.text, KEYWORD_SEED)] = kw;
+        return table;
+    }
+    constexpr std::array<Spelling, KEYWORD_TABLE_SIZE> KEYWORD_TABLE = make_keyword_table();
+
+    // TOKEN_IDENTIFIER unless `ident` is one of the keywords
+    inline TokenType classify_identifier(std::string_view ident)
+    {
+        if(ident.size() > MAX_KEYWORD_LEN)
+            return TOKEN_IDENTIFIER;
+        const Spelling& slot = KEYWORD_TABLE[keyword_hash(ident, KEYWORD_SEED)];
+        return slot.text == ident ? slot.type : TOKEN_IDENTIFIER;
+    }
+}
+
+#endif
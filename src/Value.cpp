@@ -0,0 +1,150 @@
+#include "Value.h"
+
+#include <math.h>
+
+namespace ast {
+    namespace
+    {
+        template<typename T>
+        bool compare(Expr_t op, T a, T b)
+        {
+            switch(op)
+            {
+                case Expr_t::COMP_LT  : return a <  b;
+                case Expr_t::COMP_GT  : return a >  b;
+                case Expr_t::COMP_LEQ : return a <= b;
+                case Expr_t::COMP_GEQ : return a >= b;
+                case Expr_t::COMP_EQU : return a == b;
+                case Expr_t::COMP_NEQ : return a != b;
+                default               : return false;
+            }
+        }
+
+        const char* not_numbers(Expr_t op)
+        {
+            switch(op)
+            {
+                case Expr_t::ADD      : return "the operands of + have to be numbers";
+                case Expr_t::SUB      : return "the operands of - have to be numbers";
+                case Expr_t::MUL      : return "the operands of * have to be numbers";
+                case Expr_t::DIV      : return "the operands of / have to be numbers";
+                case Expr_t::COMP_LT  : return "the operands of < have to be numbers";
+                case Expr_t::COMP_GT  : return "the operands of > have to be numbers";
+                case Expr_t::COMP_LEQ : return "the operands of <= have to be numbers";
+                case Expr_t::COMP_GEQ : return "the operands of >= have to be numbers";
+                case Expr_t::COMP_EQU : return "the operands of == have to be numbers";
+                case Expr_t::COMP_NEQ : return "the operands of != have to be numbers";
+                default               : return "unknown operator";
+            }
+        }
+    }
+
+    const char* op_name(Expr_t op)
+    {
+        switch(op)
+        {
+            case Expr_t::ADD      : return "+";
+            case Expr_t::SUB      : return "-";
+            case Expr_t::MUL      : return "*";
+            case Expr_t::DIV      : return "/";
+            case Expr_t::COMP_LT  : return "<";
+            case Expr_t::COMP_GT  : return ">";
+            case Expr_t::COMP_LEQ : return "<=";
+            case Expr_t::COMP_GEQ : return ">=";
+            case Expr_t::COMP_EQU : return "==";
+            case Expr_t::COMP_NEQ : return "!=";
+            default               : return "?";
+        }
+    }
+
+    bool is_comparison(Expr_t op)
+    {
+        return op == Expr_t::COMP_LT  || op == Expr_t::COMP_GT  || op == Expr_t::COMP_LEQ ||
+               op == Expr_t::COMP_GEQ || op == Expr_t::COMP_EQU || op == Expr_t::COMP_NEQ;
+    }
+
+    const char* apply_binary(Expr_t op, const Value& lhs, const Value& rhs, Value& result)
+    {
+        if(lhs.kind == Value::STRING && rhs.kind == Value::STRING && (op == Expr_t::COMP_EQU || op == Expr_t::COMP_NEQ))
+        {
+            result = Value::of_int(compare(op, lhs.str(), rhs.str()));
+            return nullptr;
+        }
+        if(!lhs.is_number() || !rhs.is_number())
+            return not_numbers(op);
+
+        if(lhs.kind == Value::INT && rhs.kind == Value::INT)
+        {
+            int64_t a = lhs.int_value, b = rhs.int_value;
+            switch(op)
+            {
+                case Expr_t::ADD: result = Value::of_int(wrap_add(a, b)); return nullptr;
+                case Expr_t::SUB: result = Value::of_int(wrap_sub(a, b)); return nullptr;
+                case Expr_t::MUL: result = Value::of_int(wrap_mul(a, b)); return nullptr;
+                case Expr_t::DIV:
+                    if(b == 0)
+                        return "division by zero";
+                    result = Value::of_int(b == -1 ? wrap_sub(0, a) : a / b);
+                    return nullptr;
+                default:
+                    if(!is_comparison(op))
+                        return "unknown operator";
+                    result = Value::of_int(compare(op, a, b));
+                    return nullptr;
+            }
+        }
+
+        double a = lhs.kind == Value::INT ? (double) lhs.int_value : lhs.flt_value;
+        double b = rhs.kind == Value::INT ? (double) rhs.int_value : rhs.flt_value;
+        switch(op)
+        {
+            case Expr_t::ADD: result = Value::of_float(a + b); return nullptr;
+            case Expr_t::SUB: result = Value::of_float(a - b); return nullptr;
+            case Expr_t::MUL: result = Value::of_float(a * b); return nullptr;
+            case Expr_t::DIV: result = Value::of_float(a / b); return nullptr;
+            default:
+                if(!is_comparison(op))
+                    return "unknown operator";
+                result = Value::of_int(compare(op, a, b));
+                return nullptr;
+        }
+    }
+
+    const char* apply_negate(const Value& value, Value& result)
+    {
+        if(value.kind == Value::INT)
+            result = Value::of_int(wrap_sub(0, value.int_value));
+        else if(value.kind == Value::FLOAT)
+            result = Value::of_float(-value.flt_value);
+        else
+            return "only numbers can be negated";
+        return nullptr;
+    }
+
+    const char* convert_value(const Value& value, Type_t::Value type, Value& result)
+    {
+        if(type == Type_t::INT)
+        {
+            if(value.kind == Value::INT)
+                result = value;
+            else if(value.kind == Value::FLOAT && isfinite(value.flt_value) &&
+                    value.flt_value >= -9223372036854775808.0 && value.flt_value < 9223372036854775808.0)
+                result = Value::of_int((int64_t) value.flt_value);
+            else
+                return value.kind == Value::FLOAT ? "this float can't be stored in an int" : "a non-number can't be stored in an int";
+            return nullptr;
+        }
+        if(type == Type_t::FLOAT)
+        {
+            if(value.kind == Value::FLOAT)
+                result = value;
+            else if(value.kind == Value::INT)
+                result = Value::of_float((double) value.int_value);
+            else
+                return "a non-number can't be stored in a float";
+            return nullptr;
+        }
+        result = value;
+        return nullptr;
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#ifndef LANG_VALUE_H
+#define LANG_VALUE_H
+
+#include <stdint.h>
+#include <string_view>
+
+#include "Expression.h"
+
+namespace ast {
+    // What expressions evaluate to. Strings can only come from literals, so
+    // a string value just points at the literal's text in the parse's arena
+    // and copying any value is copying 16 bytes.
+    struct Value
+    {
+        enum Kind : uint8_t { VOID, INT, FLOAT, STRING };
+
+        Kind     kind    = VOID;
+        uint32_t str_len = 0;
+        union
+        {
+            int64_t     int_value;
+            double      flt_value;
+            const char* str_value;
+        };
+
+        Value(): int_value(0) { }
+
+        static Value of_int(int64_t v)         { Value value; value.kind = INT;    value.int_value = v; return value; }
+        static Value of_float(double v)        { Value value; value.kind = FLOAT;  value.flt_value = v; return value; }
+        static Value of_string(std::string_view s)
+        {
+            Value value;
+            value.kind      = STRING;
+            value.str_value = s.data();
+            value.str_len   = (uint32_t) s.size();
+            return value;
+        }
+
+        bool             is_number() const { return kind == INT || kind == FLOAT; }
+        std::string_view str() const       { return std::string_view(str_value, str_len); }
+    };
+    static_assert(sizeof(Value) == 16, "Value is expected to stay compact");
+
+    // The language's arithmetic, shared by every execution engine so they
+    // agree on results and on errors. Ints are 64-bit and wrap around, an int
+    // and a float make a float, comparisons give 0 or 1 and only strings can
+    // be compared for (in)equality besides numbers. These return nullptr on
+    // success, otherwise what went wrong.
+    const char* apply_binary(Expr_t op, const Value& lhs, const Value& rhs, Value& result);
+    const char* apply_negate(const Value& value, Value& result);
+
+    // Values take the declared type of whatever they're stored in. Floats
+    // are truncated towards zero when they fit in an int.
+    const char* convert_value(const Value& value, Type_t::Value type, Value& result);
+
+    // The Value kind a declared type converts to, VOID for types that take
+    // any value unchanged
+    inline Value::Kind kind_of_type(Type_t::Value type)
+    {
+        return type == Type_t::INT ? Value::INT : type == Type_t::FLOAT ? Value::FLOAT : Value::VOID;
+    }
+
+    // Signed overflow is undefined, these wrap instead
+    inline int64_t wrap_add(int64_t a, int64_t b) { return (int64_t) ((uint64_t) a + (uint64_t) b); }
+    inline int64_t wrap_sub(int64_t a, int64_t b) { return (int64_t) ((uint64_t) a - (uint64_t) b); }
+    inline int64_t wrap_mul(int64_t a, int64_t b) { return (int64_t) ((uint64_t) a * (uint64_t) b); }
+
+    const char* op_name(Expr_t op);
+    bool        is_comparison(Expr_t op);
+}
+
+#endif
@@ -0,0 +1,386 @@
+#include "VirtualMachine.h"
+
+#include <inttypes.h>
+#include <string.h>
+#include <algorithm>
+
+// GCC and Clang can jump from the end of one handler straight to the next
+// through a table of label addresses, which the branch predictor handles far
+// better than every instruction going back through a switch's single
+// indirect jump. Defining LANG_NO_COMPUTED_GOTO builds the switch instead.
+#if !defined(LANG_NO_COMPUTED_GOTO) && (defined(__GNUC__) || defined(__clang__))
+#define LANG_COMPUTED_GOTO 1
+#endif
+
+namespace ast {
+    namespace
+    {
+        // Arguments and returned values take the declared kind
+        const char* convert_to(Value& value, Value::Kind kind)
+        {
+            return convert_value(value, kind == Value::INT ? Type_t::INT : Type_t::FLOAT, value);
+        }
+    }
+
+    bool VirtualMachine::call(uint32_t function, const Value* args, size_t num_args, Value& result)
+    {
+        error_msg.clear();
+        const BytecodeFunction& func = program->functions[function];
+        if(num_args != func.param_kinds.size())
+        {
+            std::string_view name = Interner::global().name(func.name);
+            char message[256];
+            snprintf(message, sizeof(message), "%.*s() takes %zu arguments but was given %zu",
+                     (int) name.size(), name.data(), func.param_kinds.size(), num_args);
+            return fail(nullptr, message);
+        }
+
+        // Every function has room for its result in its first register,
+        // even one without any registers of its own
+        frames.clear();
+        memo_keys.clear();
+        if(stack.size() < (size_t) func.num_registers + 1)
+            stack.resize((size_t) func.num_registers + 1);
+        std::copy(args, args + num_args, stack.begin());
+
+        frames.push_back({ &func, nullptr, 0, nullptr });
+        for(size_t i = 0; i < num_args; i++)
+        {
+            Value::Kind kind = func.param_kinds[i];
+            if(kind != Value::VOID && stack[i].kind != kind)
+            {
+                if(const char* error = convert_to(stack[i], kind))
+                {
+                    frames.clear();
+                    return fail(&func, error);
+                }
+            }
+        }
+
+        if(MemoCache* cache = memo.empty() ? nullptr : memo[function])
+        {
+            if(const Value* found = cache->find(stack.data()))
+            {
+                frames.clear();
+                result = *found;
+                return true;
+            }
+            memo_keys.insert(memo_keys.end(), stack.begin(), stack.begin() + num_args);
+            frames.back().memo = cache;
+        }
+        calls++;
+        return execute(result);
+    }
+
+    bool VirtualMachine::fail(const BytecodeFunction* func, const char* message)
+    {
+        error_msg = message;
+        if(func && strcmp(message, NESTED_TOO_DEEPLY) != 0)
+        {
+            error_msg += " in ";
+            error_msg.append(Interner::global().name(func->name));
+            error_msg += "()";
+        }
+        return false;
+    }
+
+    // Runs until the frame on top returns. The running function's code,
+    // constants and registers are cached in locals and only reloaded when a
+    // call or a return switches functions.
+    bool VirtualMachine::execute(Value& result)
+    {
+        const size_t entry_depth = frames.size() - 1;
+
+        const BytecodeFunction* func      = frames.back().func;
+        const Instruction*      code      = func->code.data();
+        const Instruction*      ip        = code;
+        const Value*            constants = func->constants.data();
+        Value*                  regs      = stack.data() + frames.back().base;
+
+        const char* error = nullptr;
+        Value       returned;
+        MemoCache*  cache = nullptr;    // Of the function being called
+
+#ifdef LANG_COMPUTED_GOTO
+#define LANG_OPCODE_LABEL(name) &&op_##name,
+        static void* const handlers[] = { LANG_OPCODES(LANG_OPCODE_LABEL) };
+#undef LANG_OPCODE_LABEL
+#define HANDLER(name) op_##name:
+#define DISPATCH()    goto *handlers[(size_t) ip->op]
+        DISPATCH();
+#else
+#define HANDLER(name) case Opcode::name:
+#define DISPATCH()    continue
+        for(;;)
+        switch(ip->op)
+        {
+#endif
+
+// Ints take the fast path, anything else goes through apply_binary()
+#define BINARY(name, expr_t, int_result)                                    \
+        HANDLER(name)                                                       \
+        {                                                                   \
+            const Value& lhs = regs[ip->b];                                 \
+            const Value& rhs = regs[ip->c];                                 \
+            if(lhs.kind == Value::INT && rhs.kind == Value::INT)            \
+            {                                                               \
+                int64_t a = lhs.int_value, b = rhs.int_value;               \
+                regs[ip->a] = Value::of_int(int_result);                    \
+            }                                                               \
+            else if((error = apply_binary(expr_t, lhs, rhs, regs[ip->a])))  \
+                goto failed;                                                \
+            ip++;                                                           \
+            DISPATCH();                                                     \
+        }
+
+#define BINARY_IMM(name, expr_t, int_result)                                            \
+        HANDLER(name)                                                                   \
+        {                                                                               \
+            const Value& lhs = regs[ip->b];                                             \
+            int64_t      b   = ip->imm();                                               \
+            if(lhs.kind == Value::INT)                                                  \
+            {                                                                           \
+                int64_t a = lhs.int_value;                                              \
+                regs[ip->a] = Value::of_int(int_result);                                \
+            }                                                                           \
+            else if((error = apply_binary(expr_t, lhs, Value::of_int(b), regs[ip->a])))  \
+                goto failed;                                                            \
+            ip++;                                                                       \
+            DISPATCH();                                                                 \
+        }
+
+        HANDLER(MOVE)
+            regs[ip->a] = regs[ip->b];
+            ip++;
+            DISPATCH();
+
+        HANDLER(LOAD_INT)
+            regs[ip->a] = Value::of_int((int32_t) ip->bc());
+            ip++;
+            DISPATCH();
+
+        HANDLER(LOAD_CONST)
+            regs[ip->a] = constants[ip->bc()];
+            ip++;
+            DISPATCH();
+
+        HANDLER(LOAD_VOID)
+            regs[ip->a] = Value();
+            ip++;
+            DISPATCH();
+
+        BINARY(ADD, Expr_t::ADD,      wrap_add(a, b))
+        BINARY(SUB, Expr_t::SUB,      wrap_sub(a, b))
+        BINARY(MUL, Expr_t::MUL,      wrap_mul(a, b))
+        BINARY(LT,  Expr_t::COMP_LT,  a <  b)
+        BINARY(GT,  Expr_t::COMP_GT,  a >  b)
+        BINARY(LEQ, Expr_t::COMP_LEQ, a <= b)
+        BINARY(GEQ, Expr_t::COMP_GEQ, a >= b)
+        BINARY(EQU, Expr_t::COMP_EQU, a == b)
+        BINARY(NEQ, Expr_t::COMP_NEQ, a != b)
+
+        BINARY_IMM(ADD_IMM, Expr_t::ADD,      wrap_add(a, b))
+        BINARY_IMM(SUB_IMM, Expr_t::SUB,      wrap_sub(a, b))
+        BINARY_IMM(LT_IMM,  Expr_t::COMP_LT,  a <  b)
+        BINARY_IMM(GT_IMM,  Expr_t::COMP_GT,  a >  b)
+        BINARY_IMM(LEQ_IMM, Expr_t::COMP_LEQ, a <= b)
+        BINARY_IMM(GEQ_IMM, Expr_t::COMP_GEQ, a >= b)
+        BINARY_IMM(EQU_IMM, Expr_t::COMP_EQU, a == b)
+        BINARY_IMM(NEQ_IMM, Expr_t::COMP_NEQ, a != b)
+
+        // Dividing by zero is an error and INT64_MIN / -1 wraps, which
+        // apply_binary() takes care of
+        HANDLER(DIV)
+            if((error = apply_binary(Expr_t::DIV, regs[ip->b], regs[ip->c], regs[ip->a])))
+                goto failed;
+            ip++;
+            DISPATCH();
+
+        HANDLER(NEGATE)
+            if(regs[ip->b].kind == Value::INT)
+                regs[ip->a] = Value::of_int(wrap_sub(0, regs[ip->b].int_value));
+            else if((error = apply_negate(regs[ip->b], regs[ip->a])))
+                goto failed;
+            ip++;
+            DISPATCH();
+
+        HANDLER(CONVERT)
+            if((error = convert_value(regs[ip->a], (Type_t::Value) ip->b, regs[ip->a])))
+                goto failed;
+            ip++;
+            DISPATCH();
+
+        HANDLER(JUMP)
+            ip = code + ip->bc();
+            DISPATCH();
+
+        HANDLER(JUMP_IF_FALSE)
+        {
+            const Value& condition = regs[ip->a];
+            bool taken;
+            if(condition.kind == Value::INT)
+                taken = condition.int_value != 0;
+            else if(condition.kind == Value::FLOAT)
+                taken = condition.flt_value != 0.0;
+            else
+            {
+                error = "the condition of an if has to be a number";
+                goto failed;
+            }
+            ip = taken ? ip + 1 : code + ip->bc();
+            DISPATCH();
+        }
+
+        // The arguments are already in r[a] onwards, which become the
+        // callee's first registers
+        HANDLER(CALL)
+        {
+            if(frames.size() - entry_depth == MAX_CALL_DEPTH)
+            {
+                error = NESTED_TOO_DEEPLY;
+                goto failed;
+            }
+            const BytecodeFunction* callee = &program->functions[ip->bc()];
+            size_t base = frames.back().base + ip->a;
+            cache = memo.empty() ? nullptr : memo[ip->bc()];
+            frames.back().resume = ip + 1;
+            frames.push_back({ callee, nullptr, base, nullptr });
+
+            size_t needed = base + callee->num_registers + 1;
+            if(stack.size() < needed)
+                stack.resize(std::max(needed, stack.size() * 2));
+            func = callee;
+            regs = stack.data() + base;
+        }
+        goto entering;
+
+        // The arguments move down to r[0] onwards and the callee runs in
+        // the frame of the function calling it, which returns whatever it
+        // does. So recursing this way never runs out of frames. The result
+        // the frame was going to remember is given up, or a long chain of
+        // tail calls would keep a key for every one of them.
+        HANDLER(TAIL_CALL)
+        {
+            if(frames.back().memo)
+            {
+                memo_keys.resize(memo_keys.size() - frames.back().memo->num_params());
+                frames.back().memo = nullptr;
+            }
+            const BytecodeFunction* callee = &program->functions[ip->bc()];
+            size_t base = frames.back().base;
+            cache = memo.empty() ? nullptr : memo[ip->bc()];
+            for(size_t i = 0; i < callee->param_kinds.size(); i++)
+                regs[i] = regs[ip->a + i];
+            frames.back().func = callee;
+
+            size_t needed = base + callee->num_registers + 1;
+            if(stack.size() < needed)
+                stack.resize(std::max(needed, stack.size() * 2));
+            func = callee;
+            regs = stack.data() + base;
+        }
+        // Both kinds of call continue here with the callee's frame on top
+        entering:
+            code      = func->code.data();
+            ip        = code;
+            constants = func->constants.data();
+            for(size_t i = 0; i < func->param_kinds.size(); i++)
+            {
+                Value::Kind kind = func->param_kinds[i];
+                if(kind != Value::VOID && regs[i].kind != kind && (error = convert_to(regs[i], kind)))
+                    goto failed;
+            }
+
+            // A result remembered for these arguments returns straight away
+            if(cache)
+            {
+                if(const Value* found = cache->find(regs))
+                {
+                    returned = *found;
+                    goto returning;
+                }
+                memo_keys.insert(memo_keys.end(), regs, regs + func->param_kinds.size());
+                frames.back().memo = cache;
+            }
+            calls++;
+            DISPATCH();
+
+        HANDLER(PRINT)
+            if(output)
+            {
+                for(const Value* value = regs + ip->a; value != regs + ip->a + ip->b; value++)
+                {
+                    switch(value->kind)
+                    {
+                        case Value::INT    : fprintf(output, "%" PRId64, value->int_value);       break;
+                        case Value::FLOAT  : fprintf(output, "%g", value->flt_value);             break;
+                        case Value::STRING : fwrite(value->str_value, 1, value->str_len, output); break;
+                        case Value::VOID   : break;
+                    }
+                }
+                fputc('\n', output);
+            }
+            ip++;
+            DISPATCH();
+
+        HANDLER(NOT_VOID)
+            if(regs[ip->a].kind == Value::VOID)
+            {
+                error = "print() was given a function call that returns nothing";
+                goto failed;
+            }
+            ip++;
+            DISPATCH();
+
+        HANDLER(FAIL)
+            error = func->messages[ip->bc()].c_str();
+            goto failed;
+
+        HANDLER(RETURN_VOID)
+            returned = Value();
+            goto returning;
+
+        HANDLER(RETURN)
+            returned = regs[ip->a];
+            if(func->return_kind != Value::VOID && returned.kind != func->return_kind &&
+               (error = convert_to(returned, func->return_kind)))
+                goto failed;
+        returning:
+            if((cache = frames.back().memo))
+            {
+                size_t keys_base = memo_keys.size() - cache->num_params();
+                cache->store(memo_keys.data() + keys_base, returned);
+                memo_keys.resize(keys_base);
+            }
+            // The callee's first register is the caller's r[a] of the call
+            regs[0] = returned;
+            frames.pop_back();
+            if(frames.size() == entry_depth)
+            {
+                result = returned;
+                return true;
+            }
+            func      = frames.back().func;
+            code      = func->code.data();
+            ip        = frames.back().resume;
+            constants = func->constants.data();
+            regs      = stack.data() + frames.back().base;
+            DISPATCH();
+
+#ifndef LANG_COMPUTED_GOTO
+        default:
+            error = "unknown instruction";
+            goto failed;
+        }
+#endif
+#undef BINARY
+#undef BINARY_IMM
+#undef HANDLER
+#undef DISPATCH
+
+    failed:
+        fail(func, error);
+        frames.resize(entry_depth);
+        return false;
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef LANG_VIRTUAL_MACHINE_H
+#define LANG_VIRTUAL_MACHINE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Bytecode.h"
+#include "Memo.h"
+
+namespace ast {
+    // Runs compiled functions. Every frame's registers live in one growing
+    // array and calls don't recurse on the native stack, so the depth of
+    // recursion is only limited by MAX_CALL_DEPTH.
+    class VirtualMachine
+    {
+        public:
+            static constexpr size_t MAX_CALL_DEPTH = 200000;
+
+            VirtualMachine(const BytecodeProgram& program):
+                program(&program) { }
+
+            // Runs program.functions[function], false if it failed, error()
+            // then says why
+            bool call(uint32_t function, const Value* args, size_t num_args, Value& result);
+
+            void set_output(FILE* out) { output = out; }
+
+            // Caches for the functions whose results are remembered, by
+            // function index, nullptr for the rest. Empty turns it off.
+            void set_memo(std::vector<MemoCache*> caches) { memo = std::move(caches); }
+
+            const std::string& error() const { return error_msg; }
+            uint64_t num_calls() const       { return calls; }
+        private:
+            struct Frame
+            {
+                const BytecodeFunction* func;
+                const Instruction*      resume;     // Where the caller continues once this returns
+                size_t                  base;       // Of the frame's registers within `stack`
+                MemoCache*              memo;       // Gets the result, keyed by the top of memo_keys
+            };
+
+            bool execute(Value& result);
+            bool fail(const BytecodeFunction* func, const char* message);
+
+            const BytecodeProgram* program;
+
+            std::vector<Value> stack;
+            std::vector<Frame> frames;
+            uint64_t           calls = 0;
+
+            std::vector<MemoCache*> memo;
+            std::vector<Value>      memo_keys;  // Arguments of the memoized calls in progress
+
+            FILE*       output = stdout;
+            std::string error_msg;
+    };
+}
+
+#endif
@@ -1,12 +1,16 @@
 #include <string.h>
+#include <inttypes.h>
 #include <ctype.h>
 #include <string>
 #include <fstream>
 #include <cstdlib>
 #include <cstdio>
-#include <sstream>
+#include <cstdint>
 #include <memory>
+#include <chrono>
+#include <vector>
 
+#include "SourceFile.h"
 #include "Lexer.h"
 #include "Parser.h"
 #include "Expression.h"
@@ -14,93 +18,341 @@
 #include "Declaration.h"
 #include "GraphvizOutput.h"
 #include "Interpreter.h"
+#include "Optimizer.h"
+#include "PipelinedLexer.h"
+#include "ParallelLexer.h"
+#include "ParallelParser.h"
+#include "BatchDriver.h"
+#include "AstCache.h"
+#include "Hash.h"
+#include "ParseProfile.h"
 
-std::string load_program_source(const char* path)
+void print_tokens(const LexerState& lexer)
 {
-    std::ifstream input_file(path);
-
-    if (!input_file)
+    for(const Token& tok : lexer.tokens)
     {
-        std::fprintf(stderr, "[Error] could not load file: %s\n", path);
-        return {};
-    }
-    std::ostringstream oss;
-    oss << input_file.rdbuf();
-
-    return oss.str();
-}
+        std::string_view lexeme = lexer.lexeme(tok);
+        int len = (int) lexeme.size();
 
-void print_tokens(Token* token_stream)
-{
-    for(Token* tok = token_stream ; tok != NULL ; tok = tok->next)
-    {
-        printf("(line: %-2zu) ", tok->line_number);
-        switch(tok->type)
+        printf("(line: %-2u) ", tok.line_number);
+        switch(tok.type)
         {
-            case TOKEN_IDENTIFIER    : printf("[Ident ] %s\n",  tok->lexeme.c_str())     ; break ;
-            case TOKEN_INT_LITERAL   : printf("[Int   ] %ld\n", tok->int_value)          ; break ;
-            case TOKEN_FLOAT_LITERAL : printf("[Float ] %f\n",  tok->flt_value)          ; break ;
-            case TOKEN_LEFT_PAREN    : printf("[LParen] %s\n",  tok->lexeme.c_str())     ; break ;
-            case TOKEN_RIGHT_PAREN   : printf("[RParen] %s\n",  tok->lexeme.c_str())     ; break ;
-            case TOKEN_EOF           : printf("[EOF   ] %s\n",  tok->lexeme.c_str())     ; break ;
+            case TOKEN_IDENTIFIER    : printf("[Ident ] %.*s\n", len, lexeme.data()) ; break ;
+            case TOKEN_INT_LITERAL   : printf("[Int   ] %ld\n",  tok.int_value)      ; break ;
+            case TOKEN_FLOAT_LITERAL : printf("[Float ] %f\n",   tok.flt_value)      ; break ;
+            case TOKEN_LEFT_PAREN    : printf("[LParen] %.*s\n", len, lexeme.data()) ; break ;
+            case TOKEN_RIGHT_PAREN   : printf("[RParen] %.*s\n", len, lexeme.data()) ; break ;
+            case TOKEN_EOF           : printf("[EOF   ] EOF\n")                      ; break ;
 
 	        case TOKEN_COMP_LESS: case TOKEN_COMP_GREATER:
-                printf("[Comp  ] %s\n", tok->lexeme.c_str());
+                printf("[Comp  ] %.*s\n", len, lexeme.data());
             break;
             case KEYWORD_IF : case KEYWORD_FUNC : case KEYWORD_RETURN : case KEYWORD_ELSE :
-                printf("[Keywd ] %s\n", tok->lexeme.c_str());
+                printf("[Keywd ] %.*s\n", len, lexeme.data());
             break;
 
             default:
-                printf("[ChTok ] %s\n", tok->lexeme.c_str());
+                printf("[ChTok ] %.*s\n", len, lexeme.data());
             break;
         }
     }
 }
 
-int main()
+struct Options
+{
+    const char* source_path    = "sample_program.lang";
+    bool        pipelined      = false;
+    bool        parallel_lex   = false;
+    bool        parallel_parse = false;
+    unsigned    num_threads    = 0;     // 0 means one per core
+    const char* cache_dir      = nullptr;   // Trees of sources seen before are loaded from here
+    bool        profile        = false;     // Print time and tokens per grammar rule
+    const char* profile_json   = nullptr;   // Or write them here as JSON
+    bool        run            = false;     // Run main() instead of printing the tree
+    ast::Engine engine         = ast::Engine::BYTECODE;
+    bool        disassemble    = false;     // Print the compiled bytecode instead
+    bool        optimize       = false;     // Fold constants and prune dead branches before anything else
+    bool        memoize        = false;     // Remember the results of pure functions while running
+
+    // Batch mode, every file and directory given is processed
+    bool        batch          = false;
+    const char* list_path      = nullptr;
+    const char* output_dir     = nullptr;
+    std::vector<const char*> inputs;
+};
+
+bool parse_options(int argc, char** argv, Options& options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--pipeline") == 0)
+            options.pipelined = true;
+        else if(strcmp(argv[i], "--parallel-lex") == 0)
+            options.parallel_lex = true;
+        else if(strcmp(argv[i], "--parallel-parse") == 0)
+            options.parallel_parse = true;
+        else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            options.num_threads = (unsigned) std::strtoul(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "--batch") == 0)
+            options.batch = true;
+        else if(strcmp(argv[i], "--list") == 0 && i + 1 < argc)
+            options.batch = true, options.list_path = argv[++i];
+        else if(strcmp(argv[i], "--out-dir") == 0 && i + 1 < argc)
+            options.output_dir = argv[++i];
+        else if(strcmp(argv[i], "--ast-cache") == 0 && i + 1 < argc)
+            options.cache_dir = argv[++i];
+        else if(strcmp(argv[i], "--profile") == 0)
+            options.profile = true;
+        else if(strcmp(argv[i], "--run") == 0)
+            options.run = true;
+        else if(strcmp(argv[i], "--disassemble") == 0)
+            options.disassemble = true;
+        else if(strcmp(argv[i], "--optimize") == 0)
+            options.optimize = true;
+        else if(strcmp(argv[i], "--memoize") == 0)
+            options.memoize = true;
+        else if(strcmp(argv[i], "--engine") == 0 && i + 1 < argc)
+        {
+            if(!ast::engine_from_name(argv[++i], options.engine))
+            {
+                std::fprintf(stderr, "[Error] unknown engine: %s, expected tree or bytecode\n", argv[i]);
+                return false;
+            }
+        }
+        else if(strcmp(argv[i], "--profile-json") == 0 && i + 1 < argc)
+            options.profile_json = argv[++i];
+        else if(argv[i][0] == '-' && argv[i][1] == '-')
+        {
+            std::fprintf(stderr, "[Error] unknown option: %s\n", argv[i]);
+            std::fprintf(stderr, "usage: %s [--pipeline | --parallel-lex --parallel-parse] [--threads N] [--ast-cache DIR]\n"
+                                 "          [--profile] [--profile-json FILE] [--optimize]\n"
+                                 "          [--run [--engine tree | bytecode] [--memoize] | --disassemble]\n"
+                                 "          [source_file | -]\n", argv[0]);
+            std::fprintf(stderr, "       %s --batch [--list FILE] [--out-dir DIR] [--threads N] [--ast-cache DIR] [file_or_dir ...]\n", argv[0]);
+            return false;
+        }
+        else
+        {
+            options.source_path = argv[i];
+            options.inputs.push_back(argv[i]);
+        }
+    }
+    if(options.batch && (options.pipelined || options.parallel_lex || options.parallel_parse ||
+                         options.profile || options.profile_json || options.run || options.disassemble ||
+                         options.optimize))
+    {
+        std::fprintf(stderr, "[Error] --batch runs one file per thread and can't be combined with the other modes\n");
+        return false;
+    }
+    if(options.pipelined && (options.parallel_lex || options.parallel_parse))
+    {
+        std::fprintf(stderr, "[Error] --pipeline can't be combined with --parallel-lex or --parallel-parse\n");
+        return false;
+    }
+    if((options.run || options.disassemble) && options.cache_dir)
+    {
+        std::fprintf(stderr, "[Error] --run needs the parsed tree, which the AST cache doesn't keep\n");
+        return false;
+    }
+    if(options.memoize && !options.run)
+    {
+        std::fprintf(stderr, "[Error] --memoize only applies to --run\n");
+        return false;
+    }
+    return true;
+}
+
+// Prints one line per file and a summary, fails if any file did
+int run_batch_mode(const Options& options)
+{
+    std::vector<std::string> paths;
+    if(options.list_path && !read_source_list(options.list_path, paths))
+    {
+        std::fprintf(stderr, "[Error] could not read file list: %s\n", options.list_path);
+        return -1;
+    }
+    for(const char* input : options.inputs)
+    {
+        if(!collect_sources(input, paths))
+        {
+            std::fprintf(stderr, "[Error] could not read directory: %s\n", input);
+            return -1;
+        }
+    }
+    if(paths.empty())
+    {
+        std::fprintf(stderr, "[Error] no source files given\n");
+        return -1;
+    }
+
+    BatchOptions batch_options;
+    batch_options.output_dir = options.output_dir;
+    batch_options.cache_dir  = options.cache_dir;
+
+    ThreadPool pool(options.num_threads);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<FileResult> results = run_batch(paths, pool, batch_options);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t num_failed = 0, num_cached = 0, total_bytes = 0, total_tokens = 0, total_nodes = 0;
+    for(const FileResult& result : results)
+    {
+        total_bytes  += result.bytes;
+        total_tokens += result.tokens;
+        total_nodes  += result.nodes;
+
+        if(!result.loaded)
+            printf("[Error] %s: could not read file\n", result.path.c_str());
+        else if(result.lex_status != LEX_SUCCESS)
+            printf("[Error] %s: %s on line %zu\n", result.path.c_str(),
+                   result.lex_status == LEX_ERR_UNKNOWN_TOKEN ? "unrecognized token" : "invalid number literal",
+                   result.lex_error_line);
+        else if(!result.errors.empty())
+        {
+            // Some messages carry their own newline
+            const ErrorMessage& first = result.errors.front();
+            int msg_len = (int) first.msg.find_last_not_of('\n') + 1;
+            printf("[Error] %s: %zu errors, first on line %zu at position %zu: %.*s\n", result.path.c_str(),
+                   result.errors.size(), first.line_number, first.pos_in_line, msg_len, first.msg.c_str());
+        }
+        else
+            printf("[Ok]    %s: %zu bytes, %zu tokens, %zu AST nodes in %.3f ms%s\n", result.path.c_str(),
+                   result.bytes, result.tokens, result.nodes, result.seconds * 1e3, result.cached ? " (cached)" : "");
+        num_failed += result.ok() ? 0 : 1;
+        num_cached += result.cached ? 1 : 0;
+    }
+
+    printf("\n%zu files, %zu failed, %.2f MB, %zu tokens, %zu AST nodes\n",
+           results.size(), num_failed, total_bytes / 1e6, total_tokens, total_nodes);
+    if(options.cache_dir)
+        printf("%zu of them loaded from the AST cache\n", num_cached);
+    printf("%.3f s on %u threads: %.1f files/s, %.2f MB/s\n", seconds, pool.size(),
+           seconds > 0.0 ? results.size() / seconds : 0.0, seconds > 0.0 ? total_bytes / 1e6 / seconds : 0.0);
+    return num_failed == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv)
 {
-    std::string source_string = load_program_source("sample_program.lang");
-    if(!source_string.size())
+    Options options;
+    if(!parse_options(argc, argv, options))
+        return -1;
+    if(options.batch)
+        return run_batch_mode(options);
+    const char* source_path = options.source_path;
+
+    SourceFile source;
+    if(!source.load(source_path))
     {
-        printf("[Error] Could not read input file!\n");
+        std::fprintf(stderr, "[Error] could not load file: %s\n", source_path);
         return -1;
     }
 
-    if(source_string.size() == 0) 
+    if(source.view().size() == 0) 
     {
         printf("File is empty. No need to do anything...");
         return 0;
     }
+    if(source.view().size() > UINT32_MAX)
+    {
+        std::fprintf(stderr, "[Error] %s is too large, at most 4 GiB of source is supported\n", source_path);
+        return -1;
+    }
 
-    LexerState lexer_state;
-    lexer_state.input_len    = source_string.size();
-    lexer_state.input_string = std::move(source_string);
-    lexer_state.tokens       = NULL;
+    // A source this build has compiled before goes straight to its tree
+    std::unique_ptr<ast::AstCache> cache;
+    ast::SourceKey source_key = {};
+    ast::FlatAst   flat;
+    bool           cached = false;
+    if(options.cache_dir)
+    {
+        cache      = std::make_unique<ast::AstCache>(options.cache_dir);
+        source_key = ast::source_key(source.view());
+        if(options.optimize)
+            source_key.hash = hash::combine(source_key.hash, 1);    // Kept apart from the trees as written
+        cached     = cache->load(source_key, flat);
+    }
 
-    size_t lex_result = lexer_state.tokenize_string();
+    LexerState lexer_state;
+    lexer_state.input_len    = source.view().size();
+    lexer_state.input_string = source.view();
 
     ParserState parser;
     parser.status       = PARSE_SUCCESS;
-    parser.token_stream = lexer_state.tokens;
-    parser.curr_token   = lexer_state.tokens;
-    
-    std::unique_ptr<ast::Declaration> stmt = nullptr;
-    while(true)
-    {
-        auto decl = ast::parse_declaration(&parser);
-        if(decl == nullptr)
-            break;
+    parser.lexer        = &lexer_state;
+
+    ParseProfile profile;
+    if(options.profile || options.profile_json)
+        parser.profile = &profile;
+
+    size_t           lex_status = LEX_SUCCESS;
+    ast::ParseResult program;
+    if(!cached)
+    {
+        if(options.pipelined)
+        {
+            PipelinedLexer pipeline(lexer_state);
+            pipeline.start();
+            parser.attach_source(&pipeline);
 
-        if(stmt == nullptr)
-            stmt = std::move(decl);
+            program    = ast::parse_program(&parser);
+            lex_status = pipeline.finish();
+        }
         else
-            stmt->set_next(decl);
+        {
+            std::unique_ptr<ThreadPool> pool;
+            if(options.parallel_lex || options.parallel_parse)
+                pool = std::make_unique<ThreadPool>(options.num_threads);
+
+            if(options.parallel_lex)
+                lex_status = tokenize_parallel(lexer_state, *pool);
+            else
+                lex_status = lexer_state.tokenize_string();
+
+            parser.token_stream = lexer_state.tokens.data();
+            parser.curr_token   = 0;
+
+            if(options.parallel_parse)
+                program = ast::parse_program_parallel(&parser, *pool);
+            else
+                program = ast::parse_program(&parser);
+        }
+        if(options.optimize)
+        {
+            ast::OptimizeStats stats = ast::optimize_program(program);
+            std::fprintf(stderr, "Optimized: %zu folded, %zu simplified, %zu ifs pruned, %zu nodes removed\n",
+                         stats.folded, stats.simplified, stats.pruned, stats.removed);
+        }
+        flat = ast::flatten(program.root, parser.num_nodes);
+
+        // Only clean parses are kept, a cache hit has no errors to report
+        if(cache && lex_status == LEX_SUCCESS && parser.errors.empty() && parser.status == PARSE_SUCCESS)
+        {
+            if(!cache->store(source_key, flat, { lexer_state.tokens.size(), parser.num_nodes }))
+                std::fprintf(stderr, "[Warning] could not write to the AST cache in %s\n", options.cache_dir);
+        }
+    }
+    if(!options.run && !options.disassemble)
+        printf("done parsing!\n");
+    if(parser.profile)
+    {
+        if(cached)
+            std::fprintf(stderr, "[Warning] the tree came from the AST cache, nothing was parsed to profile\n");
+        if(options.profile)
+        {
+            printf("Parser profile, times include nested rules:\n");
+            profile.print_table(stdout);
+        }
+        if(options.profile_json)
+        {
+            std::ofstream json_file(options.profile_json);
+            json_file << profile.to_json() << '\n';
+            if(!json_file)
+                std::fprintf(stderr, "[Error] could not write the profile to %s\n", options.profile_json);
+        }
     }
-    printf("done parsing!\n");
     if(!parser.errors.empty()) 
     {
-        printf("Number of errors: %llu\n", parser.errors.size());
+        printf("Number of errors: %zu\n", parser.errors.size());
         for(const ErrorMessage& e : parser.errors) 
         {
             // TODO: These line numbers and line positions are incorrect
@@ -112,13 +364,47 @@ int main()
                         e.line_number, e.pos_in_line, e.msg.c_str());
         }
     }
+    if(options.run || options.disassemble)
+    {
+        if(lex_status != LEX_SUCCESS || !parser.errors.empty() || parser.status != PARSE_SUCCESS)
+        {
+            std::fprintf(stderr, "[Error] %s has errors, not running it\n", source_path);
+            return 1;
+        }
+        if(options.disassemble)
+        {
+            ast::compile_program(ast::resolve_program(program.root)).disassemble(stdout);
+            return 0;
+        }
+        ast::Interpreter interpreter(std::move(program), options.engine);
+        if(!interpreter.unresolved().empty())
+        {
+            for(const std::string& error : interpreter.unresolved())
+                std::fprintf(stderr, "[Error] %s\n", error.c_str());
+            return 1;
+        }
+        if(options.memoize)
+            interpreter.memoize();
+
+        bool ok = interpreter.run();
+        std::fflush(stdout);
+        if(!ok)
+            std::fprintf(stderr, "[Error] %s\n", interpreter.error().c_str());
+        for(const ast::Interpreter::MemoStats& stats : interpreter.memo_stats())
+        {
+            std::string_view name = Interner::global().name(stats.function);
+            std::fprintf(stderr, "Memoized %.*s(): %" PRIu64 " hits, %" PRIu64 " misses\n",
+                         (int) name.size(), name.data(), stats.hits, stats.misses);
+        }
+        return ok ? 0 : 1;
+    }
     {
         GraphvizDocument doc;
         doc.curr_node_id = 0;
         doc.file_name    = "test.gv";
 
         doc.oss << "digraph G {\n    node[shape=record fontname=Arial];\n";
-        stmt->output_graphviz(doc);
+        output_graphviz(flat, doc);
         doc.oss << "}\n";
 
         std::ofstream output_file("ast_output.gv");
@@ -0,0 +1,64 @@
+# Writes programs whose ifs nest as deep as the engines run and one level
+# deeper into WORK_DIR, and checks them the way RunProgram.cmake checks the
+# ones in tests/programs. Writing out the graph doesn't have that limit, so a
+# far deeper one has to parse all the same. Run by ctest as
+#
+#   cmake -DLANG=<path to lang> -DWORK_DIR=<dir> -P DeepIfs.cmake
+
+set(MAX_IF_DEPTH 10000)    # Statement.h
+
+# string(REPEAT) needs CMake 3.15
+function(repeat text count out)
+    set(result "")
+    while(count GREATER 0)
+        math(EXPR odd "${count} % 2")
+        if(odd)
+            string(APPEND result "${text}")
+        endif()
+        string(APPEND text "${text}")
+        math(EXPR count "${count} / 2")
+    endwhile()
+    set(${out} "${result}" PARENT_SCOPE)
+endfunction()
+
+# main() with `depth` ifs around one assignment, nested in the then or the
+# else blocks. Either way the innermost one is reached.
+function(write_nested path depth branch)
+    if(branch STREQUAL "then")
+        repeat("if x < 1 { " ${depth} opening)
+    else()
+        repeat("if x > 0 { } else { " ${depth} opening)
+    endif()
+    repeat("}" ${depth} closing)
+    file(WRITE ${path} "main() {\n    x : int = 0;\n    ${opening}x = 5;${closing}\n    print(x);\n}\n")
+endfunction()
+
+function(check_program name depth branch expected)
+    set(program ${WORK_DIR}/${name}.lang)
+    write_nested(${program} ${depth} ${branch})
+    file(WRITE ${WORK_DIR}/${name}.expected "${expected}")
+    execute_process(COMMAND ${CMAKE_COMMAND} -DLANG=${LANG} -DPROGRAM=${program}
+                            -P ${CMAKE_CURRENT_LIST_DIR}/RunProgram.cmake
+                    RESULT_VARIABLE status)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "${name}.lang didn't run as expected")
+    endif()
+endfunction()
+
+math(EXPR too_deep "${MAX_IF_DEPTH} + 1")
+foreach(branch then else)
+    check_program(deep_ifs_${branch} ${MAX_IF_DEPTH} ${branch}
+                  "5\nexit status 0\n")
+    check_program(too_deep_ifs_${branch} ${too_deep} ${branch}
+                  "[Error] ifs nested too deeply in main()\nexit status 1\n")
+
+    write_nested(${WORK_DIR}/deeper_ifs_${branch}.lang 100000 ${branch})
+    file(REMOVE ${WORK_DIR}/ast_output.gv)
+    execute_process(COMMAND ${LANG} ${WORK_DIR}/deeper_ifs_${branch}.lang
+                    WORKING_DIRECTORY ${WORK_DIR}
+                    OUTPUT_QUIET
+                    RESULT_VARIABLE status)
+    if(NOT status EQUAL 0 OR NOT EXISTS ${WORK_DIR}/ast_output.gv)
+        message(FATAL_ERROR "deeper_ifs_${branch}.lang didn't parse, exit status ${status}")
+    endif()
+endforeach()
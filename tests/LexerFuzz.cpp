@@ -0,0 +1,584 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "SourceGenerator.h"
+#include "AstCache.h"
+#include "CharScan.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "Declaration.h"
+#include "FlatAst.h"
+#include "GraphvizOutput.h"
+#include "IncrementalLexer.h"
+#include "IncrementalParser.h"
+#include "ParallelLexer.h"
+#include "ThreadPool.h"
+
+// Checks the lexer's fast paths against the plain ones they have to agree
+// with, over generated sources and the same sources with random bytes
+// mixed in:
+//   scan           every vectorised scanner against the scalar one, from
+//                  every position and with ends cut short, then whole
+//                  token streams
+//   parallel       tokenize_parallel() against tokenize_string(), cut into
+//                  as many chunks as a pool of 1, 3 and 7 threads makes
+//   incremental    a run of random edits, mostly close together as typing
+//                  is, each relexed by IncrementalLexer and reparsed by
+//                  IncrementalParser, against lexing and parsing it all
+//   cache          the tree read back from the AST cache against the one
+//                  written to it, and files with a byte damaged on disk,
+//                  or indices damaged before writing, being turned away
+// Stops at the first difference and names the seed that reproduces it.
+namespace
+{
+    struct Options
+    {
+        uint32_t    first_seed = 1;
+        uint32_t    num_seeds  = 20;
+        size_t      size       = 16 * 1024;    // Of each generated source
+        const char* only       = nullptr;      // Check to run, all of them by default
+    };
+
+    struct Source
+    {
+        std::string name;
+        std::string text;
+    };
+
+    // What a character the lexer treats specially does to the inputs of
+    // every check: strings cut off or reopened, escapes, comments, numbers
+    // with too many periods or digits. `any_byte` also lets in characters
+    // that aren't tokens at all, which stop lexing where they are.
+    std::string mangle(std::string text, std::mt19937& rng, bool any_byte)
+    {
+        static const char* SNIPPETS[] = {
+            "\"", "\\", "\n", "//", "\\\"", "\"\\\n", "1.2", "1.2.3", "99999999999999999999", "\t", "_x9",
+        };
+        const size_t num_snippets = sizeof(SNIPPETS) / sizeof(SNIPPETS[0]);
+
+        size_t num_edits = text.size() / 64 + 1;
+        for(size_t i = 0; i < num_edits; i++)
+        {
+            size_t at = std::uniform_int_distribution<size_t>(0, text.size())(rng);
+            if(any_byte && rng() % 8 == 0)
+                text.insert(at, 1, (char) (rng() % 256));
+            else
+                text.insert(at, SNIPPETS[rng() % num_snippets]);
+        }
+        return text;
+    }
+
+    std::vector<Source> make_sources(uint32_t seed, size_t size)
+    {
+        std::vector<Source> sources;
+        std::mt19937        rng(seed);
+        for(int i = 0; i < (int) SourceShape::SHAPE_COUNT; i++)
+        {
+            GeneratorOptions generator;
+            generator.shape         = (SourceShape) i;
+            generator.target_bytes  = size;
+            generator.seed          = seed;
+            generator.nesting_depth = 8;
+            generator.chain_length  = 16;
+
+            std::string name = std::string(shape_name(generator.shape)) + " seed " + std::to_string(seed);
+            std::string text = generate_source(generator);
+            sources.push_back({ name + " mangled", mangle(text, rng, false) });
+            sources.push_back({ name + " with any byte", mangle(text, rng, true) });
+            sources.push_back({ name, std::move(text) });
+        }
+        return sources;
+    }
+
+    // Empty if `actual` lexed to the same tokens and stopped in the same
+    // place as `expected`, otherwise the first difference. Identifiers are
+    // compared by name, their symbols depend on what was interned first.
+    std::string compare_lexers(const LexerState& expected, size_t expected_status,
+                               const LexerState& actual, size_t actual_status)
+    {
+        char diff[256];
+        if(expected_status != actual_status)
+        {
+            snprintf(diff, sizeof(diff), "status %zu instead of %zu", actual_status, expected_status);
+            return diff;
+        }
+        if(expected.tokens.size() != actual.tokens.size())
+        {
+            snprintf(diff, sizeof(diff), "%zu tokens instead of %zu", actual.tokens.size(), expected.tokens.size());
+            return diff;
+        }
+        for(size_t i = 0; i < expected.tokens.size(); i++)
+        {
+            const Token& a = expected.tokens[i];
+            const Token& b = actual.tokens[i];
+            bool same = a.offset == b.offset && a.length == b.length && a.line_number == b.line_number &&
+                        a.pos_in_line == b.pos_in_line && a.type == b.type && a.flags == b.flags &&
+                        expected.lexeme(a) == actual.lexeme(b);
+            if(same && (a.type == TOKEN_INT_LITERAL || a.type == TOKEN_FLOAT_LITERAL))
+                same = a.int_value == b.int_value;  // Bit for bit, for floats as well
+            if(same && a.type == TOKEN_IDENTIFIER)
+                same = Interner::global().name(a.symbol) == Interner::global().name(b.symbol);
+            if(!same)
+            {
+                snprintf(diff, sizeof(diff), "token %zu: type %d at %u+%u line %u:%u instead of type %d at %u+%u line %u:%u",
+                         i, (int) b.type, b.offset, b.length, b.line_number, b.pos_in_line,
+                         (int) a.type, a.offset, a.length, a.line_number, a.pos_in_line);
+                return diff;
+            }
+        }
+        if(expected_status != LEX_SUCCESS &&
+           (expected.curr_ch_idx != actual.curr_ch_idx || expected.curr_line_number != actual.curr_line_number ||
+            expected.line_start_idx != actual.line_start_idx || expected.error != actual.error))
+        {
+            snprintf(diff, sizeof(diff), "error reported at %zu line %zu instead of at %zu line %zu",
+                     actual.curr_ch_idx, actual.curr_line_number, expected.curr_ch_idx, expected.curr_line_number);
+            return diff;
+        }
+        return std::string();
+    }
+
+    size_t lex(LexerState& lexer, std::string_view text)
+    {
+        lexer.input_string = text;
+        lexer.input_len    = text.size();
+        lexer.print_errors = false;
+        return lexer.tokenize_string();
+    }
+
+    // The tokens and error position of `lexer` laid out as a LexerState,
+    // for compare_lexers()
+    void gather(const IncrementalLexer& lexer, LexerState& out)
+    {
+        const LexerState& state = lexer.state();
+        out.input_string     = state.input_string;
+        out.input_len        = state.input_len;
+        out.curr_ch_idx      = state.curr_ch_idx;
+        out.curr_line_number = state.curr_line_number;
+        out.line_start_idx   = state.line_start_idx;
+        out.error            = state.error;
+        out.tokens.clear();
+        for(size_t i = 0; i < lexer.num_tokens(); i++)
+            out.tokens.push_back(lexer.token(i));
+    }
+
+    // The graph main() would write for the tree, which is all of it but
+    // the positions
+    std::string describe(const ast::Declaration* root, size_t num_nodes)
+    {
+        GraphvizDocument doc;
+        doc.curr_node_id = 0;
+        output_graphviz(ast::flatten(root, num_nodes), doc);
+        return doc.oss.str();
+    }
+
+    // Empty if both parses gave the same tree, errors and status
+    std::string compare_parses(const ParserState& expected, const ast::Declaration* expected_root,
+                               const ParserState& actual, const ast::Declaration* actual_root)
+    {
+        char diff[256];
+        if(expected.status != actual.status || expected.num_nodes != actual.num_nodes ||
+           expected.errors.size() != actual.errors.size())
+        {
+            snprintf(diff, sizeof(diff), "status %d, %zu nodes and %zu errors instead of %d, %zu and %zu",
+                     (int) actual.status, actual.num_nodes, actual.errors.size(),
+                     (int) expected.status, expected.num_nodes, expected.errors.size());
+            return diff;
+        }
+        for(size_t i = 0; i < expected.errors.size(); i++)
+        {
+            const ErrorMessage& a = expected.errors[i];
+            const ErrorMessage& b = actual.errors[i];
+            if(a.msg != b.msg || a.line_number != b.line_number || a.pos_in_line != b.pos_in_line)
+            {
+                snprintf(diff, sizeof(diff), "error %zu at %zu:%zu instead of at %zu:%zu", i,
+                         b.line_number, b.pos_in_line, a.line_number, a.pos_in_line);
+                return diff;
+            }
+        }
+        if(describe(expected_root, expected.num_nodes) != describe(actual_root, actual.num_nodes))
+            return "the trees differ";
+        return std::string();
+    }
+
+    bool fail(const Source& source, const char* check, const std::string& diff)
+    {
+        fprintf(stderr, "[Error] %s: %s: %s\n", check, source.name.c_str(), diff.c_str());
+        return false;
+    }
+
+    bool check_scan(const Source& source, std::mt19937& rng)
+    {
+        const char*  data = source.text.data();
+        const size_t size = source.text.size();
+
+        scan::Impl best = scan::best_supported_impl();
+        scan::select_impl(scan::Impl::SCALAR);
+        scan::Scanners scalar = scan::active;
+        LexerState     expected;
+        size_t         expected_status = lex(expected, source.text);
+
+        bool ok = true;
+        for(int impl = (int) scan::Impl::SCALAR + 1; impl <= (int) best && ok; impl++)
+        {
+            scan::select_impl((scan::Impl) impl);
+            const scan::Scanners& fast = scan::active;
+            const char*           name = scan::impl_name((scan::Impl) impl);
+
+            // Short ends land inside a vector's width, past the end of
+            // the run and before it
+            for(size_t pos = 0; pos < size && ok; pos++)
+            {
+                size_t ends[] = { size, std::min(size, pos + rng() % 80) };
+                for(size_t end : ends)
+                {
+                    size_t (*const pairs[][2])(const char*, size_t, size_t) = {
+                        { scalar.skip_blank,       fast.skip_blank },
+                        { scalar.skip_identifier,  fast.skip_identifier },
+                        { scalar.skip_number,      fast.skip_number },
+                        { scalar.skip_string_body, fast.skip_string_body },
+                    };
+                    for(size_t fn = 0; fn < 4 && ok; fn++)
+                    {
+                        size_t want = pairs[fn][0](data, pos, end);
+                        size_t got  = pairs[fn][1](data, pos, end);
+                        if(want != got)
+                        {
+                            char diff[128];
+                            snprintf(diff, sizeof(diff), "%s scanner %zu from %zu to %zu stops at %zu instead of %zu",
+                                     name, fn, pos, end, got, want);
+                            ok = fail(source, "scan", diff);
+                        }
+                    }
+                }
+            }
+
+            LexerState  actual;
+            size_t      status = lex(actual, source.text);
+            std::string diff   = compare_lexers(expected, expected_status, actual, status);
+            if(ok && !diff.empty())
+                ok = fail(source, "scan", std::string(name) + " lexer: " + diff);
+        }
+        scan::select_impl(best);
+        return ok;
+    }
+
+    bool check_parallel(const Source& source, std::mt19937&)
+    {
+        static ThreadPool pools[] = { ThreadPool(1), ThreadPool(3), ThreadPool(7) };
+
+        LexerState expected;
+        size_t     expected_status = lex(expected, source.text);
+        for(ThreadPool& pool : pools)
+        {
+            // Chunks are at least a byte, so every pool makes four per thread
+            LexerState actual;
+            actual.input_string = source.text;
+            actual.input_len    = source.text.size();
+            actual.print_errors = false;
+            size_t      status  = tokenize_parallel(actual, pool, 1);
+            std::string diff    = compare_lexers(expected, expected_status, actual, status);
+            if(!diff.empty())
+                return fail(source, "parallel", std::to_string(pool.size()) + " threads: " + diff);
+        }
+        return true;
+    }
+
+    // Somewhere close to `near` most of the time, like typing, now and then
+    // anywhere. What it inserts is kept in `inserted`.
+    TextEdit random_edit(const std::string& text, size_t near, std::mt19937& rng, std::string& inserted)
+    {
+        static const char* SNIPPETS[] = {
+            "", "\"", "\\", "\n", "//", "{", "}", "(", ")", ";", " ", "x", "1", ".", "return ", "if", " + 1",
+        };
+        const size_t num_snippets = sizeof(SNIPPETS) / sizeof(SNIPPETS[0]);
+        auto random = [&rng](size_t lo, size_t hi) { return std::uniform_int_distribution<size_t>(lo, hi)(rng); };
+
+        size_t at = (rng() % 4 == 0) ? random(0, text.size())
+                                     : std::min(text.size(), near - std::min<size_t>(near, 20) + random(0, 40));
+        size_t removed = (rng() % 3 == 0) ? random(0, std::min<size_t>(text.size() - at, 40)) : 0;
+        if(rng() % 4 == 0)
+        {
+            size_t from = random(0, text.size());
+            inserted    = text.substr(from, random(0, 40));
+        }
+        else
+            inserted = SNIPPETS[rng() % num_snippets];
+        return { at, removed, inserted };
+    }
+
+    bool check_incremental(const Source& source, std::mt19937& rng)
+    {
+        const int NUM_EDITS = 24;
+
+        // The lexer keeps pointing into the text it was last given, each
+        // edit goes into the other one
+        std::string texts[2] = { source.text, std::string() };
+        int         current  = 0;
+
+        IncrementalLexer lexer;
+        lexer.print_errors = false;
+        lexer.tokenize(texts[current]);
+
+        ast::IncrementalParser incremental;
+        ParserState            first_parser {};
+        incremental.parse(&first_parser, lexer);
+
+        size_t      near = texts[current].size() / 2;
+        std::string inserted;
+        for(int i = 0; i < NUM_EDITS; i++)
+        {
+            TextEdit edit = random_edit(texts[current], near, rng, inserted);
+            near = edit.offset + edit.inserted_text.size();
+
+            std::string& edited = texts[1 - current];
+            edited = texts[current];
+            apply_edit(edited, edit);
+            current = 1 - current;
+
+            size_t      num_old = lexer.num_tokens();
+            TokenSplice splice;
+            size_t      status  = lexer.retokenize_edit(edited, edit, &splice);
+
+            LexerState expected;
+            size_t     expected_status = lex(expected, edited);
+            LexerState actual;
+            gather(lexer, actual);
+            std::string diff = compare_lexers(expected, expected_status, actual, status);
+            if(diff.empty() && splice.first + splice.num_inserted + (num_old - splice.first - splice.num_removed) != lexer.num_tokens())
+                diff = "the splice doesn't add up to the new number of tokens";
+
+            if(diff.empty())
+            {
+                ParserState full {};
+                full.lexer        = &expected;
+                full.token_stream = expected.tokens.data();
+                ast::ParseResult program = ast::parse_program(&full);
+
+                ParserState        reparser {};
+                ast::Declaration*  root = incremental.parse(&reparser, lexer, &splice);
+                diff = compare_parses(full, program.root, reparser, root);
+                if(!diff.empty())
+                    diff = "reparse: " + diff;
+            }
+            if(!diff.empty())
+            {
+                char where[128];
+                snprintf(where, sizeof(where), "edit %d (%zu bytes at %zu for %zu): ", i, edit.removed_length,
+                         edit.offset, edit.inserted_text.size());
+                return fail(source, "incremental", where + diff);
+            }
+        }
+        return true;
+    }
+
+    // The graph of a flat tree, for comparing two
+    std::string describe(const ast::FlatAst& flat)
+    {
+        GraphvizDocument doc;
+        doc.curr_node_id = 0;
+        output_graphviz(flat, doc);
+        return doc.oss.str();
+    }
+
+    // Points one of the indices in `flat` somewhere it may not belong,
+    // leaving symbols alone since writing looks those up
+    void damage_index(ast::FlatAst& flat, std::mt19937& rng)
+    {
+        std::vector<uint32_t*> indices;
+        for(ast::FlatExpr& expr : flat.exprs)
+        {
+            if(expr.type != Expr_t::IDENTIFIER && expr.type != Expr_t::CALL)
+                indices.push_back(&expr.a);
+            indices.push_back(&expr.b);
+            indices.push_back(&expr.c);
+        }
+        for(ast::FlatStmt& stmt : flat.stmts)
+        {
+            indices.push_back(&stmt.a);
+            if(stmt.type != Stmt_t::DECL)
+                indices.push_back(&stmt.b);
+            indices.push_back(&stmt.c);
+        }
+        for(ast::FlatBlock& block : flat.blocks)
+        {
+            indices.push_back(&block.first);
+            indices.push_back(&block.count);
+        }
+        for(ast::FlatFunction& func : flat.functions)
+        {
+            indices.push_back(&func.first_param);
+            indices.push_back(&func.num_params);
+            indices.push_back(&func.body);
+        }
+        for(ast::FlatString& str : flat.strings)
+        {
+            indices.push_back(&str.offset);
+            indices.push_back(&str.length);
+        }
+        for(ast::NodeIndex& idx : flat.stmt_lists)
+            indices.push_back(&idx);
+        for(ast::NodeIndex& idx : flat.expr_lists)
+            indices.push_back(&idx);
+        if(indices.empty())
+            return;
+
+        uint32_t* index = indices[rng() % indices.size()];
+        switch(rng() % 4)
+        {
+            case 0 : *index = ast::NO_NODE;                                  break;
+            case 1 : *index = *index + (uint32_t) (rng() % 5) - 2;           break;    // Off by a little
+            case 2 : *index = (uint32_t) (rng() % (flat.exprs.size() + 1));  break;
+            default: *index = (uint32_t) rng();                              break;
+        }
+    }
+
+    bool check_cache(const Source& source, std::mt19937& rng)
+    {
+        const size_t NUM_BYTES_DAMAGED   = 320;    // The header and section table, and some after
+        const int    NUM_INDICES_DAMAGED = 32;
+
+        // Only clean parses are cached
+        LexerState  lexer;
+        size_t      lex_status = lex(lexer, source.text);
+        ParserState parser {};
+        parser.lexer        = &lexer;
+        parser.token_stream = lexer.tokens.data();
+        ast::ParseResult program = ast::parse_program(&parser);
+        if(lex_status != LEX_SUCCESS || parser.status != PARSE_SUCCESS || !parser.errors.empty())
+            return true;
+
+        ast::FlatAst   flat     = ast::flatten(program.root, parser.num_nodes);
+        ast::SourceKey key      = ast::source_key(source.text);
+        std::string    expected = describe(flat);
+        std::string    file     = ast::write_flat_ast(flat, key, {});
+
+        ast::FlatAst loaded;
+        if(!ast::read_flat_ast(file, key, loaded) || describe(loaded) != expected)
+            return fail(source, "cache", "the tree read back isn't the one written");
+
+        for(size_t i = 0; i < NUM_BYTES_DAMAGED && i < file.size(); i++)
+        {
+            std::string damaged = file;
+            size_t      at      = i < NUM_BYTES_DAMAGED / 2 ? i : rng() % file.size();
+            damaged[at] ^= (char) (1 + rng() % 255);
+            if(ast::read_flat_ast(damaged, key, loaded))
+                return fail(source, "cache", "a file with byte " + std::to_string(at) + " changed was read back");
+        }
+
+        // These are hashed as they are, only the index checks can turn
+        // them away. The ones that pass have to be walked without a fault.
+        for(int i = 0; i < NUM_INDICES_DAMAGED; i++)
+        {
+            ast::FlatAst damaged = flat;
+            damage_index(damaged, rng);
+            if(ast::read_flat_ast(ast::write_flat_ast(damaged, key, {}), key, loaded))
+                describe(loaded);
+        }
+
+        // Through the directory as main() uses it: a damaged file is a miss,
+        // and the tree parsed again in its place is stored over it
+        namespace fs = std::filesystem;
+        fs::path      directory = fs::temp_directory_path() / ("lang_fuzz_cache." + std::to_string(getpid()));
+        ast::AstCache cache(directory.string());
+        std::string   diff;
+        if(!cache.store(key, flat, {}))
+            diff = "the tree couldn't be stored";
+        else
+        {
+            std::streamoff at = (std::streamoff) (rng() % file.size());
+            std::fstream   stored(cache.path_for(key), std::ios::in | std::ios::out | std::ios::binary);
+            stored.seekg(at);
+            char byte = (char) stored.get();
+            stored.seekp(at);
+            stored.put((char) (byte ^ (1 + rng() % 255)));
+            stored.close();
+            if(cache.load(key, loaded))
+                diff = "a file damaged on disk was loaded";
+            else if(!cache.store(key, flat, {}) || !cache.load(key, loaded) || describe(loaded) != expected)
+                diff = "the tree stored over a damaged file doesn't load back the same";
+        }
+        std::error_code error;
+        fs::remove_all(directory, error);
+        return diff.empty() || fail(source, "cache", diff);
+    }
+
+    void usage(const char* program)
+    {
+        fprintf(stderr, "usage: %s [--seeds N] [--seed FIRST] [--size BYTES] [--only scan|parallel|incremental|cache]\n", program);
+    }
+
+    bool parse_options(int argc, char** argv, Options& options)
+    {
+        for(int i = 1; i < argc; i += 2)
+        {
+            const char* arg   = argv[i];
+            const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+            if(!value)
+            {
+                fprintf(stderr, "[Error] %s expects a value\n", arg);
+                return false;
+            }
+            if     (strcmp(arg, "--seeds") == 0) options.num_seeds  = (uint32_t) strtoul(value, nullptr, 10);
+            else if(strcmp(arg, "--seed")  == 0) options.first_seed = (uint32_t) strtoul(value, nullptr, 10);
+            else if(strcmp(arg, "--size")  == 0) options.size       = strtoull(value, nullptr, 10);
+            else if(strcmp(arg, "--only")  == 0) options.only       = value;
+            else
+            {
+                fprintf(stderr, "[Error] unknown option: %s\n", arg);
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if(!parse_options(argc, argv, options))
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    struct Check
+    {
+        const char* name;
+        bool (*run)(const Source&, std::mt19937&);
+    };
+    const Check checks[] = {
+        { "scan",        check_scan },
+        { "parallel",    check_parallel },
+        { "incremental", check_incremental },
+        { "cache",       check_cache },
+    };
+
+    size_t num_sources = 0;
+    for(uint32_t seed = options.first_seed; seed < options.first_seed + options.num_seeds; seed++)
+    {
+        std::mt19937 rng(seed);
+        for(const Source& source : make_sources(seed, options.size))
+        {
+            for(const Check& check : checks)
+            {
+                if(options.only && strcmp(options.only, check.name) != 0)
+                    continue;
+                if(!check.run(source, rng))
+                    return 1;
+            }
+            num_sources++;
+        }
+    }
+    printf("%zu sources, no differences (scanners up to %s)\n", num_sources,
+           scan::impl_name(scan::best_supported_impl()));
+    return 0;
+}
@@ -0,0 +1,47 @@
+# Runs a program on both engines, with and without --optimize and
+# --memoize, and checks that every run prints the same thing, and that it's
+# what the .expected file next to it says: stdout, then stderr, then the
+# exit status. The hits and misses --memoize reports aren't part of that,
+# but they have to be the same for every run that memoizes. Run by ctest as
+#
+#   cmake -DLANG=<path to lang> -DPROGRAM=<file.lang> -P RunProgram.cmake
+
+function(run_lang output memo_stats)
+    execute_process(COMMAND ${LANG} --run ${ARGN} ${PROGRAM}
+                    OUTPUT_VARIABLE stdout
+                    ERROR_VARIABLE  stderr
+                    RESULT_VARIABLE status)
+    string(REGEX MATCHALL "Memoized [^\n]*\n" stats "${stderr}")
+    string(REPLACE ";" "" stats "${stats}")
+    string(REGEX REPLACE "(Optimized|Memoized)[^\n]*\n" "" stderr "${stderr}")
+    set(${output} "${stdout}${stderr}exit status ${status}\n" PARENT_SCOPE)
+    set(${memo_stats} "${stats}" PARENT_SCOPE)
+endfunction()
+
+string(REGEX REPLACE "\\.lang$" ".expected" expected_path ${PROGRAM})
+file(READ ${expected_path} expected)
+
+unset(first_stats)
+foreach(engine tree bytecode)
+    foreach(optimize "" --optimize)
+        foreach(memoize "" --memoize)
+            set(flags --engine ${engine} ${optimize} ${memoize})
+            run_lang(actual stats ${flags})
+            string(REPLACE ";" " " flags "${flags}")
+            if(NOT actual STREQUAL expected)
+                message(FATAL_ERROR "Unexpected output from ${PROGRAM} with ${flags}\n"
+                                    "--- expected:\n${expected}--- actual:\n${actual}")
+            endif()
+
+            if(NOT memoize)
+                continue()
+            elseif(NOT DEFINED first_stats)
+                set(first_stats "${stats}")
+                set(first_flags "${flags}")
+            elseif(NOT stats STREQUAL first_stats)
+                message(FATAL_ERROR "${PROGRAM} memoizes differently with ${flags} than with ${first_flags}\n"
+                                    "--- ${first_flags}:\n${first_stats}--- ${flags}:\n${stats}")
+            endif()
+        endforeach()
+    endforeach()
+endforeach()